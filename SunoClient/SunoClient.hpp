@@ -40,6 +40,7 @@ struct TaskStatus {
     std::string status;  // PENDING, TEXT_SUCCESS, FIRST_SUCCESS, SUCCESS, ...
     std::string errorMessage;
     std::vector<std::string> audioUrls;  // from sunoData[].audioUrl
+    std::string tags;                    // sunoData[0].tags (style tags chosen by Suno)
 };
 
 // Add Vocals params (instrumental -> add vocals)
@@ -91,6 +92,11 @@ public:
 
     std::string lastError() const { return lastError_; }
 
+    /** Cancels every request in flight in the process, and fails new ones at once, until
+        resumeRequests(); lets blocked callers return when the process shuts its workers down. */
+    static void cancelAllRequests();
+    static void resumeRequests();
+
 private:
     std::string apiKey_;
     mutable std::string lastError_;
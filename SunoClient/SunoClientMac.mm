@@ -7,6 +7,7 @@
 #include "SunoClient.hpp"
 #include <Foundation/Foundation.h>
 #include <algorithm>
+#include <atomic>
 #include <sstream>
 
 static std::string nsstringToStd(NSString* s) {
@@ -34,6 +35,32 @@ static std::string escapeJsonString(const std::string& s) {
     return out;
 }
 
+// One session (and connection pool) for every client in the process, whichever plugin instance
+// owns it. No URL cache: API responses are never reused, and downloaded audio would otherwise
+// be held in memory a second time by the shared cache.
+static NSURLSession* apiSession() {
+    static NSURLSession* session = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        NSURLSessionConfiguration* config = [NSURLSessionConfiguration defaultSessionConfiguration];
+        config.URLCache = nil;
+        config.requestCachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+        config.HTTPMaximumConnectionsPerHost = 4;
+        config.timeoutIntervalForRequest = 60.0;
+        session = [[NSURLSession sessionWithConfiguration:config] retain];
+    });
+    return session;
+}
+
+// Cleared by cancelAllRequests(): a task resumed after that cancels itself.
+static std::atomic<bool> requestsEnabled{ true };
+
+static void resumeTask(NSURLSessionDataTask* task) {
+    [task resume];
+    if (!requestsEnabled.load())
+        [task cancel];   // started while cancelAllRequests() ran, or after it
+}
+
 // Perform request with Bearer auth; copy body in block so no NSData* used after block.
 static void performRequest(NSURLRequest* request, const std::string& bearerToken,
                           std::string* outBody, NSHTTPURLResponse** outResponse, NSError** outError) {
@@ -41,11 +68,11 @@ static void performRequest(NSURLRequest* request, const std::string& bearerToken
     __block std::string body;
     __block NSHTTPURLResponse* resultResp = nil;
     __block NSError* resultErr = nil;
-    NSURLSession* session = [NSURLSession sharedSession];
+    NSURLSession* session = apiSession();
     NSMutableURLRequest* req = [request isKindOfClass:[NSMutableURLRequest class]] ? (NSMutableURLRequest*)request : [request mutableCopy];
     if (!bearerToken.empty())
         [req setValue:[NSString stringWithFormat:@"Bearer %s", bearerToken.c_str()] forHTTPHeaderField:@"Authorization"];
-    [[session dataTaskWithRequest:req completionHandler:^(NSData* data, NSURLResponse* response, NSError* error) {
+    resumeTask([session dataTaskWithRequest:req completionHandler:^(NSData* data, NSURLResponse* response, NSError* error) {
         resultResp = (NSHTTPURLResponse*)response;
         resultErr = error;
         if (data && [data length] > 0) {
@@ -54,13 +81,30 @@ static void performRequest(NSURLRequest* request, const std::string& bearerToken
                 body.assign((const char*)[dataCopy bytes], (size_t)[dataCopy length]);
         }
         dispatch_semaphore_signal(sem);
-    }] resume];
+    }]);
     dispatch_semaphore_wait(sem, DISPATCH_TIME_FOREVER);
     if (outResponse) *outResponse = resultResp;
     if (outError) *outError = resultErr;
     if (outBody) *outBody = std::move(body);
 }
 
+void SunoClient::cancelAllRequests() {
+    requestsEnabled.store(false);
+    // Waits for the list (it comes on the session's queue), so a later resumeRequests() cannot
+    // let a cancel reach requests made after it
+    dispatch_semaphore_t sem = dispatch_semaphore_create(0);
+    [apiSession() getAllTasksWithCompletionHandler:^(NSArray<__kindof NSURLSessionTask*>* tasks) {
+        for (NSURLSessionTask* task in tasks)
+            [task cancel];
+        dispatch_semaphore_signal(sem);
+    }];
+    dispatch_semaphore_wait(sem, DISPATCH_TIME_FOREVER);
+}
+
+void SunoClient::resumeRequests() {
+    requestsEnabled.store(true);
+}
+
 SunoClient::SunoClient(std::string apiKey) : apiKey_(std::move(apiKey)) {}
 
 SunoClient::~SunoClient() = default;
@@ -183,6 +227,72 @@ std::string SunoClient::startAddVocals(const AddVocalsParams& params) {
     return body.substr(i + 1, j - (i + 1));
 }
 
+// Appends code point cp to out as UTF-8
+static void appendUtf8(std::string& out, unsigned cp) {
+    if (cp < 0x80) { out += (char)cp; return; }
+    if (cp < 0x800) { out += (char)(0xC0 | (cp >> 6)); }
+    else {
+        if (cp < 0x10000) out += (char)(0xE0 | (cp >> 12));
+        else { out += (char)(0xF0 | (cp >> 18)); out += (char)(0x80 | ((cp >> 12) & 0x3F)); }
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+    }
+    out += (char)(0x80 | (cp & 0x3F));
+}
+
+// Four hex digits at body[pos]; -1 if there are not
+static long parseHex4(const std::string& body, size_t pos) {
+    if (pos + 4 > body.size()) return -1;
+    long v = 0;
+    for (size_t k = pos; k < pos + 4; ++k) {
+        const char h = body[k];
+        const int d = (h >= '0' && h <= '9') ? h - '0' : (h >= 'a' && h <= 'f') ? h - 'a' + 10 : (h >= 'A' && h <= 'F') ? h - 'A' + 10 : -1;
+        if (d < 0) return -1;
+        v = v * 16 + d;
+    }
+    return v;
+}
+
+// Value of the JSON key at keyPos if it is a string, unescaped (the inverse of escapeJsonString,
+// plus \t, \/ and \uXXXX). False for null, numbers or malformed input.
+static bool readJsonString(const std::string& body, size_t keyPos, std::string* out) {
+    size_t i = body.find(':', keyPos);
+    if (i == std::string::npos) return false;
+    i = body.find_first_not_of(" \t\r\n", i + 1);
+    if (i == std::string::npos || body[i] != '"') return false;
+    std::string value;
+    for (++i; i < body.size(); ++i) {
+        const char c = body[i];
+        if (c == '"') { *out = std::move(value); return true; }
+        if (c != '\\') { value += c; continue; }
+        if (++i >= body.size()) return false;
+        switch (body[i]) {
+            case 'n': value += '\n'; break;
+            case 'r': value += '\r'; break;
+            case 't': value += '\t'; break;
+            case 'b': value += '\b'; break;
+            case 'f': value += '\f'; break;
+            case 'u': {
+                const long hi = parseHex4(body, i + 1);
+                if (hi < 0) return false;
+                unsigned cp = (unsigned)hi;
+                i += 4;
+                // Surrogate pair: a second \uXXXX follows
+                if (cp >= 0xD800 && cp < 0xDC00 && i + 2 < body.size() && body[i + 1] == '\\' && body[i + 2] == 'u') {
+                    const long low = parseHex4(body, i + 3);
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                }
+                appendUtf8(value, cp);
+                break;
+            }
+            default: value += body[i]; break;   // \" \\ \/
+        }
+    }
+    return false;
+}
+
 // Parse GET record-info response for status and audioUrls
 static void parseRecordInfo(const std::string& body, TaskStatus* out) {
     if (!out) return;
@@ -207,6 +317,10 @@ static void parseRecordInfo(const std::string& body, TaskStatus* out) {
         if (pos != std::string::npos && end != std::string::npos)
             out->taskId = body.substr(pos + 1, end - (pos + 1));
     }
+    size_t dataPos = body.find("\"sunoData\"");
+    pos = dataPos != std::string::npos ? body.find("\"tags\"", dataPos) : std::string::npos;
+    if (pos != std::string::npos && !readJsonString(body, pos, &out->tags))
+        out->tags.clear();   // null or not a string
     // sunoData array: each element has "audioUrl"
     size_t idx = 0;
     while ((idx = body.find("\"audioUrl\"", idx)) != std::string::npos) {
@@ -258,7 +372,7 @@ std::string SunoClient::uploadAudio(const std::vector<uint8_t>& audioWavOrMp3, c
     __block std::string responseStr;
     __block NSHTTPURLResponse* resp = nil;
     __block NSError* err = nil;
-    [[[NSURLSession sharedSession] dataTaskWithRequest:req completionHandler:^(NSData* data, NSURLResponse* r, NSError* e) {
+    resumeTask([apiSession() dataTaskWithRequest:req completionHandler:^(NSData* data, NSURLResponse* r, NSError* e) {
         resp = (NSHTTPURLResponse*)r;
         err = e;
         if (data && [data length] > 0) {
@@ -266,7 +380,7 @@ std::string SunoClient::uploadAudio(const std::vector<uint8_t>& audioWavOrMp3, c
             if (copy) responseStr.assign((const char*)[copy bytes], (size_t)[copy length]);
         }
         dispatch_semaphore_signal(sem);
-    }] resume];
+    }]);
     dispatch_semaphore_wait(sem, DISPATCH_TIME_FOREVER);
     if (err) { lastError_ = nsstringToStd([err localizedDescription]); return {}; }
     if (resp && resp.statusCode >= 400) { lastError_ = "Upload HTTP " + std::to_string((int)resp.statusCode); return {}; }
@@ -288,7 +402,7 @@ std::vector<uint8_t> SunoClient::fetchAudio(const std::string& url) {
     NSURLRequest* req = [NSURLRequest requestWithURL:nsUrl];
     dispatch_semaphore_t sem = dispatch_semaphore_create(0);
     __block std::vector<uint8_t> out;
-    [[[NSURLSession sharedSession] dataTaskWithRequest:req completionHandler:^(NSData* data, NSURLResponse* response, NSError* error) {
+    resumeTask([apiSession() dataTaskWithRequest:req completionHandler:^(NSData* data, NSURLResponse* response, NSError* error) {
         if (data && [data length] > 0) {
             NSData* dataCopy = [data copy];
             if (dataCopy) {
@@ -298,7 +412,7 @@ std::vector<uint8_t> SunoClient::fetchAudio(const std::string& url) {
             }
         }
         dispatch_semaphore_signal(sem);
-    }] resume];
+    }]);
     dispatch_semaphore_wait(sem, DISPATCH_TIME_FOREVER);
     return out;
 }
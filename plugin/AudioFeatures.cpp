@@ -0,0 +1,251 @@
+#include "AudioFeatures.h"
+#include <juce_dsp/juce_dsp.h>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+constexpr int kFftOrder = 11;
+constexpr int kFftSize = 1 << kFftOrder;
+constexpr int kHopSize = kFftSize / 2;
+constexpr int kNumBins = kFftSize / 2 + 1;
+constexpr int kNumMelBands = 40;
+constexpr int kMinHops = 16;
+constexpr double kMinTempo = 60.0;
+constexpr double kMaxTempo = 200.0;
+constexpr float kEpsilon = 1.0e-10f;
+
+double hzToMel(double hz) { return 2595.0 * std::log10(1.0 + hz / 700.0); }
+double melToHz(double mel) { return 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0); }
+
+struct MelFilter
+{
+    int firstBin = 0;
+    std::vector<float> weights;
+};
+
+// Triangular filters evenly spaced on the mel scale, 30 Hz .. min(16 kHz, Nyquist)
+std::vector<MelFilter> makeMelFilters(double sampleRate)
+{
+    const double binHz = sampleRate / kFftSize;
+    const double lo = hzToMel(30.0);
+    const double hi = hzToMel(std::min(16000.0, sampleRate * 0.5));
+    std::vector<double> edges(kNumMelBands + 2);
+    for (size_t i = 0; i < edges.size(); ++i)
+        edges[i] = melToHz(lo + (hi - lo) * static_cast<double>(i) / (kNumMelBands + 1)) / binHz;
+
+    std::vector<MelFilter> filters(kNumMelBands);
+    for (int b = 0; b < kNumMelBands; ++b)
+    {
+        const double left = edges[static_cast<size_t>(b)];
+        const double centre = edges[static_cast<size_t>(b) + 1];
+        const double right = edges[static_cast<size_t>(b) + 2];
+        const int first = std::max(0, static_cast<int>(std::ceil(left)));
+        const int last = std::min(kNumBins - 1, static_cast<int>(std::floor(right)));
+        filters[static_cast<size_t>(b)].firstBin = first;
+        for (int k = first; k <= last; ++k)
+        {
+            const double w = k <= centre ? (k - left) / std::max(1.0e-9, centre - left)
+                                         : (right - k) / std::max(1.0e-9, right - centre);
+            filters[static_cast<size_t>(b)].weights.push_back(static_cast<float>(std::max(0.0, w)));
+        }
+    }
+    return filters;
+}
+
+// Pitch class (0 = C) per FFT bin for 55 Hz .. 5 kHz, -1 elsewhere
+std::vector<int> makeChromaMap(double sampleRate)
+{
+    std::vector<int> map(kNumBins, -1);
+    for (int k = 1; k < kNumBins; ++k)
+    {
+        const double hz = k * sampleRate / kFftSize;
+        if (hz < 55.0 || hz > 5000.0)
+            continue;
+        const int midi = static_cast<int>(std::lround(69.0 + 12.0 * std::log2(hz / 440.0)));
+        map[static_cast<size_t>(k)] = ((midi % 12) + 12) % 12;
+    }
+    return map;
+}
+
+// Autocorrelation of the onset envelope over lags between kMaxTempo and kMinTempo,
+// mildly weighted towards 120 BPM to settle octave ambiguity.
+double estimateTempo(std::vector<float> onset, double hopsPerSecond)
+{
+    const int n = static_cast<int>(onset.size());
+    if (n < kMinHops)
+        return 0.0;
+    float mean = 0.0f;
+    for (float v : onset)
+        mean += v;
+    mean /= static_cast<float>(n);
+    for (auto& v : onset)
+        v -= mean;
+
+    const int minLag = std::max(1, static_cast<int>(std::floor(hopsPerSecond * 60.0 / kMaxTempo)));
+    const int maxLag = std::min(n - 1, static_cast<int>(std::ceil(hopsPerSecond * 60.0 / kMinTempo)));
+    double bestScore = 0.0;
+    double bestTempo = 0.0;
+    for (int lag = minLag; lag <= maxLag; ++lag)
+    {
+        double acf = 0.0;
+        for (int i = lag; i < n; ++i)
+            acf += static_cast<double>(onset[static_cast<size_t>(i)]) * onset[static_cast<size_t>(i - lag)];
+        acf /= (n - lag);
+        const double tempo = 60.0 * hopsPerSecond / lag;
+        const double octaves = std::log2(tempo / 120.0);
+        const double score = acf * std::exp(-0.5 * octaves * octaves);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestTempo = tempo;
+        }
+    }
+    return bestTempo;
+}
+} // namespace
+
+std::vector<float> AudioFeatureExtractor::extract(const float* mono, int numFrames, double sampleRate)
+{
+    if (mono == nullptr || sampleRate <= 0.0)
+        return {};
+    numFrames = std::min(numFrames, static_cast<int>(kMaxAnalysisSeconds * sampleRate));
+    const int numHops = numFrames >= kFftSize ? 1 + (numFrames - kFftSize) / kHopSize : 0;
+    if (numHops < kMinHops)
+        return {};
+
+    juce::dsp::FFT fft(kFftOrder);
+    juce::dsp::WindowingFunction<float> window(kFftSize, juce::dsp::WindowingFunction<float>::hann, false);
+    const std::vector<MelFilter> melFilters = makeMelFilters(sampleRate);
+    const std::vector<int> chromaMap = makeChromaMap(sampleRate);
+
+    // DCT-II basis for log-mel -> MFCC
+    std::vector<float> dct(static_cast<size_t>(kNumMfcc) * kNumMelBands);
+    for (int c = 0; c < kNumMfcc; ++c)
+        for (int b = 0; b < kNumMelBands; ++b)
+            dct[static_cast<size_t>(c * kNumMelBands + b)] =
+                static_cast<float>(std::cos(juce::MathConstants<double>::pi * c * (b + 0.5) / kNumMelBands));
+
+    std::vector<float> frame(2 * kFftSize);
+    std::vector<float> previous(kNumBins, 0.0f);
+    std::vector<float> logMel(kNumMelBands);
+    std::vector<float> onset(static_cast<size_t>(numHops));
+    double mfccSum[kNumMfcc] = {}, mfccSumSq[kNumMfcc] = {}, chromaSum[kNumChroma] = {};
+    double centroidSum = 0.0, flatnessSum = 0.0, fluxSum = 0.0, loudnessSum = 0.0;
+
+    for (int h = 0; h < numHops; ++h)
+    {
+        const float* in = mono + static_cast<size_t>(h) * kHopSize;
+        std::copy(in, in + kFftSize, frame.begin());
+        std::fill(frame.begin() + kFftSize, frame.end(), 0.0f);
+        double energy = 0.0;
+        for (int i = 0; i < kFftSize; ++i)
+            energy += static_cast<double>(in[i]) * in[i];
+        loudnessSum += 20.0 * std::log10(std::sqrt(energy / kFftSize) + 1.0e-9);
+
+        window.multiplyWithWindowingTable(frame.data(), static_cast<size_t>(kFftSize));
+        fft.performFrequencyOnlyForwardTransform(frame.data(), true);
+        const float* mag = frame.data();
+
+        for (int b = 0; b < kNumMelBands; ++b)
+        {
+            const MelFilter& f = melFilters[static_cast<size_t>(b)];
+            float power = 0.0f;
+            for (size_t k = 0; k < f.weights.size(); ++k)
+            {
+                const float m = mag[static_cast<size_t>(f.firstBin) + k];
+                power += f.weights[k] * m * m;
+            }
+            logMel[static_cast<size_t>(b)] = std::log(power + kEpsilon);
+        }
+        for (int c = 0; c < kNumMfcc; ++c)
+        {
+            float v = 0.0f;
+            for (int b = 0; b < kNumMelBands; ++b)
+                v += dct[static_cast<size_t>(c * kNumMelBands + b)] * logMel[static_cast<size_t>(b)];
+            mfccSum[c] += v;
+            mfccSumSq[c] += static_cast<double>(v) * v;
+        }
+
+        float chroma[kNumChroma] = {};
+        double magSum = 0.0, weightedBins = 0.0, logMagSum = 0.0, flux = 0.0;
+        for (int k = 1; k < kNumBins; ++k)
+        {
+            const float m = mag[k];
+            if (chromaMap[static_cast<size_t>(k)] >= 0)
+                chroma[chromaMap[static_cast<size_t>(k)]] += m * m;
+            magSum += m;
+            weightedBins += static_cast<double>(m) * k;
+            logMagSum += std::log(m + kEpsilon);
+            flux += std::max(0.0f, m - previous[static_cast<size_t>(k)]);
+            previous[static_cast<size_t>(k)] = m;
+        }
+        const float chromaMax = *std::max_element(chroma, chroma + kNumChroma);
+        if (chromaMax > 0.0f)
+            for (int p = 0; p < kNumChroma; ++p)
+                chromaSum[p] += chroma[p] / chromaMax;
+        const double meanMag = magSum / (kNumBins - 1);
+        centroidSum += magSum > 0.0 ? weightedBins / magSum / (kNumBins - 1) : 0.0;
+        flatnessSum += meanMag > 0.0 ? std::exp(logMagSum / (kNumBins - 1)) / meanMag : 0.0;
+        flux /= (kNumBins - 1);
+        fluxSum += flux;
+        onset[static_cast<size_t>(h)] = static_cast<float>(flux);
+    }
+
+    std::vector<float> features(kDims, 0.0f);
+    for (int c = 0; c < kNumMfcc; ++c)
+    {
+        const double mean = mfccSum[c] / numHops;
+        features[static_cast<size_t>(c)] = static_cast<float>(mean);
+        features[static_cast<size_t>(kNumMfcc + c)] =
+            static_cast<float>(std::sqrt(std::max(0.0, mfccSumSq[c] / numHops - mean * mean)));
+    }
+    double chromaTotal = 0.0;
+    for (double v : chromaSum)
+        chromaTotal += v;
+    for (int p = 0; p < kNumChroma; ++p)
+        features[static_cast<size_t>(2 * kNumMfcc + p)] = chromaTotal > 0.0 ? static_cast<float>(chromaSum[p] / chromaTotal) : 0.0f;
+    size_t i = 2 * kNumMfcc + kNumChroma;
+    features[i++] = static_cast<float>(centroidSum / numHops);
+    features[i++] = static_cast<float>(flatnessSum / numHops);
+    features[i++] = static_cast<float>(fluxSum / numHops);
+    features[i++] = static_cast<float>(loudnessSum / numHops / 60.0);
+    const double tempo = estimateTempo(std::move(onset), sampleRate / kHopSize);
+    if (tempo > 0.0)
+    {
+        const double angle = 2.0 * juce::MathConstants<double>::pi * std::log2(tempo / 60.0);
+        features[i++] = static_cast<float>(std::cos(angle));
+        features[i++] = static_cast<float>(std::sin(angle));
+    }
+    return features;
+}
+
+std::vector<float> AudioFeatureExtractor::extract(const float* const* channels, int numChannels, int numFrames,
+                                                  double sampleRate)
+{
+    if (channels == nullptr || numChannels <= 0 || numFrames <= 0)
+        return {};
+    numFrames = std::min(numFrames, static_cast<int>(kMaxAnalysisSeconds * sampleRate));
+    std::vector<float> mono(static_cast<size_t>(numFrames), 0.0f);
+    for (int c = 0; c < numChannels; ++c)
+        juce::FloatVectorOperations::addWithMultiply(mono.data(), channels[c], 1.0f / numChannels, numFrames);
+    return extract(mono.data(), numFrames, sampleRate);
+}
+
+std::vector<float> AudioFeatureExtractor::extractFromFile(const juce::File& file)
+{
+    juce::AudioFormatManager fm;
+    fm.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(fm.createReaderFor(file));
+    if (reader == nullptr || reader->numChannels == 0 || reader->sampleRate <= 0.0)
+        return {};
+    const int numCh = static_cast<int>(reader->numChannels);
+    const int numFrames = static_cast<int>(std::min<juce::int64>(reader->lengthInSamples,
+                                                                  static_cast<juce::int64>(kMaxAnalysisSeconds * reader->sampleRate)));
+    if (numFrames <= 0)
+        return {};
+    juce::AudioBuffer<float> buffer(numCh, numFrames);
+    if (!reader->read(&buffer, 0, numFrames, 0, true, true))
+        return {};
+    return extract(buffer.getArrayOfReadPointers(), numCh, numFrames, reader->sampleRate);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <vector>
+
+/**
+ * Compact timbre / harmony / rhythm summary of a piece of audio, used for
+ * "sounds like this" search (SimilarityIndex). The signal is mixed to mono and
+ * analysed with a 2048-point STFT (juce::dsp::FFT, vDSP-backed on macOS) over
+ * at most kMaxAnalysisSeconds. Layout of the returned kDims floats:
+ *   [0, 13)  MFCC means        [13, 26) MFCC standard deviations
+ *   [26, 38) chroma profile (sums to 1)
+ *   38 spectral centroid / Nyquist, 39 spectral flatness,
+ *   40 spectral flux, 41 loudness (mean frame RMS in dBFS / 60)
+ *   [42, 44) tempo as cos / sin of 2*pi*log2(bpm / 60) (double / half tempo map nearby)
+ * An empty vector means the audio was too short or could not be read.
+ */
+class AudioFeatureExtractor
+{
+public:
+    static constexpr int kNumMfcc = 13;
+    static constexpr int kNumChroma = 12;
+    static constexpr int kDims = 2 * kNumMfcc + kNumChroma + 4 + 2;
+    static constexpr double kMaxAnalysisSeconds = 120.0;
+
+    static std::vector<float> extract(const float* mono, int numFrames, double sampleRate);
+    /** Mixes numChannels planar rows to mono first. */
+    static std::vector<float> extract(const float* const* channels, int numChannels, int numFrames, double sampleRate);
+    /** Decodes (any basic format) and analyses the file; blocking. */
+    static std::vector<float> extractFromFile(const juce::File& file);
+};
@@ -0,0 +1,75 @@
+#include "AudioMemoryBudget.h"
+#include <algorithm>
+
+namespace
+{
+constexpr juce::int64 kMinBudgetBytes = 64LL * 1024LL * 1024LL;
+} // namespace
+
+AudioMemoryBudget::AudioMemoryBudget()
+{
+    const juce::File file = getSettingsFile();
+    if (!file.existsAsFile())
+        return;
+    const juce::var root = juce::JSON::parse(file);
+    const auto bytes = static_cast<juce::int64>(root.getProperty("budgetBytes", kDefaultBudgetBytes));
+    budgetBytes_.store(std::max(kMinBudgetBytes, bytes));
+}
+
+juce::File AudioMemoryBudget::getSettingsFile()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("AceForgeSuno")
+        .getChildFile("memory-settings.json");
+}
+
+void AudioMemoryBudget::setBudgetBytes(juce::int64 bytes)
+{
+    budgetBytes_.store(std::max(kMinBudgetBytes, bytes), std::memory_order_relaxed);
+    auto* root = new juce::DynamicObject();
+    root->setProperty("version", 1);
+    root->setProperty("budgetBytes", getBudgetBytes());
+    const juce::File file = getSettingsFile();
+    file.getParentDirectory().createDirectory();
+    file.replaceWithText(juce::JSON::toString(juce::var(root)));
+}
+
+void AudioMemoryBudget::setUsage(const void* owner, juce::int64 bytes)
+{
+    const juce::ScopedLock l(lock_);
+    if (bytes > 0)
+        usage_[owner] = bytes;
+    else
+        usage_.erase(owner);
+}
+
+juce::int64 AudioMemoryBudget::getTotalUsage() const
+{
+    const juce::ScopedLock l(lock_);
+    juce::int64 total = 0;
+    for (const auto& entry : usage_)
+        total += entry.second;
+    return total;
+}
+
+int AudioMemoryBudget::getNumOwners() const
+{
+    const juce::ScopedLock l(lock_);
+    return static_cast<int>(usage_.size());
+}
+
+juce::int64 AudioMemoryBudget::getExcessFor(const void* owner) const
+{
+    const juce::ScopedLock l(lock_);
+    const auto it = usage_.find(owner);
+    if (it == usage_.end())
+        return 0;
+    juce::int64 total = 0;
+    for (const auto& entry : usage_)
+        total += entry.second;
+    const juce::int64 budget = getBudgetBytes();
+    const juce::int64 fairShare = budget / static_cast<juce::int64>(usage_.size());
+    if (total <= budget || it->second <= fairShare)
+        return 0;
+    return std::min(total - budget, it->second - fairShare);
+}
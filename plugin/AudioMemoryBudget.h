@@ -0,0 +1,43 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <map>
+
+/**
+ * Memory budget for captured audio, shared by every plugin instance (owned by
+ * SharedServices). Each instance reports the bytes its segments and capture
+ * buffers hold. While the process total is over the budget, instances holding
+ * more than their fair share (budget / instances) spill their least recently
+ * used segments until they are back at it or the process is under budget, so
+ * one instance recording for hours cannot push the others out. The budget is
+ * a user setting for the whole process, kept in
+ * AceForgeSuno/memory-settings.json. Thread-safe.
+ */
+class AudioMemoryBudget
+{
+public:
+    static constexpr juce::int64 kDefaultBudgetBytes = 1024LL * 1024LL * 1024LL;
+
+    AudioMemoryBudget();
+
+    juce::int64 getBudgetBytes() const { return budgetBytes_.load(std::memory_order_relaxed); }
+    /** Saves the setting; instances apply it on their next check. Message thread. */
+    void setBudgetBytes(juce::int64 bytes);
+
+    /** owner's current usage; 0 removes it. */
+    void setUsage(const void* owner, juce::int64 bytes);
+    juce::int64 getTotalUsage() const;
+    int getNumOwners() const;
+    /** Bytes owner should free to bring the process back under budget; 0 if none. */
+    juce::int64 getExcessFor(const void* owner) const;
+
+private:
+    static juce::File getSettingsFile();
+
+    std::atomic<juce::int64> budgetBytes_{ kDefaultBudgetBytes };
+    juce::CriticalSection lock_;
+    std::map<const void*, juce::int64> usage_;
+
+    JUCE_DECLARE_NON_COPYABLE(AudioMemoryBudget)
+};
@@ -0,0 +1,175 @@
+#include "BlobStore.h"
+#include "ContentHash.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#if JUCE_MAC
+#include <sys/clonefile.h>
+#endif
+
+namespace
+{
+constexpr int kChunkBytes = 1 << 20;
+
+juce::String makeKey(const ContentHash& hash, juce::int64 size)
+{
+    return juce::String(hash.hexDigest()) + "-" + juce::String(size);
+}
+
+const char* path(const juce::File& f)
+{
+    return f.getFullPathName().toRawUTF8();
+}
+} // namespace
+
+juce::File BlobStore::getDirectory()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("AceForgeSuno")
+        .getChildFile("Blobs");
+}
+
+juce::File BlobStore::getBlobFile(const juce::String& key, const juce::String& extension)
+{
+    return getDirectory().getChildFile(key + extension);
+}
+
+juce::String BlobStore::keyFor(const void* data, size_t size)
+{
+    ContentHash hash;
+    hash.update(data, size);
+    return makeKey(hash, static_cast<juce::int64>(size));
+}
+
+juce::String BlobStore::keyForFile(const juce::File& file)
+{
+    juce::FileInputStream in(file);
+    if (!in.openedOk())
+        return {};
+    ContentHash hash;
+    juce::HeapBlock<char> chunk(kChunkBytes);
+    juce::int64 total = 0;
+    for (;;)
+    {
+        const int n = in.read(chunk.getData(), kChunkBytes);
+        if (n <= 0)
+            break;
+        hash.update(chunk.getData(), static_cast<size_t>(n));
+        total += n;
+    }
+    if (total != file.getSize())
+        return {};
+    return makeKey(hash, total);
+}
+
+bool BlobStore::cloneExisting(const juce::String& key, const juce::String& extension,
+                              const void* data, size_t size, const juce::File& target)
+{
+    const juce::File blob = getBlobFile(key, extension);
+    // The key only says "probably identical"; compare bytes so a hash collision can never alias audio
+    if (!blob.existsAsFile() || !contentEquals(blob, data, size))
+        return false;
+    return cloneFile(blob, target);
+}
+
+juce::int64 BlobStore::adopt(const juce::File& file, const juce::String& key)
+{
+    if (key.isEmpty() || !file.existsAsFile())
+        return 0;
+    getDirectory().createDirectory();
+    const juce::File blob = getBlobFile(key, file.getFileExtension());
+    // First file with these bytes: the blob becomes a clone of it. Fails if the blob exists
+    // (another instance may have made it meanwhile) or the volume cannot clone.
+    if (cloneFile(file, blob))
+        return 0;
+    if (!blob.existsAsFile() || !contentEquals(file, blob))
+        return 0;
+
+    // Identical blob already stored: swap file for a clone of it (clone to a temp name, then rename over)
+    const juce::File temp = file.getSiblingFile(file.getFileName() + ".clone");
+    temp.deleteFile();
+    if (!cloneFile(blob, temp))
+        return 0;
+    const juce::int64 saved = file.getSize();
+    if (std::rename(path(temp), path(file)) != 0)
+    {
+        temp.deleteFile();
+        return 0;
+    }
+    return saved;
+}
+
+bool BlobStore::exists(const juce::String& key, const juce::String& extension)
+{
+    return key.isNotEmpty() && getBlobFile(key, extension).existsAsFile();
+}
+
+void BlobStore::release(const juce::String& key, const juce::String& extension)
+{
+    if (key.isNotEmpty())
+        getBlobFile(key, extension).deleteFile();
+}
+
+juce::int64 BlobStore::collectGarbage(const std::set<juce::String>& liveKeys)
+{
+    juce::int64 freed = 0;
+    for (const auto& item : juce::RangedDirectoryIterator(getDirectory(), false, "*", juce::File::findFiles))
+    {
+        const juce::File blob = item.getFile();
+        if (liveKeys.count(blob.getFileNameWithoutExtension()) == 0)
+        {
+            const juce::int64 size = item.getFileSize();
+            if (blob.deleteFile())
+                freed += size;
+        }
+    }
+    return freed;
+}
+
+bool BlobStore::cloneFile(const juce::File& source, const juce::File& target)
+{
+#if JUCE_MAC
+    return ::clonefile(path(source), path(target), 0) == 0;
+#else
+    juce::ignoreUnused(source, target);
+    return false;
+#endif
+}
+
+bool BlobStore::contentEquals(const juce::File& file, const void* data, size_t size)
+{
+    if (file.getSize() != static_cast<juce::int64>(size))
+        return false;
+    juce::FileInputStream in(file);
+    if (!in.openedOk())
+        return false;
+    juce::HeapBlock<char> chunk(kChunkBytes);
+    const auto* bytes = static_cast<const char*>(data);
+    size_t pos = 0;
+    while (pos < size)
+    {
+        const int want = static_cast<int>(std::min<size_t>(kChunkBytes, size - pos));
+        if (in.read(chunk.getData(), want) != want || std::memcmp(chunk.getData(), bytes + pos, static_cast<size_t>(want)) != 0)
+            return false;
+        pos += static_cast<size_t>(want);
+    }
+    return true;
+}
+
+bool BlobStore::contentEquals(const juce::File& a, const juce::File& b)
+{
+    if (a.getSize() != b.getSize())
+        return false;
+    juce::FileInputStream inA(a), inB(b);
+    if (!inA.openedOk() || !inB.openedOk())
+        return false;
+    juce::HeapBlock<char> chunkA(kChunkBytes), chunkB(kChunkBytes);
+    for (;;)
+    {
+        const int n = inA.read(chunkA.getData(), kChunkBytes);
+        if (n <= 0)
+            return inB.isExhausted();
+        if (inB.read(chunkB.getData(), n) != n || std::memcmp(chunkA.getData(), chunkB.getData(), static_cast<size_t>(n)) != 0)
+            return false;
+    }
+}
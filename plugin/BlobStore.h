@@ -0,0 +1,53 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <set>
+
+/**
+ * Content-addressed store for library audio (AceForgeSuno/Blobs/<key><ext>).
+ * A key is the XXH64 of the bytes plus their size ("<16 hex>-<bytes>").
+ * Library files in Generations/ stay ordinary files that DAWs can open; each
+ * one is a copy-on-write clone of its blob (clonefile() on APFS), so
+ * byte-identical results occupy the disk once however many names point at
+ * them, yet editing one file in place never changes the others. Where the
+ * volume cannot clone, no blob is made and files stay plain copies. Clones
+ * are independent files, so the library (not the file system) knows whether
+ * a blob is still used, and deleting one never loses audio.
+ * Stateless; all operations rely on atomic clonefile()/rename(), so
+ * concurrent instances need no lock. Blocking file I/O: call off the message
+ * thread.
+ */
+class BlobStore
+{
+public:
+    static juce::File getDirectory();
+    static juce::File getBlobFile(const juce::String& key, const juce::String& extension);
+
+    /** Key for bytes in memory. */
+    static juce::String keyFor(const void* data, size_t size);
+    /** Key streamed from a file; empty if the file cannot be read. */
+    static juce::String keyForFile(const juce::File& file);
+
+    /** If a blob with key holds exactly these bytes, creates target as a clone of it and
+        returns true. Returns false (creating nothing) otherwise. */
+    static bool cloneExisting(const juce::String& key, const juce::String& extension,
+                              const void* data, size_t size, const juce::File& target);
+
+    /** Clones file into the blob for key, or, if an identical blob already exists,
+        atomically replaces file with a clone of it. Returns the bytes saved by sharing. */
+    static juce::int64 adopt(const juce::File& file, const juce::String& key);
+
+    /** True if a blob is stored for key: library files with that key then share its data. */
+    static bool exists(const juce::String& key, const juce::String& extension);
+    /** Deletes the blob for key; call once no library file with that key is left. */
+    static void release(const juce::String& key, const juce::String& extension);
+    /** Deletes every blob whose key is not in liveKeys (e.g. left over after a crash); returns
+        the bytes freed. */
+    static juce::int64 collectGarbage(const std::set<juce::String>& liveKeys);
+
+private:
+    /** Copy-on-write clone of source at target; false where the volume or platform has none. */
+    static bool cloneFile(const juce::File& source, const juce::File& target);
+    static bool contentEquals(const juce::File& file, const void* data, size_t size);
+    static bool contentEquals(const juce::File& a, const juce::File& b);
+};
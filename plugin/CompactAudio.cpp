@@ -0,0 +1,505 @@
+#include "CompactAudio.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+enum BlockMode : juce::uint8
+{
+    kConstant = 0,   // one bit pattern repeated
+    kVerbatim = 1,   // raw floats
+    kInteger = 2,    // integers scaled by 2^-shift, predicted
+    kFloatBits = 3   // ordered bit patterns, predicted
+};
+
+constexpr int kMaxFixedOrder = 4;
+constexpr int kMaxLpcOrder = 12;
+constexpr int kLpcOrders[] = { 8, kMaxLpcOrder };
+constexpr int kLpcPrecision = 15;    // bits per quantised coefficient, sign included
+constexpr int kMaxLpcShift = 24;
+constexpr int kPartitionFrames = 256;
+constexpr int kMaxRiceParameter = 40;
+constexpr int kEscapeQuotient = 24;  // this many 1s: the value follows in kEscapeBits
+constexpr int kEscapeBits = 40;
+constexpr int kWarmUpBits = 34;
+constexpr juce::int64 kMaxResidual = juce::int64(1) << (kEscapeBits - 2);
+
+// Float bit patterns as integers in the order of their values (-0 just below +0)
+juce::int64 toOrdered(juce::uint32 bits)
+{
+    const juce::uint32 ordered = (bits & 0x80000000u) != 0 ? ~bits : (bits | 0x80000000u);
+    return static_cast<juce::int64>(ordered) - (juce::int64(1) << 31);
+}
+
+juce::uint32 fromOrdered(juce::int64 value)
+{
+    const auto ordered = static_cast<juce::uint32>(value + (juce::int64(1) << 31));
+    return (ordered & 0x80000000u) != 0 ? (ordered & 0x7fffffffu) : ~ordered;
+}
+
+juce::uint64 zigzag(juce::int64 v) { return (static_cast<juce::uint64>(v) << 1) ^ static_cast<juce::uint64>(v >> 63); }
+juce::int64 unzigzag(juce::uint64 u) { return static_cast<juce::int64>(u >> 1) ^ -static_cast<juce::int64>(u & 1); }
+
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<juce::uint8>& out) : out_(out) {}
+
+    /** value must fit in numBits (at most 56). */
+    void write(juce::uint64 value, int numBits)
+    {
+        acc_ = (acc_ << numBits) | value;
+        count_ += numBits;
+        while (count_ >= 8)
+        {
+            count_ -= 8;
+            out_.push_back(static_cast<juce::uint8>(acc_ >> count_));
+        }
+    }
+
+    void writeRice(juce::uint64 u, int k)
+    {
+        const juce::uint64 q = u >> k;
+        if (q >= static_cast<juce::uint64>(kEscapeQuotient))
+        {
+            write((juce::uint64(1) << kEscapeQuotient) - 1, kEscapeQuotient);
+            write(u, kEscapeBits);
+            return;
+        }
+        write(((juce::uint64(1) << q) - 1) << 1, static_cast<int>(q) + 1);   // q ones and a zero
+        if (k > 0)
+            write(u & ((juce::uint64(1) << k) - 1), k);
+    }
+
+    void flush()
+    {
+        if (count_ > 0)
+            out_.push_back(static_cast<juce::uint8>(acc_ << (8 - count_)));
+        count_ = 0;
+    }
+
+private:
+    std::vector<juce::uint8>& out_;
+    juce::uint64 acc_ = 0;   // the low count_ bits are pending
+    int count_ = 0;
+};
+
+class BitReader
+{
+public:
+    BitReader(const juce::uint8* data, const juce::uint8* end) : p_(data), end_(end) {}
+
+    /** numBits at most 56. */
+    juce::uint64 read(int numBits)
+    {
+        if (numBits == 0)
+            return 0;
+        refill();
+        const juce::uint64 value = acc_ >> (64 - numBits);
+        consume(numBits);
+        return value;
+    }
+
+    juce::uint64 readRice(int k)
+    {
+        juce::uint64 q = 0;
+        for (;;)
+        {
+            refill();
+            const int ones = ~acc_ == 0 ? 64 : __builtin_clzll(~acc_);
+            if (q + static_cast<juce::uint64>(ones) >= static_cast<juce::uint64>(kEscapeQuotient))
+            {
+                consume(kEscapeQuotient - static_cast<int>(q));
+                return read(kEscapeBits);
+            }
+            if (ones < count_)
+            {
+                q += static_cast<juce::uint64>(ones);
+                consume(ones + 1);
+                break;
+            }
+            q += static_cast<juce::uint64>(count_);
+            consume(count_);
+        }
+        return (q << k) | read(k);
+    }
+
+private:
+    void refill()
+    {
+        while (count_ <= 56)
+        {
+            const juce::uint64 byte = p_ < end_ ? *p_++ : 0;
+            acc_ |= byte << (56 - count_);
+            count_ += 8;
+        }
+    }
+
+    void consume(int numBits)
+    {
+        acc_ = numBits >= 64 ? 0 : acc_ << numBits;
+        count_ -= numBits;
+    }
+
+    const juce::uint8* p_;
+    const juce::uint8* end_;
+    juce::uint64 acc_ = 0;   // the top count_ bits are unread
+    int count_ = 0;
+};
+
+// x[i] - (sum of coefs[j] * x[i - 1 - j]) >> shift
+struct Predictor
+{
+    bool isLpc = false;
+    int order = 0;
+    int shift = 0;
+    std::array<juce::int64, kMaxLpcOrder> coefs{};
+};
+
+constexpr juce::int64 kFixedCoefs[kMaxFixedOrder + 1][kMaxFixedOrder] = {
+    { 0, 0, 0, 0 }, { 1, 0, 0, 0 }, { 2, -1, 0, 0 }, { 3, -3, 1, 0 }, { 4, -6, 4, -1 }
+};
+
+juce::int64 predict(const Predictor& p, const juce::int64* history)
+{
+    juce::int64 sum = 0;
+    for (int j = 0; j < p.order; ++j)
+        sum += p.coefs[static_cast<size_t>(j)] * history[-1 - j];
+    return sum >> p.shift;
+}
+
+// Residuals of v after its first p.order samples; false if one is too large to code
+bool computeResiduals(const Predictor& p, const juce::int64* v, int n, juce::int64* residuals)
+{
+    for (int i = p.order; i < n; ++i)
+    {
+        const juce::int64 r = v[i] - predict(p, v + i);
+        if (r >= kMaxResidual || r <= -kMaxResidual)
+            return false;
+        residuals[i - p.order] = r;
+    }
+    return true;
+}
+
+// Cheapest Rice parameter per partition of residuals; returns their total size in bits
+juce::int64 chooseRiceParameters(const juce::int64* residuals, int n, std::vector<int>& params)
+{
+    params.clear();
+    juce::int64 total = 0;
+    for (int start = 0; start < n; start += kPartitionFrames)
+    {
+        const int count = std::min(kPartitionFrames, n - start);
+        juce::uint64 sum = 0;
+        for (int i = 0; i < count; ++i)
+            sum += zigzag(residuals[start + i]);
+        const juce::uint64 mean = sum / static_cast<juce::uint64>(count);
+        const int guess = mean == 0 ? 0 : 63 - __builtin_clzll(mean);
+        int bestK = 0;
+        juce::int64 bestBits = -1;
+        for (int k = std::max(0, guess - 1); k <= std::min(kMaxRiceParameter, guess + 1); ++k)
+        {
+            juce::int64 bits = 6;
+            for (int i = 0; i < count; ++i)
+            {
+                const juce::uint64 q = zigzag(residuals[start + i]) >> k;
+                bits += q < static_cast<juce::uint64>(kEscapeQuotient) ? static_cast<juce::int64>(q) + 1 + k
+                                                                        : kEscapeQuotient + kEscapeBits;
+            }
+            if (bestBits < 0 || bits < bestBits)
+            {
+                bestBits = bits;
+                bestK = k;
+            }
+        }
+        params.push_back(bestK);
+        total += bestBits;
+    }
+    return total;
+}
+
+// LPC predictors of each order in kLpcOrders: Welch-windowed autocorrelation, Levinson-Durbin,
+// coefficients quantised to kLpcPrecision bits
+std::vector<Predictor> lpcPredictors(const juce::int64* v, int n)
+{
+    std::vector<Predictor> predictors;
+    if (n <= kMaxLpcOrder * 2)
+        return predictors;
+    std::vector<double> windowed(static_cast<size_t>(n));
+    for (int i = 0; i < n; ++i)
+    {
+        const double t = (2.0 * i - (n - 1)) / (n + 1);
+        windowed[static_cast<size_t>(i)] = static_cast<double>(v[i]) * (1.0 - t * t);
+    }
+    std::array<double, kMaxLpcOrder + 1> autoc{};
+    for (int lag = 0; lag <= kMaxLpcOrder; ++lag)
+        for (int i = lag; i < n; ++i)
+            autoc[static_cast<size_t>(lag)] += windowed[static_cast<size_t>(i)] * windowed[static_cast<size_t>(i - lag)];
+    if (autoc[0] <= 0.0)
+        return predictors;
+
+    std::array<double, kMaxLpcOrder> lpc{};
+    std::array<double, kMaxLpcOrder> previous{};
+    double error = autoc[0];
+    for (int order = 1; order <= kMaxLpcOrder; ++order)
+    {
+        double acc = autoc[static_cast<size_t>(order)];
+        for (int j = 0; j < order - 1; ++j)
+            acc -= lpc[static_cast<size_t>(j)] * autoc[static_cast<size_t>(order - 1 - j)];
+        const double reflection = acc / error;
+        previous = lpc;
+        for (int j = 0; j < order - 1; ++j)
+            lpc[static_cast<size_t>(j)] = previous[static_cast<size_t>(j)] - reflection * previous[static_cast<size_t>(order - 2 - j)];
+        lpc[static_cast<size_t>(order - 1)] = reflection;
+        error *= 1.0 - reflection * reflection;
+        if (error <= 0.0)
+            return predictors;
+
+        if (std::find(std::begin(kLpcOrders), std::end(kLpcOrders), order) == std::end(kLpcOrders))
+            continue;
+        double maxCoef = 0.0;
+        for (int j = 0; j < order; ++j)
+            maxCoef = std::max(maxCoef, std::abs(lpc[static_cast<size_t>(j)]));
+        int exponent = 0;
+        std::frexp(maxCoef, &exponent);   // maxCoef < 2^exponent
+        Predictor p;
+        p.isLpc = true;
+        p.order = order;
+        p.shift = std::min(kMaxLpcShift, kLpcPrecision - 1 - exponent);
+        if (p.shift < 0)
+            continue;
+        const auto limit = juce::int64(1) << (kLpcPrecision - 1);
+        for (int j = 0; j < order; ++j)
+            p.coefs[static_cast<size_t>(j)] = std::max(-limit, std::min(limit - 1,
+                static_cast<juce::int64>(std::lround(std::ldexp(lpc[static_cast<size_t>(j)], p.shift)))));
+        predictors.push_back(p);
+    }
+    return predictors;
+}
+
+// Every sample as an integer times 2^-shift, if one shift makes them all fit in 31 bits;
+// -0, infinities and NaNs have no integer form
+bool findIntegerShift(const float* x, int n, int& shift)
+{
+    int needed = 0;
+    int maxExponent = -1000;
+    for (int i = 0; i < n; ++i)
+    {
+        juce::uint32 bits;
+        std::memcpy(&bits, x + i, sizeof(bits));
+        if (bits == 0)
+            continue;
+        const int field = static_cast<int>((bits >> 23) & 0xff);
+        if (bits == 0x80000000u || field == 0xff)
+            return false;
+        // |x| = mantissa * 2^(exponent - 150), mantissa below 2^24
+        const juce::uint32 mantissa = field == 0 ? (bits & 0x7fffffu) : ((bits & 0x7fffffu) | 0x800000u);
+        const int exponent = field == 0 ? 1 : field;
+        needed = std::max(needed, 150 - exponent - __builtin_ctz(mantissa));
+        maxExponent = std::max(maxExponent, exponent);
+    }
+    shift = needed;
+    return maxExponent - 126 + shift <= 31 && shift <= 255;   // |x| < 2^(exponent - 126)
+}
+
+void writeVerbatim(const float* x, int n, std::vector<juce::uint8>& out)
+{
+    out.resize(1 + static_cast<size_t>(n) * sizeof(float));
+    out[0] = kVerbatim;
+    std::memcpy(out.data() + 1, x, static_cast<size_t>(n) * sizeof(float));
+}
+
+std::vector<juce::uint8> encodeBlock(const float* x, int n)
+{
+    std::vector<juce::uint8> out;
+    juce::uint32 first;
+    std::memcpy(&first, x, sizeof(first));
+    bool constant = true;
+    for (int i = 1; i < n && constant; ++i)
+        constant = std::memcmp(x + i, &first, sizeof(first)) == 0;
+    if (constant)
+    {
+        BitWriter writer(out);
+        writer.write(kConstant, 8);
+        writer.write(first, 32);
+        writer.flush();
+        return out;
+    }
+
+    std::vector<juce::int64> v(static_cast<size_t>(n));
+    int shift = 0;
+    const bool isInteger = findIntegerShift(x, n, shift);
+    for (int i = 0; i < n; ++i)
+    {
+        if (isInteger)
+        {
+            v[static_cast<size_t>(i)] = static_cast<juce::int64>(std::ldexp(static_cast<double>(x[i]), shift));
+        }
+        else
+        {
+            juce::uint32 bits;
+            std::memcpy(&bits, x + i, sizeof(bits));
+            v[static_cast<size_t>(i)] = toOrdered(bits);
+        }
+    }
+
+    // The cheapest predictor by exact coded size
+    std::vector<Predictor> candidates;
+    for (int order = 0; order <= kMaxFixedOrder && order < n; ++order)
+    {
+        Predictor p;
+        p.order = order;
+        std::copy(kFixedCoefs[order], kFixedCoefs[order] + kMaxFixedOrder, p.coefs.begin());
+        candidates.push_back(p);
+    }
+    for (const auto& p : lpcPredictors(v.data(), n))
+        candidates.push_back(p);
+
+    std::vector<juce::int64> residuals(static_cast<size_t>(n));
+    std::vector<int> params;
+    const Predictor* best = nullptr;
+    juce::int64 bestBits = 0;
+    for (const auto& p : candidates)
+    {
+        if (!computeResiduals(p, v.data(), n, residuals.data()))
+            continue;
+        juce::int64 bits = 5 + p.order * kWarmUpBits + (p.isLpc ? 5 + p.order * kLpcPrecision : 0);
+        bits += chooseRiceParameters(residuals.data(), n - p.order, params);
+        if (best == nullptr || bits < bestBits)
+        {
+            best = &p;
+            bestBits = bits;
+        }
+    }
+    if (best == nullptr || bestBits / 8 + 2 >= static_cast<juce::int64>(n) * static_cast<juce::int64>(sizeof(float)))
+    {
+        writeVerbatim(x, n, out);
+        return out;
+    }
+
+    computeResiduals(*best, v.data(), n, residuals.data());
+    chooseRiceParameters(residuals.data(), n - best->order, params);
+    out.reserve(static_cast<size_t>(bestBits / 8 + 4));
+    BitWriter writer(out);
+    writer.write(isInteger ? kInteger : kFloatBits, 8);
+    if (isInteger)
+        writer.write(static_cast<juce::uint64>(shift), 8);
+    writer.write(best->isLpc ? 1 : 0, 1);
+    writer.write(static_cast<juce::uint64>(best->order), 4);
+    if (best->isLpc)
+    {
+        writer.write(static_cast<juce::uint64>(best->shift), 5);
+        for (int j = 0; j < best->order; ++j)
+            writer.write(static_cast<juce::uint64>(best->coefs[static_cast<size_t>(j)]) & ((juce::uint64(1) << kLpcPrecision) - 1),
+                         kLpcPrecision);
+    }
+    for (int i = 0; i < best->order; ++i)
+        writer.write(zigzag(v[static_cast<size_t>(i)]), kWarmUpBits);
+    const int numResiduals = n - best->order;
+    for (int start = 0, partition = 0; start < numResiduals; start += kPartitionFrames, ++partition)
+    {
+        const int k = params[static_cast<size_t>(partition)];
+        writer.write(static_cast<juce::uint64>(k), 6);
+        const int end = std::min(numResiduals, start + kPartitionFrames);
+        for (int i = start; i < end; ++i)
+            writer.writeRice(zigzag(residuals[static_cast<size_t>(i)]), k);
+    }
+    writer.flush();
+    return out;
+}
+
+void decodeBlock(const std::vector<juce::uint8>& block, int n, float* x)
+{
+    if (block[0] == kVerbatim)
+    {
+        std::memcpy(x, block.data() + 1, static_cast<size_t>(n) * sizeof(float));
+        return;
+    }
+    BitReader reader(block.data() + 1, block.data() + block.size());
+    if (block[0] == kConstant)
+    {
+        const auto bits = static_cast<juce::uint32>(reader.read(32));
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        std::fill(x, x + n, value);
+        return;
+    }
+
+    const bool isInteger = block[0] == kInteger;
+    const int shift = isInteger ? static_cast<int>(reader.read(8)) : 0;
+    Predictor p;
+    p.isLpc = reader.read(1) != 0;
+    p.order = static_cast<int>(reader.read(4));
+    if (p.isLpc)
+    {
+        p.shift = static_cast<int>(reader.read(5));
+        for (int j = 0; j < p.order; ++j)
+        {
+            const auto raw = static_cast<juce::int64>(reader.read(kLpcPrecision));
+            p.coefs[static_cast<size_t>(j)] = raw >= (juce::int64(1) << (kLpcPrecision - 1)) ? raw - (juce::int64(1) << kLpcPrecision) : raw;
+        }
+    }
+    else
+    {
+        std::copy(kFixedCoefs[p.order], kFixedCoefs[p.order] + kMaxFixedOrder, p.coefs.begin());
+    }
+
+    std::vector<juce::int64> v(static_cast<size_t>(n));
+    for (int i = 0; i < p.order; ++i)
+        v[static_cast<size_t>(i)] = unzigzag(reader.read(kWarmUpBits));
+    for (int start = p.order; start < n; start += kPartitionFrames)
+    {
+        const int k = static_cast<int>(reader.read(6));
+        const int end = std::min(n, start + kPartitionFrames);
+        for (int i = start; i < end; ++i)
+            v[static_cast<size_t>(i)] = unzigzag(reader.readRice(k)) + predict(p, v.data() + i);
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+        if (isInteger)
+        {
+            x[i] = static_cast<float>(std::ldexp(static_cast<double>(v[static_cast<size_t>(i)]), -shift));
+        }
+        else
+        {
+            const juce::uint32 bits = fromOrdered(v[static_cast<size_t>(i)]);
+            std::memcpy(x + i, &bits, sizeof(bits));
+        }
+    }
+}
+} // namespace
+
+std::shared_ptr<const CompactAudio> CompactAudio::encode(const SegmentAudio& audio, const ParallelFor& parallelFor)
+{
+    auto compact = std::make_shared<CompactAudio>();
+    compact->numChannels_ = audio.getNumChannels();
+    compact->numFrames_ = audio.getNumFrames();
+    compact->numBlocks_ = (compact->numFrames_ + kBlockFrames - 1) / kBlockFrames;
+    const int numBlocks = compact->numBlocks_;
+    compact->blocks_.resize(static_cast<size_t>(compact->numChannels_) * static_cast<size_t>(numBlocks));
+    parallelFor(static_cast<int>(compact->blocks_.size()), [&](int item)
+    {
+        const int channel = item / numBlocks;
+        const int start = (item % numBlocks) * kBlockFrames;
+        compact->blocks_[static_cast<size_t>(item)] = encodeBlock(audio.getReadPointer(channel, start),
+                                                                  std::min(kBlockFrames, compact->numFrames_ - start));
+    });
+    for (const auto& block : compact->blocks_)
+        compact->sizeInBytes_ += block.size();
+    return compact;
+}
+
+SegmentAudio CompactAudio::decode(const ParallelFor& parallelFor) const
+{
+    SegmentAudio audio(numChannels_, numFrames_);
+    parallelFor(static_cast<int>(blocks_.size()), [&](int item)
+    {
+        const int channel = item / numBlocks_;
+        const int start = (item % numBlocks_) * kBlockFrames;
+        decodeBlock(blocks_[static_cast<size_t>(item)], std::min(kBlockFrames, numFrames_ - start),
+                    audio.getWritePointer(channel, start));
+    });
+    return audio;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include "SegmentAudio.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * SegmentAudio compressed losslessly, so a segment nobody has used for a while
+ * can stay in memory at a fraction of its size. Every channel is cut into
+ * blocks of kBlockFrames coded on their own, so blocks encode and decode in
+ * parallel.
+ *
+ * A block whose samples are all integers times one power of two (audio from a
+ * 16- or 24-bit interface is) is coded like FLAC: the cheapest of the fixed
+ * polynomial predictors and quantised LPC predictors, then Rice-coded
+ * residuals with a parameter per partition. Other float audio is predicted on
+ * its bit patterns mapped to ordered integers, which compresses less but is
+ * just as exact. A silent block costs five bytes, and no block costs more than
+ * its raw floats plus one byte. Immutable once built.
+ */
+class CompactAudio
+{
+public:
+    static constexpr int kBlockFrames = 4096;
+
+    /** Runs item(0 .. numItems - 1), possibly in parallel, and returns when all are done. */
+    using ParallelFor = std::function<void(int numItems, const std::function<void(int)>& item)>;
+
+    static std::shared_ptr<const CompactAudio> encode(const SegmentAudio& audio, const ParallelFor& parallelFor);
+    /** The original samples, bit for bit. */
+    SegmentAudio decode(const ParallelFor& parallelFor) const;
+
+    int getNumChannels() const { return numChannels_; }
+    int getNumFrames() const { return numFrames_; }
+    size_t getSizeInBytes() const { return sizeInBytes_; }
+
+private:
+    int numChannels_ = 0;
+    int numFrames_ = 0;
+    int numBlocks_ = 0;
+    size_t sizeInBytes_ = 0;
+    std::vector<std::vector<juce::uint8>> blocks_;   // [channel * numBlocks_ + block]
+};
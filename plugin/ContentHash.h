@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+ * Streaming 64-bit content hash (XXH64 algorithm). Fast enough to run over
+ * tens of MB of audio on a worker thread; not a cryptographic hash.
+ */
+class ContentHash
+{
+public:
+    explicit ContentHash(uint64_t seed = 0) { reset(seed); }
+
+    void reset(uint64_t seed = 0)
+    {
+        seed_ = seed;
+        v1_ = seed + kPrime1 + kPrime2;
+        v2_ = seed + kPrime2;
+        v3_ = seed;
+        v4_ = seed - kPrime1;
+        totalLength_ = 0;
+        bufferedBytes_ = 0;
+    }
+
+    void update(const void* data, size_t size)
+    {
+        if (data == nullptr || size == 0)
+            return;
+        auto* p = static_cast<const uint8_t*>(data);
+        totalLength_ += size;
+
+        if (bufferedBytes_ + size < sizeof(buffer_))
+        {
+            std::memcpy(buffer_ + bufferedBytes_, p, size);
+            bufferedBytes_ += size;
+            return;
+        }
+        if (bufferedBytes_ > 0)
+        {
+            const size_t fill = sizeof(buffer_) - bufferedBytes_;
+            std::memcpy(buffer_ + bufferedBytes_, p, fill);
+            consumeStripe(buffer_);
+            p += fill;
+            size -= fill;
+            bufferedBytes_ = 0;
+        }
+        while (size >= sizeof(buffer_))
+        {
+            consumeStripe(p);
+            p += sizeof(buffer_);
+            size -= sizeof(buffer_);
+        }
+        if (size > 0)
+        {
+            std::memcpy(buffer_, p, size);
+            bufferedBytes_ = size;
+        }
+    }
+
+    template <typename T>
+    void updateValue(const T& value) { update(&value, sizeof(T)); }
+
+    uint64_t digest() const
+    {
+        uint64_t h;
+        if (totalLength_ >= sizeof(buffer_))
+        {
+            h = rotl(v1_, 1) + rotl(v2_, 7) + rotl(v3_, 12) + rotl(v4_, 18);
+            h = mergeRound(h, v1_);
+            h = mergeRound(h, v2_);
+            h = mergeRound(h, v3_);
+            h = mergeRound(h, v4_);
+        }
+        else
+        {
+            h = seed_ + kPrime5;
+        }
+        h += totalLength_;
+
+        const uint8_t* p = buffer_;
+        size_t remaining = bufferedBytes_;
+        while (remaining >= 8)
+        {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * kPrime1 + kPrime4;
+            p += 8;
+            remaining -= 8;
+        }
+        if (remaining >= 4)
+        {
+            h ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+            h = rotl(h, 23) * kPrime2 + kPrime3;
+            p += 4;
+            remaining -= 4;
+        }
+        while (remaining > 0)
+        {
+            h ^= static_cast<uint64_t>(*p) * kPrime5;
+            h = rotl(h, 11) * kPrime1;
+            ++p;
+            --remaining;
+        }
+        h ^= h >> 33;
+        h *= kPrime2;
+        h ^= h >> 29;
+        h *= kPrime3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    /** 16 lowercase hex digits, usable as a file name or cache key. */
+    std::string hexDigest() const { return toHex(digest()); }
+
+    static std::string toHex(uint64_t value)
+    {
+        static const char* digits = "0123456789abcdef";
+        std::string out(16, '0');
+        for (int i = 15; i >= 0; --i)
+        {
+            out[static_cast<size_t>(i)] = digits[value & 0xf];
+            value >>= 4;
+        }
+        return out;
+    }
+
+private:
+    static constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+    static constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+    static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+    static uint64_t read64(const uint8_t* p) { uint64_t v; std::memcpy(&v, p, 8); return v; }
+    static uint32_t read32(const uint8_t* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+
+    static uint64_t round(uint64_t acc, uint64_t input)
+    {
+        acc += input * kPrime2;
+        acc = rotl(acc, 31);
+        return acc * kPrime1;
+    }
+
+    static uint64_t mergeRound(uint64_t acc, uint64_t value)
+    {
+        acc ^= round(0, value);
+        return acc * kPrime1 + kPrime4;
+    }
+
+    void consumeStripe(const uint8_t* p)
+    {
+        v1_ = round(v1_, read64(p));
+        v2_ = round(v2_, read64(p + 8));
+        v3_ = round(v3_, read64(p + 16));
+        v4_ = round(v4_, read64(p + 24));
+    }
+
+    uint64_t seed_ = 0;
+    uint64_t v1_ = 0, v2_ = 0, v3_ = 0, v4_ = 0;
+    uint64_t totalLength_ = 0;
+    uint8_t buffer_[32] = {};
+    size_t bufferedBytes_ = 0;
+};
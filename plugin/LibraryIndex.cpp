@@ -0,0 +1,782 @@
+#include "LibraryIndex.h"
+#include "AudioFeatures.h"
+#include "BlobStore.h"
+#include "WaveformPeaks.h"
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+namespace
+{
+constexpr int kDecodeBlockFrames = 1 << 16;
+
+// One decode of file for both backfills: every block goes through the TrackAnalyzer, and the
+// first AudioFeatureExtractor::kMaxAnalysisSeconds are kept for the feature vector. Either
+// output may be null; both are left empty / invalid if the file cannot be read.
+void analyseFile(const juce::File& file, std::vector<float>* features, TrackAnalysis* analysis)
+{
+    juce::AudioFormatManager fm;
+    fm.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(fm.createReaderFor(file));
+    if (reader == nullptr || reader->numChannels == 0 || reader->sampleRate <= 0.0 || reader->lengthInSamples <= 0)
+        return;
+    const int numCh = static_cast<int>(reader->numChannels);
+    const auto maxFeatureFrames = static_cast<juce::int64>(AudioFeatureExtractor::kMaxAnalysisSeconds * reader->sampleRate);
+    const int featureFrames = features != nullptr ? static_cast<int>(std::min(reader->lengthInSamples, maxFeatureFrames)) : 0;
+    const juce::int64 length = analysis != nullptr ? reader->lengthInSamples : featureFrames;
+    std::unique_ptr<TrackAnalyzer> analyzer;
+    if (analysis != nullptr)
+        analyzer = std::make_unique<TrackAnalyzer>(reader->sampleRate, numCh);
+    juce::AudioBuffer<float> head(numCh, featureFrames);
+    juce::AudioBuffer<float> block(numCh, kDecodeBlockFrames);
+    for (juce::int64 pos = 0; pos < length; pos += kDecodeBlockFrames)
+    {
+        const int n = static_cast<int>(std::min<juce::int64>(kDecodeBlockFrames, length - pos));
+        if (!reader->read(&block, 0, n, pos, true, true))
+            return;
+        if (analyzer != nullptr)
+            analyzer->process(block.getArrayOfReadPointers(), n);
+        const int keep = static_cast<int>(std::min<juce::int64>(n, featureFrames - pos));
+        for (int c = 0; c < numCh && keep > 0; ++c)
+            head.copyFrom(c, static_cast<int>(pos), block, c, 0, keep);
+    }
+    if (features != nullptr)
+        *features = AudioFeatureExtractor::extract(head.getArrayOfReadPointers(), numCh, featureFrames, reader->sampleRate);
+    if (analyzer != nullptr)
+        *analysis = analyzer->finish();
+}
+} // namespace
+
+LibraryIndex::LibraryIndex()
+    : juce::Thread("AceForgeSuno library index"),
+      snapshot_(std::make_shared<const Snapshot>()),
+      indexFile_(getLibraryDirectory().getSiblingFile("library.idx"))
+{
+    loadSettings();
+    Snapshot entries;
+    if (indexFile_.load(getLibraryDirectory(), entries))
+    {
+        for (auto& e : entries)
+            indexForSearch(e);
+        sortNewestFirst(entries);
+        publish(std::move(entries));
+    }
+    startThread(juce::Thread::Priority::low);
+}
+
+LibraryIndex::~LibraryIndex()
+{
+    stopThread(4000);
+}
+
+juce::File LibraryIndex::getLibraryDirectory()
+{
+    juce::File dir = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                         .getChildFile("AceForgeSuno")
+                         .getChildFile("Generations");
+    if (!dir.exists())
+        dir.createDirectory();
+    return dir;
+}
+
+juce::String LibraryIndex::sniffAudioExtension(const void* data, size_t size)
+{
+    const auto* b = static_cast<const juce::uint8*>(data);
+    auto hasMagic = [b, size](size_t offset, const char* magic)
+    {
+        const size_t len = std::strlen(magic);
+        return b != nullptr && size >= offset + len && std::memcmp(b + offset, magic, len) == 0;
+    };
+    if (hasMagic(0, "RIFF") && hasMagic(8, "WAVE"))
+        return ".wav";
+    if (hasMagic(0, "fLaC"))
+        return ".flac";
+    if (hasMagic(0, "FORM") && (hasMagic(8, "AIFF") || hasMagic(8, "AIFC")))
+        return ".aiff";
+    if (hasMagic(0, "OggS"))
+        return ".ogg";
+    if (hasMagic(4, "ftyp"))
+        return ".m4a";
+    // ADTS AAC: MPEG frame sync with layer bits 00 (MP3 uses a non-zero layer)
+    if (size >= 2 && b[0] == 0xFF && (b[1] & 0xF6) == 0xF0)
+        return ".aac";
+    return ".mp3"; // ID3 tag / MPEG audio frames, which is what Suno serves
+}
+
+juce::File LibraryIndex::storeAudioFile(const void* data, size_t size, const juce::String& baseName,
+                                        juce::String& contentHash)
+{
+    if (data == nullptr || size == 0)
+        return {};
+    const juce::File dir = getLibraryDirectory();
+    const juce::String extension = sniffAudioExtension(data, size);
+    contentHash = BlobStore::keyFor(data, size);
+    juce::File target, part;
+    {
+        // Creating the .part file reserves the name for other instances writing at the same time
+        juce::ScopedLock l(storeLock_);
+        for (int suffix = 1;; ++suffix)
+        {
+            target = dir.getChildFile(baseName + (suffix > 1 ? "_" + juce::String(suffix) : juce::String()) + extension);
+            part = target.getSiblingFile(target.getFileName() + ".part");
+            if (!target.exists() && !part.exists())
+                break;
+        }
+        if (part.create().failed())
+            return {};
+    }
+    // Same bytes stored before: the new name is just another clone of that blob
+    if (BlobStore::cloneExisting(contentHash, extension, data, size, target))
+    {
+        part.deleteFile();
+        reclaimedBytes_.fetch_add(static_cast<juce::int64>(size), std::memory_order_relaxed);
+        return target;
+    }
+    bool written = false;
+    {
+        juce::FileOutputStream out(part);
+        if (out.openedOk() && out.write(data, size))
+        {
+            out.flush();
+            written = out.getStatus().wasOk();
+        }
+    }
+    if (!written || !part.moveFileTo(target))
+    {
+        part.deleteFile();
+        return {};
+    }
+    reclaimedBytes_.fetch_add(BlobStore::adopt(target, contentHash), std::memory_order_relaxed);
+    return target;
+}
+
+LibraryIndex::SnapshotPtr LibraryIndex::getSnapshot() const
+{
+    juce::ScopedLock l(lock_);
+    return snapshot_;
+}
+
+void LibraryIndex::addEntry(const LibraryEntry& entry)
+{
+    if (!entry.file.existsAsFile())
+        return;
+    juce::ScopedLock wl(writeLock_);
+    Snapshot entries;
+    {
+        juce::ScopedLock l(lock_);
+        entries = *snapshot_;
+    }
+    const auto oldSize = entries.size();
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [&](const LibraryEntry& e)
+                                 {
+                                     if (e.file != entry.file)
+                                         return false;
+                                     removeFromSearch(e);
+                                     return true;
+                                 }),
+                  entries.end());
+    indexFile_.appendPut(entry, entries.size() != oldSize);
+    entries.push_back(entry);
+    indexForSearch(entries.back());
+    sortNewestFirst(entries);
+    publish(std::move(entries));
+}
+
+void LibraryIndex::removeFile(const juce::File& file)
+{
+    juce::ScopedLock wl(writeLock_);
+    Snapshot entries;
+    {
+        juce::ScopedLock l(lock_);
+        entries = *snapshot_;
+    }
+    const auto oldSize = entries.size();
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [&](const LibraryEntry& e)
+                                 {
+                                     if (e.file != file)
+                                         return false;
+                                     removeFromSearch(e);
+                                     return true;
+                                 }),
+                  entries.end());
+    if (entries.size() == oldSize)
+        return;
+    indexFile_.appendRemove(file.getFileName());
+    publish(std::move(entries));
+}
+
+void LibraryIndex::requestRescan()
+{
+    rescanRequested_.store(true);
+    notify();
+}
+
+void LibraryIndex::touch(const juce::File& file)
+{
+    {
+        juce::ScopedLock l(pendingLock_);
+        pendingTouches_[file.getFileName()] = juce::Time::getCurrentTime();
+    }
+    notify();
+}
+
+void LibraryIndex::setPinned(const juce::File& file, bool pinned)
+{
+    {
+        juce::ScopedLock l(pendingLock_);
+        pendingPins_[file.getFileName()] = pinned;
+    }
+    notify();
+}
+
+void LibraryIndex::setQuotaBytes(juce::int64 bytes)
+{
+    quotaBytes_.store(std::max<juce::int64>(0, bytes), std::memory_order_relaxed);
+    settingsDirty_.store(true);
+    notify();
+}
+
+void LibraryIndex::run()
+{
+    {
+        std::set<juce::String> liveKeys;
+        for (const auto& e : *getSnapshot())
+            liveKeys.insert(e.contentHash);
+        reclaimedBytes_.fetch_add(BlobStore::collectGarbage(liveKeys), std::memory_order_relaxed);
+    }
+    while (!threadShouldExit())
+    {
+        applyPendingUpdates();
+        if (settingsDirty_.exchange(false))
+            saveSettings();
+        const juce::File dir = getLibraryDirectory();
+        const juce::Time dirModTime = dir.getLastModificationTime();
+        if (rescanRequested_.exchange(false) || dirModTime != lastDirectoryModTime_)
+        {
+            lastDirectoryModTime_ = dirModTime;
+            reconcileWithDirectory();
+        }
+        hashUnhashedEntries();
+        analyseMissingEntries();
+        enforceQuota();
+        rebuildSimilarityIfNeeded();
+        compactIndexFileIfNeeded();
+        compactSearchIfNeeded();
+        wait(kPollIntervalMs);
+    }
+}
+
+// Directory listing happens without holding writeLock_; entries already known keep their
+// metadata, new files get a minimal entry and vanished files are dropped from the index file.
+// An entry added while the listing ran is missing from it, so a file is only dropped if it is
+// still gone once writeLock_ is held.
+void LibraryIndex::reconcileWithDirectory()
+{
+    struct Found { juce::File file; juce::Time modTime; juce::int64 size; };
+    std::vector<Found> found;
+    for (const auto& item : juce::RangedDirectoryIterator(getLibraryDirectory(), false, kAudioFilePattern, juce::File::findFiles))
+    {
+        if (threadShouldExit())
+            return;
+        found.push_back({ item.getFile(), item.getModificationTime(), item.getFileSize() });
+    }
+
+    juce::ScopedLock wl(writeLock_);
+    SnapshotPtr current = getSnapshot();
+    std::map<juce::String, const LibraryEntry*> known;
+    for (const auto& e : *current)
+        known.emplace(e.file.getFileName(), &e);
+
+    Snapshot entries;
+    entries.reserve(found.size());
+    bool changed = false;
+    for (const auto& f : found)
+    {
+        auto it = known.find(f.file.getFileName());
+        if (it != known.end())
+        {
+            entries.push_back(*it->second);
+            known.erase(it);
+        }
+        else
+        {
+            entries.push_back(makeEntry(f.file, f.modTime, f.size));
+            indexFile_.appendPut(entries.back(), false);
+            indexForSearch(entries.back());
+            changed = true;
+        }
+    }
+    for (const auto& kv : known)
+    {
+        if (kv.second->file.existsAsFile())
+        {
+            entries.push_back(*kv.second);
+            continue;
+        }
+        removeFromSearch(*kv.second);
+        indexFile_.appendRemove(kv.first);
+        changed = true;
+    }
+    if (!changed)
+        return;
+    sortNewestFirst(entries);
+    publish(std::move(entries));
+}
+
+void LibraryIndex::compactIndexFileIfNeeded()
+{
+    juce::ScopedLock wl(writeLock_);
+    SnapshotPtr current = getSnapshot();
+    const int dead = indexFile_.getNumDeadRecords();
+    if (dead < kMinDeadRecordsForCompaction || dead < static_cast<int>(current->size()))
+        return;
+    indexFile_.compact(*current);
+}
+
+// Evicted and replaced entries leave tombstones in the search index. Once they outnumber the
+// live entries, every entry is indexed again with ids from 1, and the renumbered snapshot is
+// published under searchLock_, so search() never pairs old ids with the new index.
+void LibraryIndex::compactSearchIfNeeded()
+{
+    juce::ScopedLock wl(writeLock_);
+    {
+        juce::ScopedLock l(searchLock_);
+        const size_t removed = search_.getNumRemoved();
+        if (removed < static_cast<size_t>(kMinDeadRecordsForCompaction) || removed < search_.getNumDocuments())
+            return;
+    }
+    Snapshot entries = *getSnapshot();
+    LibrarySearchIndex rebuilt;
+    juce::uint32 id = 1;
+    for (auto& e : entries)
+    {
+        e.id = id++;
+        rebuilt.add(e.id, searchableText(e));
+    }
+    juce::ScopedLock l(searchLock_);
+    search_ = std::move(rebuilt);
+    nextId_ = id;
+    publish(std::move(entries));
+}
+
+// Touches and pin changes are queued by the UI and written here, so the message thread
+// never waits for writeLock_ or the index file.
+void LibraryIndex::applyPendingUpdates()
+{
+    std::map<juce::String, juce::Time> touches;
+    std::map<juce::String, bool> pins;
+    {
+        juce::ScopedLock l(pendingLock_);
+        touches.swap(pendingTouches_);
+        pins.swap(pendingPins_);
+    }
+    if (touches.empty() && pins.empty())
+        return;
+
+    juce::ScopedLock wl(writeLock_);
+    Snapshot entries = *getSnapshot();
+    bool changed = false;
+    for (auto& e : entries)
+    {
+        const auto touch = touches.find(e.file.getFileName());
+        const auto pin = pins.find(e.file.getFileName());
+        const bool touched = touch != touches.end() && touch->second > e.lastAccess;
+        const bool pinChanged = pin != pins.end() && pin->second != e.pinned;
+        if (!touched && !pinChanged)
+            continue;
+        if (touched)
+            e.lastAccess = touch->second;
+        if (pinChanged)
+            e.pinned = pin->second;
+        indexFile_.appendPut(e, true);
+        changed = true;
+    }
+    if (changed)
+        publish(std::move(entries));
+}
+
+// Brings the library under the quota: least recently used unpinned entries are transcoded
+// to FLAC first (lossless, entry kept), then deleted. Entries used within the last few
+// minutes are left alone so a fresh result is never evicted right after it arrives.
+void LibraryIndex::enforceQuota()
+{
+    const juce::int64 quota = getQuotaBytes();
+    if (quota <= 0 || getTotalBytes() <= quota)
+        return;
+
+    auto leastRecentlyUsed = [this]
+    {
+        const juce::int64 now = juce::Time::currentTimeMillis();
+        auto lastUse = [](const LibraryEntry& e)
+        {
+            return std::max(e.time.toMilliseconds(), e.lastAccess.toMilliseconds());
+        };
+        Snapshot candidates;
+        const SnapshotPtr current = getSnapshot();
+        for (const auto& e : *current)
+            if (!e.pinned && now - lastUse(e) >= kMinIdleBeforeEvictionMs)
+                candidates.push_back(e);
+        std::sort(candidates.begin(), candidates.end(),
+                  [&](const LibraryEntry& a, const LibraryEntry& b) { return lastUse(a) < lastUse(b); });
+        return candidates;
+    };
+
+    for (const auto& e : leastRecentlyUsed())
+    {
+        if (threadShouldExit() || getTotalBytes() <= quota)
+            return;
+        // Transcoding a file that other entries share would add a copy instead of saving space
+        const bool shared = BlobStore::exists(e.contentHash, e.file.getFileExtension()) && isContentShared(e);
+        if (e.file.hasFileExtension("wav;aif;aiff") && !shared && transcodeSkipped_.count(e.file.getFileName()) == 0
+            && !transcodeToFlac(e))
+            transcodeSkipped_.insert(e.file.getFileName());
+    }
+    for (const auto& e : leastRecentlyUsed())
+    {
+        if (threadShouldExit() || getTotalBytes() <= quota)
+            return;
+        evict(e);
+    }
+}
+
+bool LibraryIndex::transcodeToFlac(const LibraryEntry& entry)
+{
+    const juce::File target = entry.file.withFileExtension("flac");
+    const juce::File part = target.getSiblingFile(target.getFileName() + ".part");
+    if (target.exists() || part.exists())
+        return false;
+
+    juce::AudioFormatManager fm;
+    fm.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(fm.createReaderFor(entry.file));
+    // FLAC is lossless for 16/24-bit integer PCM only; float files are left as they are
+    if (reader == nullptr || reader->usesFloatingPointData
+        || (reader->bitsPerSample != 16 && reader->bitsPerSample != 24))
+        return false;
+    bool written = false;
+    {
+        juce::FlacAudioFormat flac;
+        std::unique_ptr<juce::OutputStream> out = part.createOutputStream();
+        auto options = juce::AudioFormatWriterOptions{}
+                          .withSampleRate(reader->sampleRate)
+                          .withNumChannels(static_cast<int>(reader->numChannels))
+                          .withBitsPerSample(static_cast<int>(reader->bitsPerSample));
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+        if (out != nullptr)
+            writer = flac.createWriterFor(out, options);
+        if (writer != nullptr)
+            written = writer->writeFromAudioReader(*reader, 0, -1);
+    }
+    reader.reset();
+    const juce::int64 newSize = part.getSize();
+    if (!written || newSize <= 0 || newSize >= entry.fileSize || !part.moveFileTo(target))
+    {
+        part.deleteFile();
+        return false;
+    }
+
+    {
+        juce::ScopedLock wl(writeLock_);
+        Snapshot entries = *getSnapshot();
+        auto it = std::find_if(entries.begin(), entries.end(),
+                               [&](const LibraryEntry& e) { return e.file == entry.file; });
+        if (it == entries.end() || it->pinned)
+        {
+            target.deleteFile();
+            return false;
+        }
+        it->file = target;
+        it->fileSize = newSize;
+        it->contentHash.clear(); // hashed again by hashUnhashedEntries()
+        indexFile_.appendRemove(entry.file.getFileName());
+        indexFile_.appendPut(*it, false);
+        publish(std::move(entries));
+    }
+    entry.file.deleteFile();
+    reclaimedBytes_.fetch_add(releaseStorage(entry) - newSize, std::memory_order_relaxed);
+    return true;
+}
+
+void LibraryIndex::evict(const LibraryEntry& entry)
+{
+    {
+        // A pin queued since the candidates were collected wins
+        juce::ScopedLock l(pendingLock_);
+        const auto pin = pendingPins_.find(entry.file.getFileName());
+        if (pin != pendingPins_.end() && pin->second)
+            return;
+    }
+    if (!entry.file.deleteFile())
+        return;
+    reclaimedBytes_.fetch_add(releaseStorage(entry), std::memory_order_relaxed);
+    removeFile(entry.file);
+}
+
+// Called once entry.file is deleted: frees its blob (and the blob's peaks) when no other
+// library entry has the same content. Returns the bytes actually freed on disk: nothing while
+// other clones of the blob remain, the whole file if it was a plain copy.
+juce::int64 LibraryIndex::releaseStorage(const LibraryEntry& entry)
+{
+    WaveformPeakStore::getPeaksFileFor(entry.file).deleteFile();
+    if (entry.contentHash.isEmpty())
+        return entry.fileSize;
+    const juce::String extension = entry.file.getFileExtension();
+    if (isContentShared(entry))
+        return BlobStore::exists(entry.contentHash, extension) ? 0 : entry.fileSize;
+    BlobStore::release(entry.contentHash, extension);
+    WaveformPeakStore::getPeaksFileFor(entry.file, entry.contentHash).deleteFile();
+    return entry.fileSize;
+}
+
+bool LibraryIndex::isContentShared(const LibraryEntry& entry) const
+{
+    if (entry.contentHash.isEmpty())
+        return false;
+    const SnapshotPtr current = getSnapshot();
+    return std::any_of(current->begin(), current->end(), [&](const LibraryEntry& e)
+    {
+        return e.file != entry.file && e.contentHash == entry.contentHash;
+    });
+}
+
+// Entries without a content hash (older libraries, files found by a rescan, transcodes) are
+// hashed a few at a time, cloned into the BlobStore and, if identical to a stored blob,
+// replaced by a clone of it.
+void LibraryIndex::hashUnhashedEntries()
+{
+    int budget = kMaxFilesHashedPerPass;
+    const SnapshotPtr current = getSnapshot(); // keeps e alive while newer snapshots are published
+    for (const auto& e : *current)
+    {
+        if (budget <= 0 || threadShouldExit())
+            return;
+        if (e.contentHash.isNotEmpty() || hashSkipped_.count(e.file.getFileName()) > 0)
+            continue;
+        --budget;
+        const juce::String key = BlobStore::keyForFile(e.file);
+        if (key.isEmpty())
+        {
+            hashSkipped_.insert(e.file.getFileName());
+            continue;
+        }
+        reclaimedBytes_.fetch_add(BlobStore::adopt(e.file, key), std::memory_order_relaxed);
+        const juce::File namedPeaks = WaveformPeakStore::getPeaksFileFor(e.file);
+        if (namedPeaks.existsAsFile())
+            namedPeaks.moveFileTo(WaveformPeakStore::getPeaksFileFor(e.file, key));
+
+        updateEntry(e.file, [&key](LibraryEntry& updated) { updated.contentHash = key; });
+    }
+}
+
+// Analyses entries without a feature vector or TrackAnalysis (older libraries, rescanned files)
+// within a time budget per pass; new results arrive with both computed from the decoded audio.
+void LibraryIndex::analyseMissingEntries()
+{
+    const juce::uint32 start = juce::Time::getMillisecondCounter();
+    const SnapshotPtr current = getSnapshot();
+    for (const auto& e : *current)
+    {
+        if (threadShouldExit() || juce::Time::getMillisecondCounter() - start >= kAnalysisTimeBudgetMs)
+            return;
+        const juce::String name = e.file.getFileName();
+        const bool wantFeatures = e.features.empty() && featuresSkipped_.count(name) == 0;
+        const bool wantAnalysis = !e.analysis.valid && analysisSkipped_.count(name) == 0;
+        if (!wantFeatures && !wantAnalysis)
+            continue;
+        std::vector<float> features;
+        TrackAnalysis analysis;
+        analyseFile(e.file, wantFeatures ? &features : nullptr, wantAnalysis ? &analysis : nullptr);
+        if (wantFeatures && features.empty())
+            featuresSkipped_.insert(name);
+        if (wantAnalysis && !analysis.valid)
+            analysisSkipped_.insert(name);
+        if (!features.empty() || analysis.valid)
+            updateEntry(e.file, [&features, &analysis](LibraryEntry& updated)
+            {
+                if (!features.empty())
+                    updated.features = std::move(features);
+                if (analysis.valid)
+                    updated.analysis = analysis;
+            });
+    }
+}
+
+void LibraryIndex::updateEntry(const juce::File& file, const std::function<void(LibraryEntry&)>& change)
+{
+    juce::ScopedLock wl(writeLock_);
+    Snapshot entries = *getSnapshot();
+    for (auto& e : entries)
+    {
+        if (e.file != file)
+            continue;
+        change(e);
+        indexFile_.appendPut(e, true);
+        publish(std::move(entries));
+        return;
+    }
+}
+
+LibraryIndex::SnapshotPtr LibraryIndex::findSimilar(const std::vector<float>& features, int maxResults,
+                                                    const juce::File& exclude) const
+{
+    auto result = std::make_shared<Snapshot>();
+    if (static_cast<int>(features.size()) != AudioFeatureExtractor::kDims || maxResults <= 0)
+        return result;
+    std::shared_ptr<const SimilaritySearch> similarity;
+    {
+        juce::ScopedLock l(similarityLock_);
+        similarity = similarity_;
+    }
+    if (similarity == nullptr)
+        return result;
+    const SnapshotPtr& all = similarity->entries;
+    const auto matches = similarity->index.query(features, static_cast<size_t>(maxResults) + 1);
+    for (const auto& m : matches)
+    {
+        const LibraryEntry& e = (*all)[m.index];
+        if (e.file == exclude)
+            continue;
+        result->push_back(e);
+        if (static_cast<int>(result->size()) == maxResults)
+            break;
+    }
+    return result;
+}
+
+// Standardisation depends on the whole set, so the index is rebuilt rather than patched: off the
+// callers' threads, once per pass at most, then swapped in for findSimilar().
+void LibraryIndex::rebuildSimilarityIfNeeded()
+{
+    const SnapshotPtr all = getSnapshot();
+    {
+        juce::ScopedLock l(similarityLock_);
+        if (similarity_ != nullptr && similarity_->entries == all)
+            return;
+    }
+    auto next = std::make_shared<SimilaritySearch>();
+    std::vector<const std::vector<float>*> vectors;
+    vectors.reserve(all->size());
+    for (const auto& e : *all)
+        vectors.push_back(&e.features);
+    next->index.build(vectors, AudioFeatureExtractor::kDims);
+    next->entries = all;
+    juce::ScopedLock l(similarityLock_);
+    similarity_ = std::move(next);
+}
+
+juce::File LibraryIndex::getSettingsFile()
+{
+    return getLibraryDirectory().getSiblingFile("library-settings.json");
+}
+
+void LibraryIndex::loadSettings()
+{
+    const juce::File file = getSettingsFile();
+    if (!file.existsAsFile())
+        return;
+    const juce::var root = juce::JSON::parse(file);
+    quotaBytes_.store(std::max<juce::int64>(0, static_cast<juce::int64>(root.getProperty("quotaBytes", 0))));
+}
+
+void LibraryIndex::saveSettings() const
+{
+    auto* root = new juce::DynamicObject();
+    root->setProperty("version", 1);
+    root->setProperty("quotaBytes", getQuotaBytes());
+    getSettingsFile().replaceWithText(juce::JSON::toString(juce::var(root)));
+}
+
+LibraryIndex::SnapshotPtr LibraryIndex::search(const juce::String& query) const
+{
+    if (query.trim().isEmpty())
+        return getSnapshot();
+    SnapshotPtr all;
+    std::vector<LibrarySearchIndex::DocId> ids;
+    {
+        juce::ScopedLock l(searchLock_);   // the ids of this snapshot are the ones indexed
+        all = getSnapshot();
+        ids = search_.query(query.toStdString());
+    }
+    auto filtered = std::make_shared<Snapshot>();
+    if (ids.empty())
+        return filtered;
+    for (const auto& e : *all)
+        if (std::binary_search(ids.begin(), ids.end(), e.id))
+            filtered->push_back(e);
+    return filtered;
+}
+
+void LibraryIndex::indexForSearch(LibraryEntry& entry)
+{
+    entry.id = nextId_++;
+    const std::string text = searchableText(entry);
+    juce::ScopedLock l(searchLock_);
+    search_.add(entry.id, text);
+}
+
+void LibraryIndex::removeFromSearch(const LibraryEntry& entry)
+{
+    juce::ScopedLock l(searchLock_);
+    search_.remove(entry.id);
+}
+
+std::string LibraryIndex::searchableText(const LibraryEntry& e)
+{
+    const juce::String text = e.prompt + " " + e.style + " " + e.title + " " + e.tags + " " + e.model + " "
+                              + e.mode + " " + e.file.getFileNameWithoutExtension() + " "
+                              + e.time.formatted("%A %B %Y-%m-%d");
+    return text.toStdString();
+}
+
+void LibraryIndex::publish(Snapshot entries)
+{
+    // Entries that are clones of one blob occupy the disk once. Without a blob (no clonefile()
+    // on this volume, or cloning failed) each duplicate is a plain copy and counts in full.
+    // Only hashes seen more than once are checked, so most entries cost no file access.
+    juce::int64 total = 0;
+    std::set<juce::String> seen;
+    std::map<juce::String, bool> hasBlob;
+    for (const auto& e : entries)
+    {
+        if (e.contentHash.isEmpty() || seen.insert(e.contentHash).second)
+        {
+            total += e.fileSize;
+            continue;
+        }
+        auto blob = hasBlob.find(e.contentHash);
+        if (blob == hasBlob.end())
+            blob = hasBlob.emplace(e.contentHash, BlobStore::exists(e.contentHash, e.file.getFileExtension())).first;
+        if (!blob->second)
+            total += e.fileSize;
+    }
+    totalBytes_.store(total, std::memory_order_relaxed);
+    auto next = std::make_shared<const Snapshot>(std::move(entries));
+    {
+        juce::ScopedLock l(lock_);
+        snapshot_ = std::move(next);
+    }
+    version_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+LibraryEntry LibraryIndex::makeEntry(const juce::File& file, juce::Time modificationTime, juce::int64 fileSize)
+{
+    LibraryEntry e;
+    e.file = file;
+    e.prompt = file.getFileName().upToFirstOccurrenceOf(".", false, false);
+    e.time = modificationTime;
+    e.fileSize = fileSize;
+    return e;
+}
+
+void LibraryIndex::sortNewestFirst(Snapshot& entries)
+{
+    std::sort(entries.begin(), entries.end(), [](const LibraryEntry& a, const LibraryEntry& b)
+    {
+        if (a.time != b.time)
+            return a.time > b.time;
+        return a.file.getFileName() > b.file.getFileName();
+    });
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "LibraryIndexFile.h"
+#include "LibrarySearch.h"
+#include "MusicalPosition.h"
+#include "SimilarityIndex.h"
+#include "TrackAnalysis.h"
+
+struct LibraryEntry
+{
+    juce::File file;
+    juce::String prompt;
+    juce::Time time;
+    juce::String style;
+    juce::String title;
+    juce::String model;
+    juce::String taskId;
+    juce::String tags;              // style tags reported by Suno
+    juce::String mode;              // "generate" | "cover" | "add-vocals"
+    double durationSeconds = 0.0;
+    double sampleRate = 0.0;
+    int numChannels = 0;
+    int sourceSegment = -1;         // index of the input segment when the result arrived; -1 for text-to-music or if removed
+    double hostBpm = 0.0;           // host tempo when the job was submitted
+    MusicalPosition sourcePosition; // timeline position of the (trimmed) source segment, if known
+    juce::int64 fileSize = 0;
+    juce::Time lastAccess;          // last drag / insert / reveal / copy; 0 = never
+    bool pinned = false;            // favourite: exempt from quota eviction
+    juce::String contentHash;       // BlobStore key; empty until the file has been hashed
+    std::vector<float> features;    // AudioFeatureExtractor vector; empty until analysed
+    TrackAnalysis analysis;         // tempo / key / loudness; valid == false until analysed
+    juce::uint32 id = 0;            // runtime id (search index), not persisted
+};
+
+/**
+ * Process-wide in-memory index of the generations library (use via
+ * SharedServices). Holds an immutable, sorted snapshot (newest
+ * first) so the UI gets O(1) row access without touching the file system.
+ * Known writes are applied immediately via addEntry()/removeFile(); external
+ * changes are picked up by a background thread that stats only the library
+ * directory and reconciles when its modification time changes.
+ * Metadata is persisted in LibraryIndexFile (library.idx) and loaded at
+ * construction, so the list opens with full metadata without reading audio.
+ * The same thread enforces the optional size quota: least recently used,
+ * unpinned entries are first transcoded to FLAC (PCM WAV/AIFF only), then
+ * deleted, until the library fits. It also content-hashes entries that have
+ * no hash yet and clones them into the BlobStore, so duplicates share storage,
+ * and backfills feature vectors and TrackAnalysis for entries that lack them.
+ */
+class LibraryIndex : private juce::Thread
+{
+public:
+    using Snapshot = std::vector<LibraryEntry>;
+    using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
+    LibraryIndex();
+    ~LibraryIndex() override;
+
+    static juce::File getLibraryDirectory();
+    /** Wildcard for every audio file type the library stores (Suno results are kept as sent). */
+    static constexpr const char* kAudioFilePattern = "*.wav;*.mp3;*.m4a;*.aac;*.flac;*.aiff;*.ogg";
+
+    /** Writes encoded audio bytes unchanged to a new library file named baseName plus the
+        extension sniffed from the bytes ("_2", "_3"... on collision). If identical bytes are
+        already in the BlobStore the file becomes a clone of them; otherwise the data goes
+        to a ".part" file, is renamed when complete and registered as a blob. contentHash
+        receives the BlobStore key. Blocking; call off the message thread. Returns the new
+        file, or File() on failure. Does not add an index entry. */
+    juce::File storeAudioFile(const void* data, size_t size, const juce::String& baseName, juce::String& contentHash);
+    /** File extension (with dot) for encoded audio, from its magic bytes. */
+    static juce::String sniffAudioExtension(const void* data, size_t size);
+
+    /** Current sorted snapshot; cheap to call from paint code. */
+    SnapshotPtr getSnapshot() const;
+    /** Bumped every time a new snapshot is published. */
+    juce::uint32 getVersion() const { return version_.load(std::memory_order_acquire); }
+
+    /** Adds or replaces the entry for entry.file and persists its metadata. */
+    void addEntry(const LibraryEntry& entry);
+    void removeFile(const juce::File& file);
+    void requestRescan();
+
+    /** Records a use of file (drag, insert, reveal, copy path) for LRU eviction. Queued for
+        the background thread, so safe to call from the message thread. */
+    void touch(const juce::File& file);
+    /** Pinned (favourite) entries are never transcoded or evicted. Queued like touch(). */
+    void setPinned(const juce::File& file, bool pinned);
+
+    /** Library size limit in bytes (0 = unlimited); persisted in AceForgeSuno/library-settings.json. */
+    void setQuotaBytes(juce::int64 bytes);
+    juce::int64 getQuotaBytes() const { return quotaBytes_.load(std::memory_order_relaxed); }
+    /** Sum of file sizes in the current snapshot. */
+    juce::int64 getTotalBytes() const { return totalBytes_.load(std::memory_order_relaxed); }
+    /** Bytes freed by quota enforcement (transcoding and eviction) since the process started. */
+    juce::int64 getReclaimedBytes() const { return reclaimedBytes_.load(std::memory_order_relaxed); }
+
+    /** Entries matching every term of query as a word prefix (prompt, style, title, tags,
+        model, mode, weekday/month/date); newest first. An empty query returns the full snapshot. */
+    SnapshotPtr search(const juce::String& query) const;
+
+    /** Entries that sound most like features (AudioFeatureExtractor layout), best first, at
+        most maxResults; exclude (the reference itself) is skipped. Approximate (SimilarityIndex);
+        queries the index the background thread last built, so it never builds one itself. */
+    SnapshotPtr findSimilar(const std::vector<float>& features, int maxResults, const juce::File& exclude = {}) const;
+
+private:
+    void run() override;
+    void reconcileWithDirectory();
+    void publish(Snapshot entries);
+    void compactIndexFileIfNeeded();
+    void compactSearchIfNeeded();
+    void applyPendingUpdates();
+    void enforceQuota();
+    bool transcodeToFlac(const LibraryEntry& entry);
+    void evict(const LibraryEntry& entry);
+    juce::int64 releaseStorage(const LibraryEntry& entry);
+    /** True if another entry has entry's content hash. */
+    bool isContentShared(const LibraryEntry& entry) const;
+    void hashUnhashedEntries();
+    void analyseMissingEntries();
+    void rebuildSimilarityIfNeeded();
+    /** Applies change to the entry for file, persists and publishes it; caller must not hold writeLock_. */
+    void updateEntry(const juce::File& file, const std::function<void(LibraryEntry&)>& change);
+    static juce::File getSettingsFile();
+    void loadSettings();
+    void saveSettings() const;
+    void indexForSearch(LibraryEntry& entry);   // assigns entry.id; caller holds writeLock_
+    void removeFromSearch(const LibraryEntry& entry);
+    static std::string searchableText(const LibraryEntry& entry);
+    static LibraryEntry makeEntry(const juce::File& file, juce::Time modificationTime, juce::int64 fileSize);
+    static void sortNewestFirst(Snapshot& entries);
+
+    static constexpr int kPollIntervalMs = 2000;
+    static constexpr int kMinDeadRecordsForCompaction = 256;
+    static constexpr int kMaxFilesHashedPerPass = 32;
+    static constexpr int kAnalysisTimeBudgetMs = 1000;   // per pass, so touches / rescans stay prompt
+    static constexpr juce::int64 kMinIdleBeforeEvictionMs = 10 * 60 * 1000; // never evict fresh results
+
+    mutable juce::CriticalSection lock_;      // guards snapshot_ pointer
+    juce::CriticalSection writeLock_;         // serialises read-modify-publish
+    SnapshotPtr snapshot_;
+    std::atomic<juce::uint32> version_{ 0 };
+    std::atomic<bool> rescanRequested_{ true };
+    juce::Time lastDirectoryModTime_;
+    LibraryIndexFile indexFile_;               // guarded by writeLock_
+    juce::uint32 nextId_ = 1;                  // guarded by writeLock_
+    juce::CriticalSection storeLock_;         // serialises file name reservation
+    juce::CriticalSection pendingLock_;       // guards the queued touch / pin updates
+    std::map<juce::String, juce::Time> pendingTouches_;   // keyed by file name
+    std::map<juce::String, bool> pendingPins_;
+    std::atomic<juce::int64> quotaBytes_{ 0 };
+    std::atomic<juce::int64> totalBytes_{ 0 };
+    std::atomic<juce::int64> reclaimedBytes_{ 0 };
+    std::atomic<bool> settingsDirty_{ false };
+    std::set<juce::String> transcodeSkipped_;  // background thread only: failed or no gain
+    std::set<juce::String> hashSkipped_;       // background thread only: unreadable files
+    std::set<juce::String> featuresSkipped_;   // background thread only: undecodable / too short
+    std::set<juce::String> analysisSkipped_;   // background thread only: undecodable
+    struct SimilaritySearch
+    {
+        SimilarityIndex index;
+        SnapshotPtr entries;   // the snapshot it was built from; Match::index points into it
+    };
+    mutable juce::CriticalSection similarityLock_;   // guards the similarity_ pointer
+    std::shared_ptr<const SimilaritySearch> similarity_;   // replaced whole by the background thread
+    mutable juce::CriticalSection searchLock_;   // guards search_; held while compaction renumbers
+    LibrarySearchIndex search_;
+
+    JUCE_DECLARE_NON_COPYABLE(LibraryIndex)
+};
@@ -0,0 +1,325 @@
+#include "LibraryIndexFile.h"
+#include "LibraryIndex.h"
+#include <cstring>
+#include <map>
+
+namespace
+{
+const char kMagic[8] = { 'A', 'F', 'S', 'L', 'I', 'D', 'X', '1' };
+constexpr size_t kHeaderSize = 16;
+constexpr size_t kRecordHeaderSize = 5;
+
+// Field ids are part of the file format: append new ids, never renumber.
+enum Field : juce::uint8
+{
+    kFieldFileName = 1,
+    kFieldPrompt = 2,
+    kFieldStyle = 3,
+    kFieldTitle = 4,
+    kFieldModel = 5,
+    kFieldTaskId = 6,
+    kFieldMode = 7,
+    kFieldCreatedMs = 8,
+    kFieldDurationSeconds = 9,
+    kFieldSampleRate = 10,
+    kFieldNumChannels = 11,
+    kFieldSourceSegment = 12,
+    kFieldHostBpm = 13,
+    kFieldFileSize = 14,
+    kFieldTags = 15,
+    kFieldLastAccessMs = 16,
+    kFieldPinned = 17,
+    kFieldContentHash = 18,
+    kFieldFeatures = 19,
+    kFieldAnalysisBpm = 20,
+    kFieldAnalysisKey = 21,
+    kFieldLoudnessLufs = 22,
+    kFieldTruePeakDb = 23,
+    kFieldSourcePosition = 24
+};
+
+juce::uint32 read32(const juce::uint8* p)
+{
+    juce::uint32 v;
+    std::memcpy(&v, p, sizeof(v));
+    return juce::ByteOrder::swapIfBigEndian(v);
+}
+
+void writeField(juce::MemoryOutputStream& out, Field id, const void* data, size_t size)
+{
+    out.writeByte(static_cast<char>(id));
+    out.writeInt(static_cast<int>(size));
+    out.write(data, size);
+}
+
+void writeStringField(juce::MemoryOutputStream& out, Field id, const juce::String& s)
+{
+    if (s.isEmpty())
+        return;
+    writeField(out, id, s.toRawUTF8(), s.getNumBytesAsUTF8());
+}
+
+template <typename T>
+void writeValueField(juce::MemoryOutputStream& out, Field id, T value)
+{
+    writeField(out, id, &value, sizeof(T));
+}
+
+template <typename T>
+bool readValue(const juce::uint8* data, juce::uint32 length, T& value)
+{
+    if (length != sizeof(T))
+        return false;
+    std::memcpy(&value, data, sizeof(T));
+    return true;
+}
+} // namespace
+
+LibraryIndexFile::LibraryIndexFile(juce::File file) : file_(std::move(file)) {}
+
+bool LibraryIndexFile::load(const juce::File& libraryDir, std::vector<LibraryEntry>& out)
+{
+    out.clear();
+    deadRecords_ = 0;
+    foreignRecords_ = false;
+    knownSize_ = 0;
+    const juce::InterProcessLock::ScopedLockType processLock(processLock_);
+    if (!file_.existsAsFile())
+        return false;
+
+    std::map<juce::String, LibraryEntry> live;
+    size_t validSize = 0;
+    size_t fileSize = 0;
+    int records = 0;
+    {
+        juce::MemoryMappedFile mapped(file_, juce::MemoryMappedFile::readOnly);
+        const auto* data = static_cast<const juce::uint8*>(mapped.getData());
+        fileSize = mapped.getSize();
+        if (data == nullptr || fileSize < kHeaderSize || std::memcmp(data, kMagic, sizeof(kMagic)) != 0)
+            return false;
+        if (read32(data + 8) > kFormatVersion)
+            return false;
+
+        size_t pos = kHeaderSize;
+        while (pos + kRecordHeaderSize <= fileSize)
+        {
+            const juce::uint32 payloadSize = read32(data + pos);
+            const auto op = static_cast<Op>(data[pos + 4]);
+            if (pos + kRecordHeaderSize + payloadSize > fileSize)
+                break; // torn tail
+            const juce::uint8* payload = data + pos + kRecordHeaderSize;
+            pos += kRecordHeaderSize + payloadSize;
+            ++records;
+
+            LibraryEntry e;
+            if (!decodeEntry(payload, payloadSize, libraryDir, e))
+                continue;
+            if (op == Op::Put)
+                live[e.file.getFileName()] = std::move(e);
+            else if (op == Op::Remove)
+                live.erase(e.file.getFileName());
+        }
+        validSize = pos;
+    }
+
+    if (validSize < fileSize)
+    {
+        if (auto stream = file_.createOutputStream())
+        {
+            stream->setPosition(static_cast<juce::int64>(validSize));
+            stream->truncate();
+        }
+    }
+    knownSize_ = file_.getSize();
+
+    out.reserve(live.size());
+    for (auto& kv : live)
+        out.push_back(std::move(kv.second));
+    deadRecords_ = records - static_cast<int>(out.size());
+    return true;
+}
+
+bool LibraryIndexFile::appendPut(const LibraryEntry& entry, bool supersedes)
+{
+    if (supersedes)
+        ++deadRecords_;
+    return appendRecord(Op::Put, encodeEntry(entry));
+}
+
+bool LibraryIndexFile::appendRemove(const juce::String& fileName)
+{
+    juce::MemoryOutputStream payload;
+    writeStringField(payload, kFieldFileName, fileName);
+    ++deadRecords_;
+    return appendRecord(Op::Remove, payload.getMemoryBlock());
+}
+
+bool LibraryIndexFile::compact(const std::vector<LibraryEntry>& live)
+{
+    const juce::InterProcessLock::ScopedLockType processLock(processLock_);
+    if (foreignRecords_ || file_.getSize() != knownSize_)
+    {
+        foreignRecords_ = true;
+        return false;
+    }
+    const juce::File temp = file_.getSiblingFile(file_.getFileName() + ".tmp");
+    temp.deleteFile();
+    {
+        std::unique_ptr<juce::FileOutputStream> out = temp.createOutputStream();
+        if (out == nullptr || out->failedToOpen())
+            return false;
+        writeHeader(*out);
+        for (const auto& e : live)
+            writeRecord(*out, Op::Put, encodeEntry(e));
+        out->flush();
+        if (out->getStatus().failed())
+            return false;
+    }
+    if (!temp.replaceFileIn(file_))
+        return false;
+    knownSize_ = file_.getSize();
+    deadRecords_ = 0;
+    return true;
+}
+
+bool LibraryIndexFile::ensureHeader()
+{
+    if (file_.existsAsFile() && file_.getSize() >= static_cast<juce::int64>(kHeaderSize))
+        return true;
+    file_.getParentDirectory().createDirectory();
+    file_.deleteFile();
+    std::unique_ptr<juce::FileOutputStream> out = file_.createOutputStream();
+    if (out == nullptr || out->failedToOpen())
+        return false;
+    writeHeader(*out);
+    out->flush();
+    return out->getStatus().wasOk();
+}
+
+bool LibraryIndexFile::appendRecord(Op op, const juce::MemoryBlock& payload)
+{
+    const juce::InterProcessLock::ScopedLockType processLock(processLock_);
+    if (file_.getSize() != knownSize_)
+        foreignRecords_ = true;
+    if (!ensureHeader())
+        return false;
+    bool ok = false;
+    {
+        std::unique_ptr<juce::FileOutputStream> out = file_.createOutputStream(); // positioned at end
+        if (out == nullptr || out->failedToOpen())
+            return false;
+        writeRecord(*out, op, payload);
+        out->flush();
+        ok = out->getStatus().wasOk();
+    }
+    knownSize_ = file_.getSize();
+    return ok;
+}
+
+void LibraryIndexFile::writeHeader(juce::OutputStream& out)
+{
+    out.write(kMagic, sizeof(kMagic));
+    out.writeInt(static_cast<int>(kFormatVersion));
+    out.writeInt(0);
+}
+
+void LibraryIndexFile::writeRecord(juce::OutputStream& out, Op op, const juce::MemoryBlock& payload)
+{
+    out.writeInt(static_cast<int>(payload.getSize()));
+    out.writeByte(static_cast<char>(op));
+    out.write(payload.getData(), payload.getSize());
+}
+
+juce::MemoryBlock LibraryIndexFile::encodeEntry(const LibraryEntry& e)
+{
+    juce::MemoryOutputStream out;
+    writeStringField(out, kFieldFileName, e.file.getFileName());
+    writeStringField(out, kFieldPrompt, e.prompt);
+    writeStringField(out, kFieldStyle, e.style);
+    writeStringField(out, kFieldTitle, e.title);
+    writeStringField(out, kFieldModel, e.model);
+    writeStringField(out, kFieldTaskId, e.taskId);
+    writeStringField(out, kFieldMode, e.mode);
+    writeStringField(out, kFieldTags, e.tags);
+    writeStringField(out, kFieldContentHash, e.contentHash);
+    if (!e.features.empty())
+        writeField(out, kFieldFeatures, e.features.data(), e.features.size() * sizeof(float));
+    writeValueField(out, kFieldCreatedMs, e.time.toMilliseconds());
+    writeValueField(out, kFieldDurationSeconds, e.durationSeconds);
+    writeValueField(out, kFieldSampleRate, e.sampleRate);
+    writeValueField(out, kFieldNumChannels, static_cast<juce::int32>(e.numChannels));
+    writeValueField(out, kFieldSourceSegment, static_cast<juce::int32>(e.sourceSegment));
+    writeValueField(out, kFieldHostBpm, e.hostBpm);
+    if (e.sourcePosition.valid)
+    {
+        const juce::MemoryBlock position = e.sourcePosition.toMemoryBlock();
+        writeField(out, kFieldSourcePosition, position.getData(), position.getSize());
+    }
+    writeValueField(out, kFieldFileSize, e.fileSize);
+    writeValueField(out, kFieldLastAccessMs, e.lastAccess.toMilliseconds());
+    if (e.pinned)
+        writeValueField(out, kFieldPinned, static_cast<juce::uint8>(1));
+    if (e.analysis.valid)
+    {
+        writeValueField(out, kFieldAnalysisBpm, e.analysis.bpm);
+        writeValueField(out, kFieldAnalysisKey, static_cast<juce::int32>(e.analysis.key));
+        writeValueField(out, kFieldLoudnessLufs, e.analysis.integratedLufs);
+        writeValueField(out, kFieldTruePeakDb, e.analysis.truePeakDb);
+    }
+    return out.getMemoryBlock();
+}
+
+bool LibraryIndexFile::decodeEntry(const juce::uint8* data, size_t size, const juce::File& libraryDir, LibraryEntry& e)
+{
+    juce::String fileName;
+    size_t pos = 0;
+    while (pos + kRecordHeaderSize <= size)
+    {
+        const auto id = data[pos];
+        const juce::uint32 length = read32(data + pos + 1);
+        pos += kRecordHeaderSize;
+        if (pos + length > size)
+            return false;
+        const juce::uint8* v = data + pos;
+        pos += length;
+        auto text = [&] { return juce::String::fromUTF8(reinterpret_cast<const char*>(v), static_cast<int>(length)); };
+        juce::int64 i64 = 0;
+        juce::int32 i32 = 0;
+        juce::uint8 u8 = 0;
+        switch (id)
+        {
+        case kFieldFileName: fileName = text(); break;
+        case kFieldPrompt: e.prompt = text(); break;
+        case kFieldStyle: e.style = text(); break;
+        case kFieldTitle: e.title = text(); break;
+        case kFieldModel: e.model = text(); break;
+        case kFieldTaskId: e.taskId = text(); break;
+        case kFieldMode: e.mode = text(); break;
+        case kFieldTags: e.tags = text(); break;
+        case kFieldContentHash: e.contentHash = text(); break;
+        case kFieldFeatures:
+            e.features.resize(length / sizeof(float));
+            std::memcpy(e.features.data(), v, e.features.size() * sizeof(float));
+            break;
+        case kFieldCreatedMs: if (readValue(v, length, i64)) e.time = juce::Time(i64); break;
+        case kFieldDurationSeconds: readValue(v, length, e.durationSeconds); break;
+        case kFieldSampleRate: readValue(v, length, e.sampleRate); break;
+        case kFieldNumChannels: if (readValue(v, length, i32)) e.numChannels = i32; break;
+        case kFieldSourceSegment: if (readValue(v, length, i32)) e.sourceSegment = i32; break;
+        case kFieldHostBpm: readValue(v, length, e.hostBpm); break;
+        case kFieldSourcePosition: e.sourcePosition = MusicalPosition::fromMemory(v, length); break;
+        case kFieldFileSize: readValue(v, length, e.fileSize); break;
+        case kFieldLastAccessMs: if (readValue(v, length, i64)) e.lastAccess = juce::Time(i64); break;
+        case kFieldPinned: if (readValue(v, length, u8)) e.pinned = u8 != 0; break;
+        case kFieldAnalysisBpm: e.analysis.valid = readValue(v, length, e.analysis.bpm); break;
+        case kFieldAnalysisKey: if (readValue(v, length, i32)) e.analysis.key = i32; break;
+        case kFieldLoudnessLufs: readValue(v, length, e.analysis.integratedLufs); break;
+        case kFieldTruePeakDb: readValue(v, length, e.analysis.truePeakDb); break;
+        default: break; // field from a newer build
+        }
+    }
+    if (fileName.isEmpty())
+        return false;
+    e.file = libraryDir.getChildFile(fileName);
+    return true;
+}
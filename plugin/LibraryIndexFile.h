@@ -0,0 +1,63 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <vector>
+
+struct LibraryEntry;
+
+/**
+ * Append-only on-disk log of library metadata (AceForgeSuno/library.idx, next
+ * to Generations/). Loaded through a memory map so the library opens with
+ * full metadata without touching the audio files.
+ *
+ * Layout (little endian):
+ *   header  : "AFSLIDX1" magic, uint32 format version, uint32 reserved
+ *   record  : uint32 payload size, uint8 op (Put / Remove), payload
+ *   payload : repeated { uint8 field id, uint32 length, bytes }
+ * Unknown field ids are skipped, so new fields do not need a version bump.
+ * A torn record at the tail (crash during append) is ignored on load.
+ *
+ * Several processes can load the plugin at once (two hosts, or a host and its
+ * plugin scanner). Load, append and compaction hold an InterProcessLock, and
+ * compaction is skipped once another process has appended, because the caller's
+ * live set would not contain those records.
+ */
+class LibraryIndexFile
+{
+public:
+    static constexpr juce::uint32 kFormatVersion = 1;
+
+    explicit LibraryIndexFile(juce::File file);
+
+    const juce::File& getFile() const { return file_; }
+
+    /** Replays the log; entry files are resolved against libraryDir. */
+    bool load(const juce::File& libraryDir, std::vector<LibraryEntry>& out);
+
+    /** supersedes: the entry replaces one already in the log (counts a dead record). */
+    bool appendPut(const LibraryEntry& entry, bool supersedes);
+    bool appendRemove(const juce::String& fileName);
+
+    /** Rewrites the log with only live entries (temp file, then atomic rename).
+        Returns false without touching the log if another process has appended to it. */
+    bool compact(const std::vector<LibraryEntry>& live);
+
+    /** Records that no longer describe a live entry (superseded puts and removes). */
+    int getNumDeadRecords() const { return deadRecords_; }
+
+private:
+    enum class Op : juce::uint8 { Put = 1, Remove = 2 };
+
+    bool ensureHeader();
+    bool appendRecord(Op op, const juce::MemoryBlock& payload);
+    static void writeHeader(juce::OutputStream& out);
+    static void writeRecord(juce::OutputStream& out, Op op, const juce::MemoryBlock& payload);
+    static juce::MemoryBlock encodeEntry(const LibraryEntry& entry);
+    static bool decodeEntry(const juce::uint8* data, size_t size, const juce::File& libraryDir, LibraryEntry& out);
+
+    juce::File file_;
+    juce::InterProcessLock processLock_{ "AceForgeSuno-library-idx" };
+    juce::int64 knownSize_ = 0;   // log size after this process's last load, append or compaction
+    bool foreignRecords_ = false; // another process appended since this process loaded or compacted
+    int deadRecords_ = 0;
+};
@@ -0,0 +1,111 @@
+#include "LibrarySearch.h"
+#include <algorithm>
+#include <iterator>
+
+std::vector<std::string> LibrarySearchIndex::tokenize(const std::string& text)
+{
+    std::vector<std::string> tokens;
+    std::string current;
+    for (char ch : text)
+    {
+        const auto c = static_cast<unsigned char>(ch);
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80)
+            current += static_cast<char>(c);
+        else if (c >= 'A' && c <= 'Z')
+            current += static_cast<char>(c - 'A' + 'a');
+        else if (!current.empty())
+        {
+            tokens.push_back(current);
+            current.clear();
+        }
+    }
+    if (!current.empty())
+        tokens.push_back(std::move(current));
+    return tokens;
+}
+
+void LibrarySearchIndex::add(DocId id, const std::string& text)
+{
+    std::vector<std::string> tokens = tokenize(text);
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+    for (const auto& t : tokens)
+    {
+        auto& list = postings_[t];
+        if (list.empty() || list.back() < id)
+            list.push_back(id);
+    }
+    if (removed_.size() <= id)
+        removed_.resize(static_cast<size_t>(id) + 1, false);
+    removed_[id] = false;
+    ++numDocuments_;
+}
+
+void LibrarySearchIndex::remove(DocId id)
+{
+    if (id >= removed_.size() || removed_[id])
+        return;
+    removed_[id] = true;
+    ++numRemoved_;
+    if (numDocuments_ > 0)
+        --numDocuments_;
+}
+
+void LibrarySearchIndex::clear()
+{
+    postings_.clear();
+    removed_.clear();
+    numDocuments_ = 0;
+    numRemoved_ = 0;
+}
+
+// Sets the bit of every document containing a word that starts with prefix.
+void LibrarySearchIndex::matchPrefix(const std::string& prefix, std::vector<uint64_t>& bits) const
+{
+    std::fill(bits.begin(), bits.end(), 0);
+    for (auto it = postings_.lower_bound(prefix);
+         it != postings_.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+    {
+        for (DocId id : it->second)
+            bits[id >> 6] |= uint64_t(1) << (id & 63);
+    }
+}
+
+std::vector<LibrarySearchIndex::DocId> LibrarySearchIndex::query(const std::string& text) const
+{
+    const std::vector<std::string> terms = tokenize(text);
+    if (terms.empty() || removed_.empty())
+        return {};
+
+    // One bit per document id: OR the postings of each prefix, AND across terms.
+    const size_t numWords = (removed_.size() + 63) / 64;
+    std::vector<uint64_t> result(numWords, ~uint64_t(0));
+    std::vector<uint64_t> termBits(numWords);
+    for (const auto& term : terms)
+    {
+        matchPrefix(term, termBits);
+        uint64_t any = 0;
+        for (size_t w = 0; w < numWords; ++w)
+        {
+            result[w] &= termBits[w];
+            any |= result[w];
+        }
+        if (any == 0)
+            return {};
+    }
+
+    std::vector<DocId> ids;
+    for (size_t w = 0; w < numWords; ++w)
+    {
+        uint64_t word = result[w];
+        while (word != 0)
+        {
+            const int bit = __builtin_ctzll(word);
+            const auto id = static_cast<DocId>(w * 64 + static_cast<size_t>(bit));
+            if (!isRemoved(id))
+                ids.push_back(id);
+            word &= word - 1;
+        }
+    }
+    return ids;
+}
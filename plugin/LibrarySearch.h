@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Inverted index over library text (prompt, style, title, tags, model, date).
+ * Documents are added incrementally with increasing ids, so posting lists stay
+ * sorted by push_back. A query is split into terms; every term is matched as a
+ * prefix against the sorted vocabulary (union into a per-document bitset)
+ * and the per-term bitsets are intersected (AND). Removal is lazy (tombstones);
+ * the owner rebuilds the index with fresh ids once getNumRemoved() outgrows
+ * it, since ids and bitsets otherwise grow with every entry ever added.
+ * Not thread-safe; LibraryIndex guards it with its own lock.
+ */
+class LibrarySearchIndex
+{
+public:
+    using DocId = uint32_t;
+
+    /** ids must be strictly increasing across calls. */
+    void add(DocId id, const std::string& text);
+    void remove(DocId id);
+    void clear();
+
+    /** Matching ids in ascending order. An empty query matches nothing. */
+    std::vector<DocId> query(const std::string& text) const;
+
+    size_t getNumDocuments() const { return numDocuments_; }
+    /** Tombstones: removed documents still taking room in the postings and bitsets. */
+    size_t getNumRemoved() const { return numRemoved_; }
+
+    /** Lowercased ASCII alphanumeric runs; bytes >= 0x80 (UTF-8) are kept inside tokens. */
+    static std::vector<std::string> tokenize(const std::string& text);
+
+private:
+    void matchPrefix(const std::string& prefix, std::vector<uint64_t>& bits) const;
+    bool isRemoved(DocId id) const { return id < removed_.size() && removed_[id]; }
+
+    std::map<std::string, std::vector<DocId>> postings_;
+    std::vector<bool> removed_;
+    size_t numDocuments_ = 0;
+    size_t numRemoved_ = 0;
+};
@@ -0,0 +1,213 @@
+#include "MusicalPosition.h"
+#include <cmath>
+
+namespace
+{
+constexpr juce::uint8 kFormatVersion = 1;
+
+enum Flags : juce::uint8
+{
+    kFlagValid = 1,
+    kFlagHasPpq = 2,
+    kFlagLooping = 4
+};
+
+double quarterNotesPerBar(int numerator, int denominator)
+{
+    return numerator * 4.0 / denominator;
+}
+} // namespace
+
+MusicalPosition MusicalPosition::fromPlayhead(const juce::AudioPlayHead::PositionInfo& info)
+{
+    MusicalPosition p;
+    p.valid = true;
+    if (auto samples = info.getTimeInSamples())
+        p.timeInSamples = *samples;
+    if (auto seconds = info.getTimeInSeconds())
+        p.timeInSeconds = *seconds;
+    if (auto bpm = info.getBpm())
+        p.bpm = *bpm;
+    if (auto sig = info.getTimeSignature(); sig && sig->numerator > 0 && sig->denominator > 0)
+    {
+        p.timeSigNumerator = sig->numerator;
+        p.timeSigDenominator = sig->denominator;
+    }
+    if (auto ppq = info.getPpqPosition())
+    {
+        const double perBar = quarterNotesPerBar(p.timeSigNumerator, p.timeSigDenominator);
+        p.hasPpq = true;
+        p.ppq = *ppq;
+        if (auto barStart = info.getPpqPositionOfLastBarStart())
+            p.ppqOfBarStart = *barStart;
+        else
+            p.ppqOfBarStart = std::floor(p.ppq / perBar) * perBar;
+        if (auto barCount = info.getBarCount())
+            p.bar = static_cast<int>(*barCount) + 1;
+        else
+            p.bar = static_cast<int>(std::floor(p.ppqOfBarStart / perBar)) + 1;
+    }
+    p.looping = info.getIsLooping();
+    if (auto loop = info.getLoopPoints())
+    {
+        p.loopStartPpq = loop->ppqStart;
+        p.loopEndPpq = loop->ppqEnd;
+    }
+    return p;
+}
+
+void MusicalPosition::noteTempo(juce::int64 frame, double newBpm)
+{
+    if (newBpm <= 0.0 || numTempoChanges >= kMaxTempoEvents || newBpm == bpmAt(frame))
+        return;
+    if (bpm <= 0.0 && numTempoChanges == 0 && frame == 0)
+    {
+        bpm = newBpm;
+        return;
+    }
+    tempoChanges[static_cast<size_t>(numTempoChanges++)] = { frame, newBpm };
+}
+
+double MusicalPosition::bpmAt(juce::int64 frame) const
+{
+    double result = bpm;
+    for (int i = 0; i < numTempoChanges && tempoChanges[static_cast<size_t>(i)].frame <= frame; ++i)
+        result = tempoChanges[static_cast<size_t>(i)].bpm;
+    return result;
+}
+
+MusicalPosition MusicalPosition::shifted(juce::int64 frame, double sampleRate) const
+{
+    MusicalPosition p = *this;
+    if (!valid || sampleRate <= 0.0 || frame == 0)
+        return p;
+    p.timeInSamples += frame;
+    p.timeInSeconds += frame / sampleRate;
+
+    if (hasPpq && bpm > 0.0)
+    {
+        // Quarter notes from frame 0 to frame, piecewise over the tempo map (before frame 0 the
+        // starting tempo is assumed)
+        double quarters = 0.0;
+        juce::int64 from = 0;
+        double tempo = bpm;
+        for (int i = 0; i < numTempoChanges && tempoChanges[static_cast<size_t>(i)].frame < frame; ++i)
+        {
+            quarters += (tempoChanges[static_cast<size_t>(i)].frame - from) / sampleRate * tempo / 60.0;
+            from = tempoChanges[static_cast<size_t>(i)].frame;
+            tempo = tempoChanges[static_cast<size_t>(i)].bpm;
+        }
+        quarters += (frame - from) / sampleRate * tempo / 60.0;
+        p.ppq += quarters;
+
+        const double perBar = quarterNotesPerBar(timeSigNumerator, timeSigDenominator);
+        const auto bars = static_cast<int>(std::floor((p.ppq - p.ppqOfBarStart) / perBar));
+        p.ppqOfBarStart += bars * perBar;
+        p.bar += bars;
+    }
+
+    p.bpm = bpmAt(frame);
+    p.numTempoChanges = 0;
+    for (int i = 0; i < numTempoChanges; ++i)
+        if (tempoChanges[static_cast<size_t>(i)].frame > frame)
+            p.tempoChanges[static_cast<size_t>(p.numTempoChanges++)]
+                = { tempoChanges[static_cast<size_t>(i)].frame - frame, tempoChanges[static_cast<size_t>(i)].bpm };
+    return p;
+}
+
+double MusicalPosition::frameAtPpq(double targetPpq, double sampleRate) const
+{
+    double quarters = ppq;
+    juce::int64 from = 0;
+    double tempo = bpm;
+    for (int i = 0; i < numTempoChanges; ++i)
+    {
+        const auto& change = tempoChanges[static_cast<size_t>(i)];
+        const double span = (change.frame - from) / sampleRate * tempo / 60.0;
+        if (quarters + span >= targetPpq)
+            break;
+        quarters += span;
+        from = change.frame;
+        tempo = change.bpm;
+    }
+    return from + (targetPpq - quarters) * 60.0 / tempo * sampleRate;
+}
+
+double MusicalPosition::getBeatInBar() const
+{
+    return 1.0 + (ppq - ppqOfBarStart) / (4.0 / timeSigDenominator);
+}
+
+juce::String MusicalPosition::describe() const
+{
+    if (!valid)
+        return {};
+    if (hasPpq)
+    {
+        const double beat = getBeatInBar();
+        const bool onBeat = std::abs(beat - std::round(beat)) < 0.005;
+        return "bar " + juce::String(bar) + " beat " + (onBeat ? juce::String(std::lround(beat)) : juce::String(beat, 2));
+    }
+    const auto ms = static_cast<juce::int64>(std::lround(timeInSeconds * 1000.0));
+    return juce::String(ms / 60000) + ":" + juce::String((ms / 1000) % 60).paddedLeft('0', 2) + "."
+           + juce::String(ms % 1000).paddedLeft('0', 3);
+}
+
+juce::MemoryBlock MusicalPosition::toMemoryBlock() const
+{
+    juce::MemoryOutputStream out;
+    out.writeByte(static_cast<char>(kFormatVersion));
+    out.writeByte(static_cast<char>((valid ? kFlagValid : 0) | (hasPpq ? kFlagHasPpq : 0) | (looping ? kFlagLooping : 0)));
+    out.writeInt64(timeInSamples);
+    out.writeDouble(timeInSeconds);
+    out.writeDouble(ppq);
+    out.writeDouble(ppqOfBarStart);
+    out.writeInt(bar);
+    out.writeShort(static_cast<short>(timeSigNumerator));
+    out.writeShort(static_cast<short>(timeSigDenominator));
+    out.writeDouble(bpm);
+    out.writeDouble(loopStartPpq);
+    out.writeDouble(loopEndPpq);
+    out.writeByte(static_cast<char>(numTempoChanges));
+    for (int i = 0; i < numTempoChanges; ++i)
+    {
+        out.writeInt64(tempoChanges[static_cast<size_t>(i)].frame);
+        out.writeDouble(tempoChanges[static_cast<size_t>(i)].bpm);
+    }
+    return out.getMemoryBlock();
+}
+
+MusicalPosition MusicalPosition::fromMemory(const void* data, size_t size)
+{
+    constexpr size_t kFixedSize = 2 + 8 + 8 + 8 + 8 + 4 + 2 + 2 + 8 + 8 + 8 + 1;
+    MusicalPosition p;
+    if (data == nullptr || size < kFixedSize)
+        return p;
+    juce::MemoryInputStream in(data, size, false);
+    if (static_cast<juce::uint8>(in.readByte()) != kFormatVersion)
+        return p;
+    const auto flags = static_cast<juce::uint8>(in.readByte());
+    p.timeInSamples = in.readInt64();
+    p.timeInSeconds = in.readDouble();
+    p.ppq = in.readDouble();
+    p.ppqOfBarStart = in.readDouble();
+    p.bar = in.readInt();
+    p.timeSigNumerator = in.readShort();
+    p.timeSigDenominator = in.readShort();
+    p.bpm = in.readDouble();
+    p.loopStartPpq = in.readDouble();
+    p.loopEndPpq = in.readDouble();
+    const int events = static_cast<juce::uint8>(in.readByte());
+    if (events > kMaxTempoEvents || in.getNumBytesRemaining() < events * 16 || p.timeSigNumerator <= 0 || p.timeSigDenominator <= 0)
+        return {};
+    for (int i = 0; i < events; ++i)
+    {
+        p.tempoChanges[static_cast<size_t>(i)].frame = in.readInt64();
+        p.tempoChanges[static_cast<size_t>(i)].bpm = in.readDouble();
+    }
+    p.numTempoChanges = events;
+    p.valid = (flags & kFlagValid) != 0;
+    p.hasPpq = (flags & kFlagHasPpq) != 0;
+    p.looping = (flags & kFlagLooping) != 0;
+    return p;
+}
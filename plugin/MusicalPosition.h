@@ -0,0 +1,61 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+
+/**
+ * Where a recording starts on the host timeline, taken from the playhead at
+ * its first captured frame, plus the tempo changes seen while it was
+ * recorded. Fixed size, so the audio thread can fill it without allocating.
+ * Anything the host does not report stays unknown (see the has* flags).
+ */
+struct MusicalPosition
+{
+    struct TempoEvent
+    {
+        juce::int64 frame = 0;   // recording frame the tempo applies from
+        double bpm = 0.0;
+    };
+
+    static constexpr int kMaxTempoEvents = 32;
+
+    bool valid = false;
+    juce::int64 timeInSamples = 0;     // host timeline position of frame 0
+    double timeInSeconds = 0.0;
+    bool hasPpq = false;
+    double ppq = 0.0;                  // quarter notes from the timeline start
+    double ppqOfBarStart = 0.0;        // start of the bar that contains ppq
+    int bar = 1;                       // 1-based
+    int timeSigNumerator = 4;
+    int timeSigDenominator = 4;
+    double bpm = 0.0;                  // tempo at frame 0; 0 = unknown
+    bool looping = false;
+    double loopStartPpq = 0.0;
+    double loopEndPpq = 0.0;
+    std::array<TempoEvent, kMaxTempoEvents> tempoChanges{};   // after frame 0, ascending
+    int numTempoChanges = 0;
+
+    /** Position of the block that starts the recording. */
+    static MusicalPosition fromPlayhead(const juce::AudioPlayHead::PositionInfo& info);
+
+    /** Audio thread: tempo changed at frame of the recording (dropped once the map is full). */
+    void noteTempo(juce::int64 frame, double newBpm);
+    /** Tempo in effect at frame. */
+    double bpmAt(juce::int64 frame) const;
+
+    /** The position of frame (may be negative, e.g. pre-roll) of the same recording, at
+        sampleRate; the tempo map is re-based so frame becomes frame 0. */
+    MusicalPosition shifted(juce::int64 frame, double sampleRate) const;
+    /** Frame (fractional, may be negative) at which the recording reaches targetPpq; needs
+        hasPpq and a known tempo. */
+    double frameAtPpq(double targetPpq, double sampleRate) const;
+
+    /** 1-based beat within the bar (fractional). */
+    double getBeatInBar() const;
+    /** "bar 17 beat 1" (or a time when only that is known); empty if not valid. */
+    juce::String describe() const;
+
+    /** Compact binary form for the library index and plugin state. */
+    juce::MemoryBlock toMemoryBlock() const;
+    static MusicalPosition fromMemory(const void* data, size_t size);
+};
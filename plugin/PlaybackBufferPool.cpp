@@ -0,0 +1,84 @@
+#include "PlaybackBufferPool.h"
+#include <algorithm>
+
+PlaybackBufferPool::~PlaybackBufferPool()
+{
+    stopTimer();
+}
+
+std::unique_ptr<PlaybackBufferPool::Block> PlaybackBufferPool::acquire(size_t numFloats)
+{
+    std::unique_ptr<Block> block;
+    {
+        juce::ScopedLock l(lock_);
+        auto best = free_.end();
+        for (auto it = free_.begin(); it != free_.end(); ++it)
+            if (it->block->capacity() >= numFloats && (best == free_.end() || it->block->capacity() < best->block->capacity()))
+                best = it;
+        if (best != free_.end())
+        {
+            block = std::move(best->block);
+            free_.erase(best);
+        }
+    }
+    if (block == nullptr)
+    {
+        block = std::make_unique<Block>();
+        block->reserve(numFloats);
+    }
+    block->resize(numFloats); // within capacity: no allocation
+    return block;
+}
+
+void PlaybackBufferPool::release(std::unique_ptr<Block> block)
+{
+    if (block == nullptr)
+        return;
+    std::unique_ptr<Block> dropped;
+    {
+        juce::ScopedLock l(lock_);
+        free_.push_back({ std::move(block), juce::Time::getMillisecondCounter() });
+        if (free_.size() > kMaxFreeBlocks)
+        {
+            // Keep the larger blocks: they can serve any shorter result
+            auto smallest = std::min_element(free_.begin(), free_.end(), [](const FreeBlock& a, const FreeBlock& b) {
+                return a.block->capacity() < b.block->capacity();
+            });
+            dropped = std::move(smallest->block);
+            free_.erase(smallest);
+        }
+    }
+    startTimer(kIdleReleaseMs / 4);
+}
+
+size_t PlaybackBufferPool::getFreeBytes() const
+{
+    juce::ScopedLock l(lock_);
+    size_t bytes = 0;
+    for (const auto& f : free_)
+        bytes += f.block->capacity() * sizeof(float);
+    return bytes;
+}
+
+void PlaybackBufferPool::timerCallback()
+{
+    std::vector<std::unique_ptr<Block>> expired;   // freed outside the lock
+    {
+        juce::ScopedLock l(lock_);
+        const juce::uint32 now = juce::Time::getMillisecondCounter();
+        for (auto it = free_.begin(); it != free_.end();)
+        {
+            if (now - it->releasedMs >= static_cast<juce::uint32>(kIdleReleaseMs))
+            {
+                expired.push_back(std::move(it->block));
+                it = free_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        if (free_.empty())
+            stopTimer();
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <juce_events/juce_events.h>
+#include <memory>
+#include <vector>
+
+/**
+ * Sample storage for result playback, shared by every plugin instance
+ * (owned by SharedServices). Nothing is allocated until a result is played:
+ * acquire() reuses the smallest free block that is large enough, or allocates
+ * one of exactly the requested size. Blocks come back through release() when
+ * playback ends and are freed once they have sat unused for kIdleReleaseMs,
+ * so an idle session holds no playback memory. Thread-safe; never call from
+ * the audio thread.
+ */
+class PlaybackBufferPool : private juce::Timer
+{
+public:
+    using Block = std::vector<float>;
+
+    static constexpr int kIdleReleaseMs = 30 * 1000;
+    static constexpr size_t kMaxFreeBlocks = 4;
+
+    PlaybackBufferPool() = default;
+    ~PlaybackBufferPool() override;
+
+    /** A block resized to numFloats (contents unspecified). */
+    std::unique_ptr<Block> acquire(size_t numFloats);
+    void release(std::unique_ptr<Block> block);
+    /** Capacity of the blocks currently held for reuse. */
+    size_t getFreeBytes() const;
+
+private:
+    struct FreeBlock
+    {
+        std::unique_ptr<Block> block;
+        juce::uint32 releasedMs = 0;
+    };
+
+    void timerCallback() override;
+
+    mutable juce::CriticalSection lock_;
+    std::vector<FreeBlock> free_;
+
+    JUCE_DECLARE_NON_COPYABLE(PlaybackBufferPool)
+};
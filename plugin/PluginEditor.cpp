@@ -1,26 +1,176 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+namespace
+{
+// Library quota choices in GB (combo item id = index + 1); 0 = unlimited
+constexpr int kQuotaChoicesGb[] = { 0, 1, 2, 5, 10, 20, 50 };
+constexpr juce::int64 kBytesPerGb = 1024LL * 1024LL * 1024LL;
+// Capture pre-roll choices in seconds (combo item id = index + 1); 0 = off
+constexpr int kPreRollChoicesSeconds[] = { 0, 1, 2, 4, 8, 15, 30 };
+// Captured audio memory budget choices in MB (combo item id = index + 1)
+constexpr int kMemoryBudgetChoicesMb[] = { 256, 512, 1024, 2048, 4096, 8192 };
+constexpr juce::int64 kBytesPerMb = 1024LL * 1024LL;
+
+// m:ss.mmm
+juce::String formatSegmentTime(double seconds)
+{
+    const auto ms = static_cast<juce::int64>(std::lround(std::max(0.0, seconds) * 1000.0));
+    return juce::String(ms / 60000) + ":" + juce::String((ms / 1000) % 60).paddedLeft('0', 2) + "."
+           + juce::String(ms % 1000).paddedLeft('0', 3);
+}
+// Host tempo changes smaller than this do not re-filter the library
+constexpr double kTempoFilterResolutionBpm = 0.05;
+
+// Relative distance of bpm to reference, taking the closest of half / same / double tempo
+double tempoDeviation(double bpm, double reference)
+{
+    double best = 1.0e9;
+    for (double ratio : { 1.0, 0.5, 2.0 })
+        best = std::min(best, std::abs(bpm * ratio / reference - 1.0));
+    return best;
+}
+} // namespace
+
 // --- LibraryListModelSuno ---
+bool LibraryListModelSuno::refreshSnapshot()
+{
+    const juce::uint32 version = processor.getLibraryVersion();
+    if (snapshot_ != nullptr && version == snapshotVersion_ && !filterChanged_)
+        return false;
+    snapshotVersion_ = version;
+    filterChanged_ = false;
+    if (!similarFeatures_.empty())
+        snapshot_ = processor.findSimilarInLibrary(similarFeatures_, similarExclude_);
+    else
+        snapshot_ = filter_.isEmpty() ? processor.getLibrarySnapshot() : processor.searchLibrary(filter_);
+    if (tempoFilterBpm_ > 0.0)
+    {
+        auto matching = std::make_shared<LibraryIndex::Snapshot>();
+        for (const auto& e : *snapshot_)
+            if (TrackAnalysis::tempoMatches(e.analysis.bpm, tempoFilterBpm_))
+                matching->push_back(e);
+        if (similarFeatures_.empty()) // similarity order wins over tempo closeness
+            std::stable_sort(matching->begin(), matching->end(), [this](const LibraryEntry& a, const LibraryEntry& b) {
+                return tempoDeviation(a.analysis.bpm, tempoFilterBpm_) < tempoDeviation(b.analysis.bpm, tempoFilterBpm_);
+            });
+        snapshot_ = std::move(matching);
+    }
+    return true;
+}
+
+void LibraryListModelSuno::setTempoFilter(double bpm)
+{
+    bpm = std::max(0.0, bpm);
+    if (std::abs(bpm - tempoFilterBpm_) < kTempoFilterResolutionBpm)
+        return;
+    tempoFilterBpm_ = bpm;
+    filterChanged_ = true;
+}
+
+void LibraryListModelSuno::setFilter(const juce::String& query)
+{
+    const juce::String trimmed = query.trim();
+    if (trimmed == filter_)
+        return;
+    filter_ = trimmed;
+    similarFeatures_.clear(); // typing leaves "sounds like" mode
+    filterChanged_ = true;
+}
+
+void LibraryListModelSuno::setSimilarTo(std::vector<float> features, const juce::File& exclude)
+{
+    similarFeatures_ = std::move(features);
+    similarExclude_ = exclude;
+    filter_.clear();
+    filterChanged_ = true;
+}
+
+void LibraryListModelSuno::clearSimilar()
+{
+    if (similarFeatures_.empty())
+        return;
+    similarFeatures_.clear();
+    similarExclude_ = juce::File();
+    filterChanged_ = true;
+}
+
+bool LibraryListModelSuno::peaksChanged()
+{
+    const juce::uint32 version = peakStore_->getVersion();
+    if (version == peaksVersion_)
+        return false;
+    peaksVersion_ = version;
+    return true;
+}
+
+const LibraryEntry* LibraryListModelSuno::getEntry(int row) const
+{
+    if (snapshot_ == nullptr || row < 0 || row >= static_cast<int>(snapshot_->size()))
+        return nullptr;
+    return &(*snapshot_)[static_cast<size_t>(row)];
+}
+
 int LibraryListModelSuno::getNumRows()
 {
-    return static_cast<int>(processor.getLibraryEntries().size());
+    return snapshot_ != nullptr ? static_cast<int>(snapshot_->size()) : 0;
 }
 
 void LibraryListModelSuno::paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected)
 {
-    auto entries = processor.getLibraryEntries();
-    if (rowNumber < 0 || rowNumber >= static_cast<int>(entries.size()))
+    const LibraryEntry* e = getEntry(rowNumber);
+    if (e == nullptr)
         return;
-    const auto& e = entries[static_cast<size_t>(rowNumber)];
     if (rowIsSelected)
         g.fillAll(juce::Colour(0xff2a2a4e));
+    juce::String info = e->time.formatted("%Y-%m-%d %H:%M");
+    if (e->durationSeconds > 0.0)
+    {
+        const int sec = static_cast<int>(e->durationSeconds + 0.5);
+        info = juce::String(sec / 60) + ":" + juce::String(sec % 60).paddedLeft('0', 2) + "   " + info;
+    }
+    // Thumbnail from cached peaks; only visible rows are painted, so only they request peaks
+    const juce::Rectangle<float> thumb(static_cast<float>(width - 250), 4.0f, 110.0f, static_cast<float>(height - 8));
+    if (auto peaks = peakStore_->getPeaks(e->file, e->contentHash))
+    {
+        g.setColour(juce::Colour(0xff6a8caf));
+        peaks->draw(g, thumb, 0, peaks->getNumFrames());
+    }
+    int textX = 6;
+    if (e->pinned)
+    {
+        g.setColour(juce::Colour(0xffe8c547));
+        g.setFont(14.0f);
+        g.drawText(juce::String::fromUTF8("\xe2\x98\x85"), textX, 0, 14, height, juce::Justification::centredLeft);
+        textX += 16;
+    }
+    juce::String label = e->prompt.isNotEmpty() ? e->prompt : e->file.getFileName();
+    if (e->sourcePosition.valid)
+        label << "  (from " << e->sourcePosition.describe() << ")"; // where the source was recorded
     g.setColour(juce::Colours::white);
     g.setFont(14.0f);
-    g.drawText(e.file.getFileName(), 6, 0, width - 12, height, juce::Justification::centredLeft);
-    g.setColour(juce::Colours::lightgrey);
+    g.drawText(label, textX, 0, width - 256 - textX, height, juce::Justification::centredLeft, true);
     g.setFont(11.0f);
-    g.drawText(e.time.formatted("%Y-%m-%d %H:%M"), 6, 0, width - 12, height, juce::Justification::centredRight);
+    if (e->analysis.valid)
+    {
+        // Tempo / key / loudness above the date; green when the tempo fits the current host tempo
+        juce::String analysis;
+        if (e->analysis.bpm > 0.0)
+            analysis << juce::roundToInt(e->analysis.bpm) << " BPM  ";
+        if (e->analysis.key >= 0)
+            analysis << TrackAnalysis::keyName(e->analysis.key) << "  ";
+        analysis << juce::roundToInt(e->analysis.integratedLufs) << " LUFS";
+        const bool matchesHost = TrackAnalysis::tempoMatches(e->analysis.bpm, processor.getHostBpm());
+        g.setColour(matchesHost ? juce::Colours::lightgreen : juce::Colours::lightgrey);
+        g.drawText(analysis, 6, 1, width - 12, height / 2 - 1, juce::Justification::centredRight);
+        g.setColour(juce::Colours::lightgrey);
+        g.drawText(info, 6, height / 2, width - 12, height / 2 - 1, juce::Justification::centredRight);
+    }
+    else
+    {
+        g.setColour(juce::Colours::lightgrey);
+        g.drawText(info, 6, 0, width - 12, height, juce::Justification::centredRight);
+    }
 }
 
 void LibraryListModelSuno::listBoxItemDoubleClicked(int row, const juce::MouseEvent&)
@@ -31,7 +181,7 @@ void LibraryListModelSuno::listBoxItemDoubleClicked(int row, const juce::MouseEv
 
 // --- LibraryListBoxSuno ---
 LibraryListBoxSuno::LibraryListBoxSuno(AceForgeSunoAudioProcessor& p, LibraryListModelSuno& model)
-    : ListBox("Library", &model), processorRef(p)
+    : ListBox("Library", &model), processorRef(p), modelRef(model)
 {
     setRowHeight(28);
     setOutlineThickness(0);
@@ -50,13 +200,13 @@ void LibraryListBoxSuno::mouseDrag(const juce::MouseEvent& e)
         return;
     }
     int row = getRowContainingPosition(e.x, e.y);
-    auto entries = processorRef.getLibraryEntries();
-    if (row < 0 || row >= static_cast<int>(entries.size()))
+    const LibraryEntry* entry = modelRef.getEntry(row);
+    if (entry == nullptr)
     {
         ListBox::mouseDrag(e);
         return;
     }
-    juce::String path = entries[static_cast<size_t>(row)].file.getFullPathName();
+    juce::String path = entry->file.getFullPathName();
     if (path.isEmpty())
     {
         ListBox::mouseDrag(e);
@@ -66,7 +216,10 @@ void LibraryListBoxSuno::mouseDrag(const juce::MouseEvent& e)
     auto* editorComp = findParentComponentOfClass<AceForgeSunoAudioProcessorEditor>();
     juce::Component* sourceComp = editorComp != nullptr ? static_cast<juce::Component*>(editorComp) : static_cast<juce::Component*>(this);
     if (container && container->performExternalDragDropOfFiles(juce::StringArray(path), false, sourceComp))
+    {
         dragStarted_ = true;
+        processorRef.touchLibraryFile(juce::File(path));
+    }
     else
         ListBox::mouseDrag(e);
 }
@@ -94,6 +247,15 @@ void SegmentsListModelSuno::paintListBoxItem(int rowNumber, juce::Graphics& g, i
                         + juce::String(static_cast<int>(sec) / 60) + ":"
                         + juce::String(static_cast<int>(sec) % 60).paddedLeft('0', 2)
                         + "." + juce::String(static_cast<int>(sec * 10) % 10);
+    const auto seg = processor.getSegment(rowNumber);
+    if (seg.loopTake > 0)
+        text << "  (take " << seg.loopTake << ")";
+    if (seg.isSilent())
+        text << "  (silent)";
+    if (const auto channels = seg.describeChannels(); channels.isNotEmpty())
+        text << "  [" << channels << "]";
+    if (seg.position.valid)
+        text << "  @ " << seg.position.describe();
     g.setColour(juce::Colours::white);
     g.setFont(14.0f);
     g.drawText(text, 6, 0, width - 12, height, juce::Justification::centredLeft);
@@ -105,12 +267,161 @@ void SegmentsListModelSuno::listBoxItemClicked(int row, const juce::MouseEvent&)
         onRowSelected_(row);
 }
 
+// --- SegmentWaveformView ---
+void SegmentWaveformView::setSegment(int index, std::shared_ptr<const PeakPyramid> peaks, int numFrames, double sampleRate,
+                                     int trimStart, int trimEnd)
+{
+    if (index != index_ || numFrames != numFrames_)
+    {
+        index_ = index;
+        numFrames_ = numFrames;
+        viewStart_ = 0.0;
+        viewSpan_ = numFrames;
+        drag_ = Drag::None;
+    }
+    else if (peaks == peaks_ && sampleRate == sampleRate_ && (drag_ != Drag::None || (trimStart == trimStart_ && trimEnd == trimEnd_)))
+    {
+        return; // nothing new (and the processor's trim lags behind a drag in progress)
+    }
+    peaks_ = std::move(peaks);
+    sampleRate_ = sampleRate > 0.0 ? sampleRate : 44100.0;
+    if (drag_ == Drag::None)
+    {
+        trimStart_ = juce::jlimit(0, numFrames_, trimStart);
+        trimEnd_ = trimEnd > 0 ? juce::jlimit(trimStart_, numFrames_, trimEnd) : numFrames_;
+    }
+    repaint();
+}
+
+void SegmentWaveformView::paint(juce::Graphics& g)
+{
+    const auto area = getLocalBounds().toFloat();
+    g.fillAll(juce::Colour(0xff12121f));
+    g.setFont(11.0f);
+    if (numFrames_ <= 0)
+    {
+        g.setColour(juce::Colours::grey);
+        g.drawText("Select a segment to see its waveform", area, juce::Justification::centred);
+        return;
+    }
+    if (peaks_ != nullptr)
+    {
+        g.setColour(juce::Colour(0xff6a8caf));
+        peaks_->draw(g, area, static_cast<juce::int64>(viewStart_), static_cast<juce::int64>(viewStart_ + viewSpan_));
+    }
+    else
+    {
+        g.setColour(juce::Colours::grey);
+        g.drawText("Loading waveform…", area, juce::Justification::centred);
+    }
+
+    // Dim what the trim leaves out, then the handles
+    const float xs = juce::jlimit(area.getX(), area.getRight(), frameToX(trimStart_));
+    const float xe = juce::jlimit(area.getX(), area.getRight(), frameToX(trimEnd_));
+    g.setColour(juce::Colours::black.withAlpha(0.55f));
+    g.fillRect(area.withRight(xs));
+    g.fillRect(area.withLeft(xe));
+    g.setColour(juce::Colours::orange);
+    g.fillRect(xs - 1.0f, area.getY(), 2.0f, area.getHeight());
+    g.fillRect(xe - 1.0f, area.getY(), 2.0f, area.getHeight());
+
+    g.setColour(juce::Colours::white.withAlpha(0.8f));
+    const juce::String range = formatSegmentTime(trimStart_ / sampleRate_) + " – " + formatSegmentTime(trimEnd_ / sampleRate_);
+    g.drawText(range, area.reduced(4.0f, 2.0f), juce::Justification::bottomLeft);
+}
+
+SegmentWaveformView::Drag SegmentWaveformView::hitTestHandles(float x) const
+{
+    if (numFrames_ <= 0)
+        return Drag::None;
+    const float ds = std::abs(x - frameToX(trimStart_));
+    const float de = std::abs(x - frameToX(trimEnd_));
+    if (ds <= kHandleGrabPixels && ds <= de)
+        return Drag::TrimStart;
+    if (de <= kHandleGrabPixels)
+        return Drag::TrimEnd;
+    return Drag::Pan;
+}
+
+void SegmentWaveformView::mouseMove(const juce::MouseEvent& e)
+{
+    const Drag hit = hitTestHandles(e.position.x);
+    setMouseCursor(hit == Drag::TrimStart || hit == Drag::TrimEnd ? juce::MouseCursor::LeftRightResizeCursor
+                                                                  : juce::MouseCursor::NormalCursor);
+}
+
+void SegmentWaveformView::mouseDown(const juce::MouseEvent& e)
+{
+    drag_ = hitTestHandles(e.position.x);
+    panStartView_ = viewStart_;
+}
+
+void SegmentWaveformView::mouseDrag(const juce::MouseEvent& e)
+{
+    switch (drag_)
+    {
+    case Drag::TrimStart:
+        trimStart_ = juce::jlimit(0, trimEnd_ - 1, xToFrame(e.position.x));
+        break;
+    case Drag::TrimEnd:
+        trimEnd_ = juce::jlimit(trimStart_ + 1, numFrames_, xToFrame(e.position.x));
+        break;
+    case Drag::Pan:
+        setView(panStartView_ - e.getDistanceFromDragStartX() * viewSpan_ / std::max(1, getWidth()), viewSpan_);
+        return;
+    case Drag::None:
+    default:
+        return;
+    }
+    repaint();
+    if (onTrimChanged_)
+        onTrimChanged_(trimStart_, trimEnd_);
+}
+
+void SegmentWaveformView::mouseUp(const juce::MouseEvent&)
+{
+    drag_ = Drag::None;
+}
+
+void SegmentWaveformView::mouseDoubleClick(const juce::MouseEvent&)
+{
+    setView(0.0, numFrames_);
+}
+
+void SegmentWaveformView::mouseWheelMove(const juce::MouseEvent& e, const juce::MouseWheelDetails& wheel)
+{
+    if (numFrames_ <= 0 || getWidth() <= 0)
+        return;
+    // Keep the frame under the mouse in place
+    const double anchor = viewStart_ + e.position.x / getWidth() * viewSpan_;
+    const double span = viewSpan_ * std::pow(2.0, -wheel.deltaY * 4.0);
+    const double clamped = juce::jlimit(static_cast<double>(std::min(numFrames_, getWidth())), static_cast<double>(numFrames_), span);
+    setView(anchor - (anchor - viewStart_) * clamped / viewSpan_, clamped);
+}
+
+float SegmentWaveformView::frameToX(double frame) const
+{
+    return viewSpan_ > 0.0 ? static_cast<float>((frame - viewStart_) / viewSpan_ * getWidth()) : 0.0f;
+}
+
+int SegmentWaveformView::xToFrame(float x) const
+{
+    return static_cast<int>(std::lround(viewStart_ + x / std::max(1, getWidth()) * viewSpan_));
+}
+
+void SegmentWaveformView::setView(double start, double span)
+{
+    viewSpan_ = span;
+    viewStart_ = juce::jlimit(0.0, std::max(0.0, numFrames_ - span), start);
+    repaint();
+}
+
 // --- Editor ---
 AceForgeSunoAudioProcessorEditor::AceForgeSunoAudioProcessorEditor(AceForgeSunoAudioProcessor& p)
     : AudioProcessorEditor(&p), processorRef(p), segmentsListModel(p), segmentsList("Segments", &segmentsListModel),
       libraryListModel(p), libraryList(p, libraryListModel)
 {
-    setSize(540, 760);
+    setSize(540, 846);
 
     sunoSettingsLabel.setText("Suno settings", juce::dontSendNotification);
     sunoSettingsLabel.setColour(juce::Label::textColourId, juce::Colours::white);
@@ -165,15 +476,40 @@ AceForgeSunoAudioProcessorEditor::AceForgeSunoAudioProcessorEditor(AceForgeSunoA
     trimLabel.setColour(juce::Label::textColourId, juce::Colours::white);
     addAndMakeVisible(trimLabel);
 
+    segmentWaveform.setOnTrimChanged([this](int startFrames, int endFrames)
+    {
+        const int idx = processorRef.getSelectedSegmentIndex();
+        if (idx < 0 || idx >= processorRef.getNumSegments())
+            return;
+        processorRef.setSegmentTrim(idx, startFrames, endFrames);
+        updateTrimSlidersFromSelection();
+        refreshSegmentsList();
+    });
+    addAndMakeVisible(segmentWaveform);
+
+    sliceCombo.setTooltip("Bar-aligned regions of the selected segment; picking one sets the trim.");
+    sliceCombo.onChange = [this]
+    {
+        const int idx = processorRef.getSelectedSegmentIndex();
+        const int choice = sliceCombo.getSelectedId() - 1;
+        if (idx != shownSlicesSegment_ || choice < 0 || choice >= static_cast<int>(shownSlices_.size()))
+            return;
+        const auto& region = shownSlices_[static_cast<size_t>(choice)];
+        processorRef.setSegmentTrim(idx, region.startFrame, region.endFrame);
+        updateTrimSlidersFromSelection();
+        refreshSegmentsList();
+    };
+    addAndMakeVisible(sliceCombo);
+
     trimStartSlider.setSliderStyle(juce::Slider::LinearHorizontal);
     trimStartSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 44, 18);
-    trimStartSlider.setRange(0.0, 600.0, 0.1);
+    trimStartSlider.setRange(0.0, 600.0, 0.01);
     trimStartSlider.onValueChange = [this] { applyTrimToSelectedSegment(); };
     addAndMakeVisible(trimStartSlider);
 
     trimEndSlider.setSliderStyle(juce::Slider::LinearHorizontal);
     trimEndSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 44, 18);
-    trimEndSlider.setRange(0.0, 600.0, 0.1);
+    trimEndSlider.setRange(0.0, 600.0, 0.01);
     trimEndSlider.onValueChange = [this] { applyTrimToSelectedSegment(); };
     addAndMakeVisible(trimEndSlider);
 
@@ -186,6 +522,56 @@ AceForgeSunoAudioProcessorEditor::AceForgeSunoAudioProcessorEditor(AceForgeSunoA
     };
     addAndMakeVisible(clearSegmentsButton);
 
+    preRollCombo.setTooltip("Audio kept while the transport is stopped and put in front of the next segment.");
+    for (int i = 0; i < juce::numElementsInArray(kPreRollChoicesSeconds); ++i)
+        preRollCombo.addItem(kPreRollChoicesSeconds[i] == 0 ? juce::String("No pre-roll")
+                                                            : "Pre-roll " + juce::String(kPreRollChoicesSeconds[i]) + " s",
+                             i + 1);
+    {
+        // Closest choice at or below the stored length
+        int selectedId = 1;
+        for (int i = 0; i < juce::numElementsInArray(kPreRollChoicesSeconds); ++i)
+            if (static_cast<float>(kPreRollChoicesSeconds[i]) <= processorRef.getPreRollSeconds())
+                selectedId = i + 1;
+        preRollCombo.setSelectedId(selectedId, juce::dontSendNotification);
+    }
+    preRollCombo.onChange = [this]
+    {
+        const int index = preRollCombo.getSelectedId() - 1;
+        if (index >= 0 && index < juce::numElementsInArray(kPreRollChoicesSeconds))
+            processorRef.setPreRollSeconds(static_cast<float>(kPreRollChoicesSeconds[index]));
+    };
+    addAndMakeVisible(preRollCombo);
+
+    memoryBudgetCombo.setTooltip("Memory for captured audio, shared by every instance. Older segments beyond it are "
+                                 "reloaded from disk when used.");
+    for (int i = 0; i < juce::numElementsInArray(kMemoryBudgetChoicesMb); ++i)
+        memoryBudgetCombo.addItem(kMemoryBudgetChoicesMb[i] < 1024
+                                      ? "Memory " + juce::String(kMemoryBudgetChoicesMb[i]) + " MB"
+                                      : "Memory " + juce::String(kMemoryBudgetChoicesMb[i] / 1024) + " GB",
+                                  i + 1);
+    {
+        // Closest choice at or below the stored budget
+        const juce::int64 budget = processorRef.getAudioMemoryBudgetBytes();
+        int selectedId = 1;
+        for (int i = 0; i < juce::numElementsInArray(kMemoryBudgetChoicesMb); ++i)
+            if (kMemoryBudgetChoicesMb[i] * kBytesPerMb <= budget)
+                selectedId = i + 1;
+        memoryBudgetCombo.setSelectedId(selectedId, juce::dontSendNotification);
+    }
+    memoryBudgetCombo.onChange = [this]
+    {
+        const int index = memoryBudgetCombo.getSelectedId() - 1;
+        if (index >= 0 && index < juce::numElementsInArray(kMemoryBudgetChoicesMb))
+            processorRef.setAudioMemoryBudgetBytes(kMemoryBudgetChoicesMb[index] * kBytesPerMb);
+        updateAudioMemoryUsage();
+    };
+    addAndMakeVisible(memoryBudgetCombo);
+    audioMemoryLabel.setColour(juce::Label::textColourId, juce::Colours::lightgrey);
+    audioMemoryLabel.setFont(juce::Font(juce::FontOptions().withPointHeight(10.0f)));
+    audioMemoryLabel.setMinimumHorizontalScale(0.7f);
+    addAndMakeVisible(audioMemoryLabel);
+
     promptLabel.setText("Prompt:", juce::dontSendNotification);
     promptLabel.setColour(juce::Label::textColourId, juce::Colours::white);
     addAndMakeVisible(promptLabel);
@@ -256,8 +642,38 @@ AceForgeSunoAudioProcessorEditor::AceForgeSunoAudioProcessorEditor(AceForgeSunoA
     libraryLabel.setColour(juce::Label::textColourId, juce::Colours::white);
     addAndMakeVisible(libraryLabel);
     refreshLibraryButton.setButtonText("Refresh");
-    refreshLibraryButton.onClick = [this] { refreshLibraryList(); };
+    refreshLibraryButton.onClick = [this] { processorRef.refreshLibrary(); };
     addAndMakeVisible(refreshLibraryButton);
+    similarButton.setButtonText("Similar");
+    similarButton.setTooltip("List entries that sound like the selected library entry (or the selected segment).");
+    similarButton.onClick = [this] { toggleSimilarSearch(); };
+    addAndMakeVisible(similarButton);
+    hostTempoToggle.setButtonText("Host BPM");
+    hostTempoToggle.setTooltip("Only list entries whose analysed tempo matches the host tempo (or half / double), closest first.");
+    hostTempoToggle.onClick = [this]
+    {
+        libraryListModel.setTempoFilter(hostTempoToggle.getToggleState() ? processorRef.getHostBpm() : 0.0);
+        if (libraryListModel.refreshSnapshot())
+        {
+            libraryList.deselectAllRows();
+            refreshLibraryList();
+        }
+    };
+    addAndMakeVisible(hostTempoToggle);
+    librarySearchEditor.setMultiLine(false);
+    librarySearchEditor.setTextToShowWhenEmpty("Search prompt, style, title, tags, model, day…", juce::Colours::grey);
+    librarySearchEditor.onTextChange = [this]
+    {
+        libraryListModel.setFilter(librarySearchEditor.getText());
+        pendingSimilarSegment_ = -1;
+        similarButton.setButtonText(libraryListModel.isShowingSimilar() ? "All" : "Similar");
+        if (libraryListModel.refreshSnapshot())
+        {
+            libraryList.deselectAllRows();
+            refreshLibraryList();
+        }
+    };
+    addAndMakeVisible(librarySearchEditor);
     addAndMakeVisible(libraryList);
     insertIntoDawButton.setButtonText("Insert into DAW");
     insertIntoDawButton.onClick = [this] { insertSelectedIntoDaw(); };
@@ -265,6 +681,35 @@ AceForgeSunoAudioProcessorEditor::AceForgeSunoAudioProcessorEditor(AceForgeSunoA
     revealInFinderButton.setButtonText("Reveal in Finder");
     revealInFinderButton.onClick = [this] { revealSelectedInFinder(); };
     addAndMakeVisible(revealInFinderButton);
+    pinButton.setButtonText("Pin");
+    pinButton.setTooltip("Pinned entries are kept when the library is over its size limit.");
+    pinButton.onClick = [this] { togglePinOnSelected(); };
+    addAndMakeVisible(pinButton);
+    quotaCombo.addItem("No limit", 1);
+    for (int i = 1; i < juce::numElementsInArray(kQuotaChoicesGb); ++i)
+        quotaCombo.addItem("Max " + juce::String(kQuotaChoicesGb[i]) + " GB", i + 1);
+    {
+        // Closest choice at or below the stored quota
+        const juce::int64 quota = processorRef.getLibraryQuotaBytes();
+        int selectedId = 1;
+        for (int i = 1; i < juce::numElementsInArray(kQuotaChoicesGb); ++i)
+            if (quota > 0 && kQuotaChoicesGb[i] * kBytesPerGb <= quota)
+                selectedId = i + 1;
+        quotaCombo.setSelectedId(selectedId, juce::dontSendNotification);
+    }
+    quotaCombo.onChange = [this]
+    {
+        const int index = quotaCombo.getSelectedId() - 1;
+        if (index >= 0 && index < juce::numElementsInArray(kQuotaChoicesGb))
+            processorRef.setLibraryQuotaBytes(kQuotaChoicesGb[index] * kBytesPerGb);
+        updateLibraryUsage();
+    };
+    addAndMakeVisible(quotaCombo);
+    libraryUsageLabel.setColour(juce::Label::textColourId, juce::Colours::lightgrey);
+    libraryUsageLabel.setFont(juce::Font(juce::FontOptions().withPointHeight(10.0f)));
+    libraryUsageLabel.setJustificationType(juce::Justification::centredRight);
+    libraryUsageLabel.setMinimumHorizontalScale(0.7f);
+    addAndMakeVisible(libraryUsageLabel);
     libraryHintLabel.setText("Drag a row to timeline, or double-click to copy path. Insert into DAW opens in Logic.", juce::dontSendNotification);
     libraryHintLabel.setColour(juce::Label::textColourId, juce::Colours::lightgrey);
     libraryHintLabel.setFont(juce::Font(juce::FontOptions().withPointHeight(10.0f)));
@@ -272,13 +717,17 @@ AceForgeSunoAudioProcessorEditor::AceForgeSunoAudioProcessorEditor(AceForgeSunoA
 
     libraryListModel.setOnRowDoubleClicked([this](int row)
     {
-        auto entries = processorRef.getLibraryEntries();
-        if (row < 0 || row >= static_cast<int>(entries.size()))
+        const LibraryEntry* entry = libraryListModel.getEntry(row);
+        if (entry == nullptr)
             return;
-        juce::SystemClipboard::copyTextToClipboard(entries[static_cast<size_t>(row)].file.getFullPathName());
+        juce::SystemClipboard::copyTextToClipboard(entry->file.getFullPathName());
+        processorRef.touchLibraryFile(entry->file);
         showLibraryFeedback();
     });
 
+    libraryListModel.refreshSnapshot();
+    libraryList.updateContent();
+
     // Restore API key from processor (already loaded from state)
     apiKeyEditor.setText(processorRef.getApiKey(), juce::dontSendNotification);
     startTimerHz(4);
@@ -315,7 +764,23 @@ void AceForgeSunoAudioProcessorEditor::timerCallback()
     if (processorRef.getSelectedSegmentIndex() != segmentsList.getSelectedRow())
         segmentsList.selectRow(processorRef.getSelectedSegmentIndex());
     updateTrimSlidersFromSelection();
-    libraryList.updateContent();
+    if (pendingSimilarSegment_ >= 0)
+    {
+        std::vector<float> features = processorRef.getSegmentFeatures(pendingSimilarSegment_);
+        if (!features.empty())
+        {
+            showSimilarTo(std::move(features), {}, "segment " + juce::String(pendingSimilarSegment_ + 1));
+            pendingSimilarSegment_ = -1;
+        }
+    }
+    if (hostTempoToggle.getToggleState())
+        libraryListModel.setTempoFilter(bpm);
+    if (libraryListModel.refreshSnapshot())
+        refreshLibraryList();
+    else if (libraryListModel.peaksChanged())
+        libraryList.repaint();
+    updateLibraryUsage();
+    updateAudioMemoryUsage();
 }
 
 void AceForgeSunoAudioProcessorEditor::refreshSegmentsList()
@@ -333,21 +798,55 @@ void AceForgeSunoAudioProcessorEditor::updateTrimSlidersFromSelection()
         trimEndSlider.setEnabled(false);
         trimStartSlider.setValue(0.0, juce::dontSendNotification);
         trimEndSlider.setValue(0.0, juce::dontSendNotification);
+        segmentWaveform.setSegment(-1, nullptr, 0, 0.0, 0, 0);
+        updateSliceChoices(-1);
         return;
     }
     auto seg = processorRef.getSegment(idx);
-    const int totalFrames = static_cast<int>(seg.buffer.size()) / 2;
+    const int totalFrames = seg.numFrames;
     const double totalSec = totalFrames / (seg.sampleRate > 0.0 ? seg.sampleRate : 44100.0);
     const int end = seg.trimEndSamples > 0 ? seg.trimEndSamples : totalFrames;
     const double startSec = seg.trimStartSamples / (seg.sampleRate > 0.0 ? seg.sampleRate : 44100.0);
     const double endSec = end / (seg.sampleRate > 0.0 ? seg.sampleRate : 44100.0);
 
-    trimStartSlider.setRange(0.0, totalSec, 0.1);
-    trimEndSlider.setRange(0.0, totalSec, 0.1);
+    trimStartSlider.setRange(0.0, totalSec, 0.01);
+    trimEndSlider.setRange(0.0, totalSec, 0.01);
     trimStartSlider.setValue(startSec, juce::dontSendNotification);
     trimEndSlider.setValue(endSec, juce::dontSendNotification);
     trimStartSlider.setEnabled(true);
     trimEndSlider.setEnabled(true);
+    segmentWaveform.setSegment(idx, processorRef.getSegmentPeaks(idx), totalFrames, seg.sampleRate,
+                               seg.trimStartSamples, end);
+    updateSliceChoices(idx);
+}
+
+// Refills the slice menu when the selection changes or its proposals become ready
+void AceForgeSunoAudioProcessorEditor::updateSliceChoices(int segmentIndex)
+{
+    std::vector<SegmentSlicer::Region> slices;
+    const bool ready = segmentIndex >= 0 && processorRef.getSegmentSlices(segmentIndex, slices);
+    if (segmentIndex == shownSlicesSegment_ && ready == shownSlicesReady_)
+        return;
+    shownSlicesSegment_ = segmentIndex;
+    shownSlicesReady_ = ready;
+    shownSlices_ = std::move(slices);
+
+    sliceCombo.clear(juce::dontSendNotification);
+    const auto seg = processorRef.getSegment(segmentIndex);
+    const double rate = seg.sampleRate > 0.0 ? seg.sampleRate : 44100.0;
+    for (size_t i = 0; i < shownSlices_.size(); ++i)
+        sliceCombo.addItem(SegmentSlicer::describe(shownSlices_[i]) + "  ("
+                               + formatSegmentTime(shownSlices_[i].startFrame / rate) + ")",
+                           static_cast<int>(i) + 1);
+    if (segmentIndex < 0)
+        sliceCombo.setTextWhenNothingSelected("Bar slices");
+    else if (!ready)
+        sliceCombo.setTextWhenNothingSelected("Finding bars…");
+    else if (shownSlices_.empty())
+        sliceCombo.setTextWhenNothingSelected("No tempo for bar slices");
+    else
+        sliceCombo.setTextWhenNothingSelected("Bar slices (" + juce::String(shownSlices_.size()) + ")");
+    sliceCombo.setEnabled(!shownSlices_.empty());
 }
 
 void AceForgeSunoAudioProcessorEditor::applyTrimToSelectedSegment()
@@ -357,7 +856,7 @@ void AceForgeSunoAudioProcessorEditor::applyTrimToSelectedSegment()
         return;
     auto seg = processorRef.getSegment(idx);
     const double rate = seg.sampleRate > 0.0 ? seg.sampleRate : 44100.0;
-    const int totalFrames = static_cast<int>(seg.buffer.size()) / 2;
+    const int totalFrames = seg.numFrames;
     int startSamples = juce::jlimit(0, totalFrames, static_cast<int>(trimStartSlider.getValue() * rate + 0.5));
     int endSamples = juce::jlimit(0, totalFrames, static_cast<int>(trimEndSlider.getValue() * rate + 0.5));
     if (endSamples <= startSamples)
@@ -369,14 +868,27 @@ void AceForgeSunoAudioProcessorEditor::applyTrimToSelectedSegment()
 void AceForgeSunoAudioProcessorEditor::updateStatusFromProcessor()
 {
     const auto state = processorRef.getState();
-    if (state == AceForgeSunoAudioProcessor::State::Succeeded)
-        refreshLibraryList();
-    if (processorRef.isConnected())
+    switch (processorRef.getConnection())
+    {
+    case AceForgeSunoAudioProcessor::Connection::Connected:
         connectionLabel.setText("Suno: connected", juce::dontSendNotification);
-    else if (state == AceForgeSunoAudioProcessor::State::Failed)
-        connectionLabel.setText("Suno: error (see status)", juce::dontSendNotification);
-    else
-        connectionLabel.setText("Suno: set API key and save", juce::dontSendNotification);
+        break;
+    case AceForgeSunoAudioProcessor::Connection::Checking:
+        connectionLabel.setText("Suno: checking key…", juce::dontSendNotification);
+        break;
+    case AceForgeSunoAudioProcessor::Connection::Failed:
+    {
+        const juce::String error = processorRef.getConnectionError();
+        connectionLabel.setText(error.isNotEmpty() ? "Suno: " + error : "Suno: key check failed", juce::dontSendNotification);
+        break;
+    }
+    case AceForgeSunoAudioProcessor::Connection::NoKey:
+    default:
+        connectionLabel.setText(state == AceForgeSunoAudioProcessor::State::Failed ? "Suno: error (see status)"
+                                                                                   : "Suno: set API key and save",
+                                juce::dontSendNotification);
+        break;
+    }
 
     statusLabel.setText(processorRef.getStatusText(), juce::dontSendNotification);
     if (state == AceForgeSunoAudioProcessor::State::Failed)
@@ -400,21 +912,21 @@ void AceForgeSunoAudioProcessorEditor::refreshLibraryList()
 
 void AceForgeSunoAudioProcessorEditor::insertSelectedIntoDaw()
 {
-    const int row = libraryList.getSelectedRow();
-    auto entries = processorRef.getLibraryEntries();
-    if (row < 0 || row >= static_cast<int>(entries.size()))
+    const LibraryEntry* entry = libraryListModel.getEntry(libraryList.getSelectedRow());
+    if (entry == nullptr)
     {
         libraryFeedbackMessage_ = "Select a library entry first.";
         libraryFeedbackCountdown_ = 8;
         return;
     }
-    const juce::File& file = entries[static_cast<size_t>(row)].file;
+    const juce::File file = entry->file;
     if (!file.existsAsFile())
     {
         libraryFeedbackMessage_ = "File not found.";
         libraryFeedbackCountdown_ = 8;
         return;
     }
+    processorRef.touchLibraryFile(file);
     juce::String path = file.getFullPathName();
     juce::SystemClipboard::copyTextToClipboard(path);
 #if JUCE_MAC
@@ -436,17 +948,19 @@ void AceForgeSunoAudioProcessorEditor::insertSelectedIntoDaw()
 
 void AceForgeSunoAudioProcessorEditor::revealSelectedInFinder()
 {
-    const int row = libraryList.getSelectedRow();
-    auto entries = processorRef.getLibraryEntries();
-    if (row < 0 || row >= static_cast<int>(entries.size()))
+    const LibraryEntry* entry = libraryListModel.getEntry(libraryList.getSelectedRow());
+    if (entry == nullptr)
     {
         libraryFeedbackMessage_ = "Select a library entry first.";
         libraryFeedbackCountdown_ = 8;
         return;
     }
-    const juce::File& f = entries[static_cast<size_t>(row)].file;
+    const juce::File f = entry->file;
     if (f.existsAsFile())
+    {
+        processorRef.touchLibraryFile(f);
         f.revealToUser();
+    }
     else
     {
         libraryFeedbackMessage_ = "File not found.";
@@ -454,6 +968,99 @@ void AceForgeSunoAudioProcessorEditor::revealSelectedInFinder()
     }
 }
 
+void AceForgeSunoAudioProcessorEditor::togglePinOnSelected()
+{
+    const LibraryEntry* entry = libraryListModel.getEntry(libraryList.getSelectedRow());
+    if (entry == nullptr)
+    {
+        libraryFeedbackMessage_ = "Select a library entry first.";
+        libraryFeedbackCountdown_ = 8;
+        return;
+    }
+    processorRef.setLibraryFilePinned(entry->file, !entry->pinned);
+}
+
+void AceForgeSunoAudioProcessorEditor::toggleSimilarSearch()
+{
+    if (libraryListModel.isShowingSimilar() || pendingSimilarSegment_ >= 0)
+    {
+        pendingSimilarSegment_ = -1;
+        libraryListModel.clearSimilar();
+        similarButton.setButtonText("Similar");
+        if (libraryListModel.refreshSnapshot())
+            refreshLibraryList();
+        return;
+    }
+    if (const LibraryEntry* entry = libraryListModel.getEntry(libraryList.getSelectedRow()))
+    {
+        if (entry->features.empty())
+        {
+            libraryFeedbackMessage_ = "This entry has not been analysed yet - try again in a moment.";
+            libraryFeedbackCountdown_ = 10;
+            return;
+        }
+        showSimilarTo(entry->features, entry->file,
+                      entry->prompt.isNotEmpty() ? entry->prompt : entry->file.getFileName());
+        return;
+    }
+    const int segment = processorRef.getSelectedSegmentIndex();
+    if (segment >= 0 && segment < processorRef.getNumSegments())
+    {
+        processorRef.requestSegmentFeatures(segment);
+        pendingSimilarSegment_ = segment;
+        similarButton.setButtonText("All");
+        libraryFeedbackMessage_ = "Analysing segment " + juce::String(segment + 1) + "…";
+        libraryFeedbackCountdown_ = 6;
+        return;
+    }
+    libraryFeedbackMessage_ = "Select a library entry or a recorded segment first.";
+    libraryFeedbackCountdown_ = 8;
+}
+
+void AceForgeSunoAudioProcessorEditor::showSimilarTo(std::vector<float> features, const juce::File& exclude,
+                                                     const juce::String& what)
+{
+    librarySearchEditor.setText({}, false);
+    libraryListModel.setSimilarTo(std::move(features), exclude);
+    similarButton.setButtonText("All");
+    if (libraryListModel.refreshSnapshot())
+    {
+        libraryList.deselectAllRows();
+        refreshLibraryList();
+    }
+    libraryFeedbackMessage_ = "Sounds like: " + what;
+    libraryFeedbackCountdown_ = 12;
+}
+
+void AceForgeSunoAudioProcessorEditor::updateLibraryUsage()
+{
+    const LibraryEntry* selected = libraryListModel.getEntry(libraryList.getSelectedRow());
+    pinButton.setButtonText(selected != nullptr && selected->pinned ? "Unpin" : "Pin");
+
+    juce::String usage = juce::File::descriptionOfSizeInBytes(processorRef.getLibraryTotalBytes());
+    const juce::int64 quota = processorRef.getLibraryQuotaBytes();
+    if (quota > 0)
+        usage << " of " << juce::File::descriptionOfSizeInBytes(quota);
+    const juce::int64 reclaimed = processorRef.getLibraryReclaimedBytes();
+    if (reclaimed > 0)
+        usage << ", " << juce::File::descriptionOfSizeInBytes(reclaimed) << " freed";
+    libraryUsageLabel.setText(usage, juce::dontSendNotification);
+}
+
+void AceForgeSunoAudioProcessorEditor::updateAudioMemoryUsage()
+{
+    juce::String usage = "Audio in memory: " + juce::File::descriptionOfSizeInBytes(processorRef.getAudioMemoryBytes());
+    const int instances = processorRef.getNumAudioMemoryInstances();
+    if (instances > 1)
+        usage << ", all " << instances << " instances: "
+              << juce::File::descriptionOfSizeInBytes(processorRef.getProcessAudioMemoryBytes());
+    usage << " of " << juce::File::descriptionOfSizeInBytes(processorRef.getAudioMemoryBudgetBytes());
+    const juce::int64 fileBytes = processorRef.getSegmentFileBytes();
+    if (fileBytes > 0)
+        usage << "; segment files " << juce::File::descriptionOfSizeInBytes(fileBytes);
+    audioMemoryLabel.setText(usage, juce::dontSendNotification);
+}
+
 void AceForgeSunoAudioProcessorEditor::showLibraryFeedback()
 {
     libraryFeedbackMessage_ = "Path copied. Insert into DAW or Reveal in Finder.";
@@ -495,12 +1102,19 @@ void AceForgeSunoAudioProcessorEditor::resized()
     auto segHeader = r.removeFromTop(22);
     segmentsLabel.setBounds(segHeader.getX(), segHeader.getY(), 140, 22);
     clearSegmentsButton.setBounds(segHeader.getX() + 144, segHeader.getY(), 120, 22);
+    preRollCombo.setBounds(segHeader.getX() + 268, segHeader.getY(), 110, 22);
+    memoryBudgetCombo.setBounds(segHeader.getX() + 382, segHeader.getY(), segHeader.getWidth() - 382, 22);
     r.removeFromTop(4);
     segmentsList.setBounds(r.getX(), r.getY(), r.getWidth(), 100);
     r.removeFromTop(100);
+    audioMemoryLabel.setBounds(r.getX(), r.getY(), r.getWidth(), 16);
+    r.removeFromTop(18);
     r.removeFromTop(4);
     trimLabel.setBounds(r.getX(), r.getY(), 120, 20);
+    sliceCombo.setBounds(r.getX() + 124, r.getY(), 260, 20);
     r.removeFromTop(22);
+    segmentWaveform.setBounds(r.getX(), r.getY(), r.getWidth(), 64);
+    r.removeFromTop(68);
     trimStartSlider.setBounds(r.getX(), r.getY(), r.getWidth(), 22);
     r.removeFromTop(24);
     trimEndSlider.setBounds(r.getX(), r.getY(), r.getWidth(), 22);
@@ -532,6 +1146,9 @@ void AceForgeSunoAudioProcessorEditor::resized()
     auto libHeader = r.removeFromTop(22);
     libraryLabel.setBounds(libHeader.getX(), libHeader.getY(), 60, 22);
     refreshLibraryButton.setBounds(libHeader.getX() + 64, libHeader.getY(), 60, 22);
+    similarButton.setBounds(libHeader.getX() + 128, libHeader.getY(), 60, 22);
+    hostTempoToggle.setBounds(libHeader.getX() + 192, libHeader.getY(), 86, 22);
+    librarySearchEditor.setBounds(libHeader.getX() + 282, libHeader.getY() + 1, libHeader.getWidth() - 282, 20);
     r.removeFromTop(4);
     libraryList.setBounds(r.getX(), r.getY(), r.getWidth(), 140);
     r.removeFromTop(140);
@@ -539,6 +1156,9 @@ void AceForgeSunoAudioProcessorEditor::resized()
     row = r.removeFromTop(24);
     insertIntoDawButton.setBounds(row.getX(), row.getY(), 120, 22);
     revealInFinderButton.setBounds(row.getX() + 124, row.getY(), 110, 22);
+    pinButton.setBounds(row.getX() + 238, row.getY(), 50, 22);
+    quotaCombo.setBounds(row.getX() + 292, row.getY(), 96, 22);
+    libraryUsageLabel.setBounds(row.getX() + 390, row.getY(), row.getWidth() - 390, 22);
     r.removeFromTop(4);
     libraryHintLabel.setBounds(r.getX(), r.getY(), r.getWidth(), 36);
 }
@@ -4,6 +4,7 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_gui_basics/juce_gui_basics.h>
 #include "PluginProcessor.h"
+#include "WaveformPeaks.h"
 
 class AceForgeSunoAudioProcessorEditor;
 
@@ -11,6 +12,21 @@ class LibraryListModelSuno : public juce::ListBoxModel
 {
 public:
     explicit LibraryListModelSuno(AceForgeSunoAudioProcessor& p) : processor(p) {}
+    /** Pulls the latest library snapshot from the shared index; returns true if it changed. */
+    bool refreshSnapshot();
+    /** Live filter (LibraryIndex::search); takes effect on the next refreshSnapshot(). */
+    void setFilter(const juce::String& query);
+    /** Lists the library entries most similar to features (best first) instead of the filter;
+        exclude is the reference entry itself. Takes effect on the next refreshSnapshot(). */
+    void setSimilarTo(std::vector<float> features, const juce::File& exclude);
+    void clearSimilar();
+    bool isShowingSimilar() const { return !similarFeatures_.empty(); }
+    /** Keeps only entries whose analysed tempo matches bpm (also at half / double tempo),
+        closest first; 0 turns the filter off. Takes effect on the next refreshSnapshot(). */
+    void setTempoFilter(double bpm);
+    /** True once after new waveform thumbnails became available. */
+    bool peaksChanged();
+    const LibraryEntry* getEntry(int row) const;
     int getNumRows() override;
     void paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected) override;
     void listBoxItemDoubleClicked(int row, const juce::MouseEvent&) override;
@@ -18,6 +34,15 @@ public:
 
 private:
     AceForgeSunoAudioProcessor& processor;
+    LibraryIndex::SnapshotPtr snapshot_;
+    juce::uint32 snapshotVersion_{ 0 };
+    juce::String filter_;
+    bool filterChanged_{ false };
+    std::vector<float> similarFeatures_;
+    juce::File similarExclude_;
+    double tempoFilterBpm_{ 0.0 };
+    juce::SharedResourcePointer<WaveformPeakStore> peakStore_;
+    juce::uint32 peaksVersion_{ 0 };
     std::function<void(int)> onRowDoubleClicked_;
 };
 
@@ -30,6 +55,7 @@ public:
 
 private:
     AceForgeSunoAudioProcessor& processorRef;
+    LibraryListModelSuno& modelRef;
     bool dragStarted_{ false };
 };
 
@@ -49,6 +75,48 @@ private:
     std::function<void(int)> onRowSelected_;
 };
 
+// Waveform of the selected segment with draggable trim handles. Drawn from the segment's
+// PeakPyramid, so the cost depends on the width only. Wheel zooms around the mouse, dragging
+// elsewhere pans, double-click shows the whole segment.
+class SegmentWaveformView : public juce::Component
+{
+public:
+    /** The view resets its zoom when a different segment (index or length) is shown. */
+    void setSegment(int index, std::shared_ptr<const PeakPyramid> peaks, int numFrames, double sampleRate,
+                    int trimStart, int trimEnd);
+    void setOnTrimChanged(std::function<void(int, int)> f) { onTrimChanged_ = std::move(f); }
+
+    void paint(juce::Graphics& g) override;
+    void mouseMove(const juce::MouseEvent& e) override;
+    void mouseDown(const juce::MouseEvent& e) override;
+    void mouseDrag(const juce::MouseEvent& e) override;
+    void mouseUp(const juce::MouseEvent& e) override;
+    void mouseDoubleClick(const juce::MouseEvent& e) override;
+    void mouseWheelMove(const juce::MouseEvent& e, const juce::MouseWheelDetails& wheel) override;
+
+private:
+    enum class Drag { None, TrimStart, TrimEnd, Pan };
+
+    static constexpr float kHandleGrabPixels = 5.0f;
+
+    Drag hitTestHandles(float x) const;
+    float frameToX(double frame) const;
+    int xToFrame(float x) const;
+    void setView(double start, double span);
+
+    int index_{ -1 };
+    std::shared_ptr<const PeakPyramid> peaks_;
+    int numFrames_{ 0 };
+    double sampleRate_{ 44100.0 };
+    int trimStart_{ 0 };
+    int trimEnd_{ 0 };          // exclusive, always resolved (never 0 for "full length")
+    double viewStart_{ 0.0 };   // visible range in frames
+    double viewSpan_{ 0.0 };
+    Drag drag_{ Drag::None };
+    double panStartView_{ 0.0 };
+    std::function<void(int, int)> onTrimChanged_;
+};
+
 class AceForgeSunoAudioProcessorEditor : public juce::AudioProcessorEditor,
                                          public juce::DragAndDropContainer,
                                          public juce::Timer
@@ -78,9 +146,14 @@ private:
     SegmentsListModelSuno segmentsListModel;
     juce::ListBox segmentsList;
     juce::Label trimLabel;
+    SegmentWaveformView segmentWaveform;
+    juce::ComboBox sliceCombo;
     juce::Slider trimStartSlider;
     juce::Slider trimEndSlider;
     juce::TextButton clearSegmentsButton;
+    juce::ComboBox preRollCombo;
+    juce::ComboBox memoryBudgetCombo;
+    juce::Label audioMemoryLabel;
     juce::Label promptLabel;
     juce::TextEditor promptEditor;
     juce::Label styleLabel;
@@ -97,23 +170,39 @@ private:
     juce::Label statusLabel;
     juce::Label libraryLabel;
     juce::TextButton refreshLibraryButton;
+    juce::TextButton similarButton;
+    juce::ToggleButton hostTempoToggle;
+    juce::TextEditor librarySearchEditor;
     LibraryListModelSuno libraryListModel;
     LibraryListBoxSuno libraryList;
     juce::TextButton insertIntoDawButton;
     juce::TextButton revealInFinderButton;
+    juce::TextButton pinButton;
+    juce::ComboBox quotaCombo;
+    juce::Label libraryUsageLabel;
     juce::Label libraryHintLabel;
 
     juce::String libraryFeedbackMessage_;
     int libraryFeedbackCountdown_{ 0 };
+    int pendingSimilarSegment_{ -1 };   // segment being analysed for a similarity search
+    std::vector<SegmentSlicer::Region> shownSlices_;   // sliceCombo item id = index + 1
+    int shownSlicesSegment_{ -1 };
+    bool shownSlicesReady_{ false };
 
     void updateStatusFromProcessor();
     void saveApiKey();
     void refreshSegmentsList();
     void updateTrimSlidersFromSelection();
     void applyTrimToSelectedSegment();
+    void updateSliceChoices(int segmentIndex);
     void refreshLibraryList();
     void insertSelectedIntoDaw();
     void revealSelectedInFinder();
+    void togglePinOnSelected();
+    void toggleSimilarSearch();
+    void showSimilarTo(std::vector<float> features, const juce::File& exclude, const juce::String& what);
+    void updateLibraryUsage();
+    void updateAudioMemoryUsage();
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AceForgeSunoAudioProcessorEditor)
 };
@@ -1,14 +1,21 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "AudioFeatures.h"
+#include "ContentHash.h"
+#include "PluginState.h"
+#include "SampleKernels.h"
+#include "SegmentStore.h"
 #include <algorithm>
-#include <chrono>
 #include <cmath>
+#include <cstring>
 #include <fstream>
-#include <thread>
+#include <set>
 #include <vector>
 
 namespace
 {
+constexpr int kUploadBitsPerSample = 24;
+
 suno::Model modelFromIndex(int index)
 {
     switch (index)
@@ -21,6 +28,80 @@ suno::Model modelFromIndex(int index)
     default: return suno::Model::V4_5ALL;
     }
 }
+
+// Left / right gain of each channel of set for the stereo upload: fronts go to their side, centre
+// and surrounds at -3 dB, LFE is dropped, other channels alternate. Each side is scaled down if
+// its gains add up to more than 1, so the downmix cannot clip where the sources did not.
+// Row-major for SampleKernels::mixMatrix (gains[channel * 2 + side]).
+std::vector<float> stereoDownmixGains(const juce::AudioChannelSet& set, int numChannels)
+{
+    constexpr float kSide = 0.7071f;
+    if (numChannels == 1)
+        return { 1.0f, 1.0f };
+    std::vector<std::array<float, 2>> gains(static_cast<size_t>(numChannels));
+    using Ch = juce::AudioChannelSet;
+    for (int c = 0; c < numChannels; ++c)
+    {
+        auto& g = gains[static_cast<size_t>(c)];
+        switch (set.size() == numChannels ? set.getTypeOfChannel(c) : Ch::discreteChannel0)
+        {
+        case Ch::left: case Ch::leftCentre: case Ch::wideLeft: case Ch::topFrontLeft: g = { 1.0f, 0.0f }; break;
+        case Ch::right: case Ch::rightCentre: case Ch::wideRight: case Ch::topFrontRight: g = { 0.0f, 1.0f }; break;
+        case Ch::centre: case Ch::centreSurround: case Ch::topMiddle: case Ch::topFrontCentre: case Ch::topRearCentre:
+            g = { kSide, kSide }; break;
+        case Ch::leftSurround: case Ch::leftSurroundSide: case Ch::leftSurroundRear: case Ch::topRearLeft:
+        case Ch::topSideLeft: g = { kSide, 0.0f }; break;
+        case Ch::rightSurround: case Ch::rightSurroundSide: case Ch::rightSurroundRear: case Ch::topRearRight:
+        case Ch::topSideRight: g = { 0.0f, kSide }; break;
+        case Ch::LFE: case Ch::LFE2: g = { 0.0f, 0.0f }; break;
+        default: g = (c % 2 == 0) ? std::array<float, 2>{ 1.0f, 0.0f } : std::array<float, 2>{ 0.0f, 1.0f }; break;
+        }
+    }
+    for (size_t side = 0; side < 2; ++side)
+    {
+        float sum = 0.0f;
+        for (const auto& g : gains)
+            sum += g[side];
+        if (sum > 1.0f)
+            for (auto& g : gains)
+                g[side] /= sum;
+    }
+    std::vector<float> matrix;
+    for (const auto& g : gains)
+        matrix.insert(matrix.end(), g.begin(), g.end());
+    return matrix;
+}
+
+juce::MemoryBlock packWholeAudio(const SegmentAudio& audio)
+{
+    std::vector<const float*> rows(static_cast<size_t>(audio.getNumChannels()));
+    audio.getReadPointers(rows.data());
+    return SegmentStore::pack(rows.data(), audio.getNumChannels(), audio.getNumFrames());
+}
+
+CompactAudio::ParallelFor parallelForOn(SharedServices& services)
+{
+    return [&services](int numItems, const std::function<void(int)>& item) { services.parallelFor(numItems, item); };
+}
+
+// Canonical 44-byte PCM header
+void writeWavHeader(juce::OutputStream& out, int numChannels, double sampleRate, int bitsPerSample, juce::uint32 dataBytes)
+{
+    const auto blockAlign = static_cast<short>(numChannels * bitsPerSample / 8);
+    const auto rate = static_cast<int>(std::lround(sampleRate));
+    out.write("RIFF", 4);
+    out.writeInt(static_cast<int>(36 + dataBytes));
+    out.write("WAVEfmt ", 8);
+    out.writeInt(16);
+    out.writeShort(1); // PCM
+    out.writeShort(static_cast<short>(numChannels));
+    out.writeInt(rate);
+    out.writeInt(rate * blockAlign);
+    out.writeShort(blockAlign);
+    out.writeShort(static_cast<short>(bitsPerSample));
+    out.write("data", 4);
+    out.writeInt(static_cast<int>(dataBytes));
+}
 } // namespace
 
 AceForgeSunoAudioProcessor::AceForgeSunoAudioProcessor()
@@ -28,21 +109,32 @@ AceForgeSunoAudioProcessor::AceForgeSunoAudioProcessor()
 #if !JucePlugin_IsMidiEffect
 #if !JucePlugin_IsSynth
                          .withInput("Input", juce::AudioChannelSet::stereo(), true)
+                         .withInput("Sidechain", juce::AudioChannelSet::stereo(), false)
 #endif
                          .withOutput("Output", juce::AudioChannelSet::stereo(), true)
 #endif
       )
 {
     client_ = std::make_unique<suno::SunoClient>("");
-    playbackBuffer_.resize(kPlaybackFifoFrames * 2, 0.0f);
     {
         juce::ScopedLock l(statusLock_);
         statusText_ = "Set API key and click Generate, or record and use Cover / Add Vocals.";
     }
+    services_->setLiveSegmentKeys(this, {});
+    startTimer(kSegmentMemoryTimerId, kSegmentMemoryIntervalMs);
 }
 
 AceForgeSunoAudioProcessor::~AceForgeSunoAudioProcessor()
 {
+    lifetime_->end(); // running jobs skip whatever would still touch this instance
+    services_->cancelAll(this);
+    stopTimer(kPlaybackTimerId);
+    stopTimer(kSegmentMemoryTimerId);
+    services_->getAudioMemory().setUsage(this, 0);
+    releasePlaybackBlock(pendingPlayback_.exchange(nullptr));
+    releasePlaybackBlock(activePlayback_);
+    activePlayback_ = nullptr;
+    reclaimFinishedPlayback();
     cancelPendingUpdate();
 }
 
@@ -50,18 +142,94 @@ void AceForgeSunoAudioProcessor::prepareToPlay(double sampleRate, int samplesPer
 {
     juce::ignoreUnused(samplesPerBlock);
     sampleRate_.store(sampleRate);
+
+    // Bus layouts only change between prepareToPlay calls: captures started from here on use these
+    CaptureFormat format;
+    const auto mainInput = getChannelLayoutOfBus(true, 0);
+    format.mainChannels = std::min(mainInput.size(), kMaxInputChannels);
+    format.layout = mainInput == juce::AudioChannelSet::stereo() ? juce::String() : mainInput.getSpeakerArrangementAsString();
+    if (getBusCount(true) > 1 && getBus(true, 1)->isEnabled())
+        format.sidechainChannels = std::min(getChannelCountOfBus(true, 1), kMaxSidechainChannels);
+    {
+        juce::ScopedLock l(segmentLock_);
+        inputFormat_ = format;
+    }
+    resizePreRoll();
+    refillCaptureBuffer();
+}
+
+void AceForgeSunoAudioProcessor::setPreRollSeconds(float seconds)
+{
+    preRollSeconds_.store(juce::jlimit(0.0f, kMaxPreRollSeconds, seconds));
+    resizePreRoll();
+}
+
+// The ring only holds the configured length; the callback lock keeps processBlock out meanwhile
+void AceForgeSunoAudioProcessor::resizePreRoll()
+{
+    const int frames = static_cast<int>(preRollSeconds_.load() * sampleRate_.load());
+    int numChannels = 0;
+    {
+        juce::ScopedLock l(segmentLock_);
+        numChannels = inputFormat_.getNumChannels();
+    }
+    const juce::ScopedLock pl(preRollLock_);
+    if (frames == preRoll_.getCapacity() && numChannels == preRoll_.getNumChannels())
+        return;
+    const juce::ScopedLock cl(getCallbackLock());
+    preRoll_.setCapacity(numChannels, frames);
 }
 
 void AceForgeSunoAudioProcessor::releaseResources() {}
 
+// Hosts may end a bounce without stopping the transport: the offline capture ends with it
+void AceForgeSunoAudioProcessor::setNonRealtime(bool isNonRealtime) noexcept
+{
+    AudioProcessor::setNonRealtime(isNonRealtime);
+    juce::ScopedLock l(segmentLock_);
+    if (!isNonRealtime && offlineWriter_ != nullptr)
+    {
+        finishOfflineCapture();
+        wasPlaying_ = false; // the next playing block starts a new capture
+        transportRecording_.store(false);
+    }
+}
+
 void AceForgeSunoAudioProcessor::setApiKey(const juce::String& key)
 {
     apiKey_ = key.trim();
     if (client_)
         client_->setApiKey(apiKey_.toStdString());
-    connected_.store(false);
-    if (client_ && client_->hasApiKey() && client_->checkCredits())
-        connected_.store(true);
+    requestHealthCheck();
+}
+
+// Validates the key with a credits request on the shared job pool; the editor picks up the
+// result from getConnection(). Only the newest check may publish its result.
+void AceForgeSunoAudioProcessor::requestHealthCheck()
+{
+    const std::string key = apiKey_.toStdString();
+    const int generation = ++healthCheckGeneration_;
+    if (key.empty())
+    {
+        connection_.store(Connection::NoKey);
+        return;
+    }
+    connection_.store(Connection::Checking);
+    services_->addJob(this, [job = makeNetworkJob(), key, generation]
+    {
+        std::string error;
+        const bool ok = job.network->checkCredits(key, error);
+        job.withProcessor([&](auto& self)
+        {
+            if (self.healthCheckGeneration_.load() != generation)
+                return;
+            {
+                juce::ScopedLock l(self.statusLock_);
+                self.connectionError_ = juce::String(error);
+            }
+            self.connection_.store(ok ? Connection::Connected : Connection::Failed);
+        });
+    });
 }
 
 void AceForgeSunoAudioProcessor::clearAllSegments()
@@ -69,6 +237,8 @@ void AceForgeSunoAudioProcessor::clearAllSegments()
     juce::ScopedLock l(segmentLock_);
     segments_.clear();
     currentSegmentBuffer_.clear();
+    for (auto& stopped : stoppedCaptures_)
+        stopped.capture.clear();
     selectedSegmentIndex_.store(-1);
 }
 
@@ -86,11 +256,55 @@ AceForgeSunoAudioProcessor::RecordedSegment AceForgeSunoAudioProcessor::getSegme
     return segments_[static_cast<size_t>(index)];
 }
 
+AceForgeSunoAudioProcessor::RecordedSegment AceForgeSunoAudioProcessor::getSegmentWithAudio(int index)
+{
+    RecordedSegment seg;
+    {
+        juce::ScopedLock l(segmentLock_);
+        if (index < 0 || index >= static_cast<int>(segments_.size()))
+            return {};
+        auto& stored = segments_[static_cast<size_t>(index)];
+        stored.lastUsedMs = juce::Time::currentTimeMillis(); // holds off compactIdleSegments()
+        seg = stored;
+    }
+    if (seg.audio != nullptr || seg.numFrames <= 0)
+        return seg;
+
+    SegmentAudio samples;
+    bool loaded = true;
+    if (seg.compactAudio != nullptr)
+        samples = seg.compactAudio->decode(parallelForOn(*services_));
+    else if (seg.packedAudio != nullptr)
+        loaded = SegmentStore::unpack(seg.packedAudio->getData(), seg.packedAudio->getSize(), samples);
+    else
+        loaded = SegmentStore::load(seg.audioKey, samples);
+    const int numFrames = samples.getNumFrames();
+    if (!loaded || samples.getNumChannels() != seg.numChannels || numFrames < seg.audioOffsetFrames + seg.numFrames)
+        return seg;
+    seg.audio = std::make_shared<const SegmentAudio>(std::move(samples));
+
+    // Keep it paged in, for every take that views the same audio, unless removed or replaced meanwhile
+    juce::ScopedLock l(segmentLock_);
+    for (auto& stored : segments_)
+        if (stored.audio == nullptr && stored.audioKey == seg.audioKey && stored.packedAudio == seg.packedAudio
+            && stored.audioOffsetFrames + stored.numFrames <= numFrames)
+            stored.audio = seg.audio;
+    return seg;
+}
+
+int AceForgeSunoAudioProcessor::findSegmentIndex(int id) const
+{
+    juce::ScopedLock l(segmentLock_);
+    for (size_t i = 0; i < segments_.size(); ++i)
+        if (segments_[i].id == id)
+            return static_cast<int>(i);
+    return -1;
+}
+
 double AceForgeSunoAudioProcessor::getSegmentDurationSeconds(int index) const
 {
     auto seg = getSegment(index);
-    const int numCh = 2;
-    const int totalFrames = static_cast<int>(seg.buffer.size()) / numCh;
+    const int totalFrames = seg.numFrames;
     if (totalFrames <= 0 || seg.sampleRate <= 0.0)
         return 0.0;
     int end = seg.trimEndSamples > 0 ? seg.trimEndSamples : totalFrames;
@@ -105,9 +319,51 @@ void AceForgeSunoAudioProcessor::setSegmentTrim(int index, int startSamples, int
     if (index < 0 || index >= static_cast<int>(segments_.size()))
         return;
     auto& seg = segments_[static_cast<size_t>(index)];
-    const int totalFrames = static_cast<int>(seg.buffer.size()) / 2;
+    const int totalFrames = seg.numFrames;
     seg.trimStartSamples = juce::jlimit(0, totalFrames, startSamples);
     seg.trimEndSamples = (endSamples <= 0) ? 0 : juce::jlimit(0, totalFrames, endSamples);
+    seg.features.clear(); // describe the old range
+}
+
+void AceForgeSunoAudioProcessor::requestSegmentFeatures(int index)
+{
+    int id = 0;
+    {
+        juce::ScopedLock l(segmentLock_);
+        if (index < 0 || index >= static_cast<int>(segments_.size())
+            || !segments_[static_cast<size_t>(index)].features.empty())
+            return;
+        id = segments_[static_cast<size_t>(index)].id;
+    }
+    // The decode job pages the audio in if needed and reads the trimmed range in place. The list
+    // may change meanwhile, so the segment is found again by id.
+    addDecodeJob([this, id]
+    {
+        const RecordedSegment seg = getSegmentWithAudio(findSegmentIndex(id));
+        if (seg.audio == nullptr || seg.id != id)
+            return;
+        const int end = seg.trimEndSamples > 0 ? seg.trimEndSamples : seg.numFrames;
+        const int frames = std::min(std::max(0, end - seg.trimStartSamples),
+                                    static_cast<int>(AudioFeatureExtractor::kMaxAnalysisSeconds * seg.sampleRate));
+        std::vector<float> features = AudioFeatureExtractor::extract(
+            seg.getChannels(seg.trimStartSamples).data(), seg.getNumMainChannels(), frames, seg.sampleRate);
+        juce::ScopedLock l(segmentLock_);
+        const int stored = findSegmentIndex(id);
+        if (stored < 0)
+            return;
+        auto& target = segments_[static_cast<size_t>(stored)];
+        // Only if the segment was not trimmed meanwhile
+        if (target.trimStartSamples == seg.trimStartSamples && target.trimEndSamples == seg.trimEndSamples)
+            target.features = std::move(features);
+    });
+}
+
+std::vector<float> AceForgeSunoAudioProcessor::getSegmentFeatures(int index) const
+{
+    juce::ScopedLock l(segmentLock_);
+    if (index < 0 || index >= static_cast<int>(segments_.size()))
+        return {};
+    return segments_[static_cast<size_t>(index)].features;
 }
 
 void AceForgeSunoAudioProcessor::removeSegment(int index)
@@ -123,6 +379,73 @@ void AceForgeSunoAudioProcessor::removeSegment(int index)
         selectedSegmentIndex_.store(sel - 1);
 }
 
+std::shared_ptr<const PeakPyramid> AceForgeSunoAudioProcessor::getSegmentPeaks(int index)
+{
+    int id = 0;
+    {
+        juce::ScopedLock l(segmentLock_);
+        if (index < 0 || index >= static_cast<int>(segments_.size()))
+            return nullptr;
+        auto& seg = segments_[static_cast<size_t>(index)];
+        if (seg.peaks != nullptr || seg.peaksRequested)
+            return seg.peaks;
+        seg.peaksRequested = true;
+        id = seg.id;
+    }
+    // Restored segments have no capture-time peaks: page the audio in and build them once
+    addDecodeJob([this, id]
+    {
+        const RecordedSegment seg = getSegmentWithAudio(findSegmentIndex(id));
+        if (seg.audio == nullptr || seg.id != id)
+            return;
+        auto peaks = std::make_shared<PeakPyramid>();
+        peaks->append(seg.getChannels().data(), seg.getNumMainChannels(), seg.numFrames);
+        peaks->finish();
+        juce::ScopedLock l(segmentLock_);
+        const int stored = findSegmentIndex(id);
+        if (stored >= 0)
+            segments_[static_cast<size_t>(stored)].peaks = std::move(peaks);
+    });
+    return nullptr;
+}
+
+bool AceForgeSunoAudioProcessor::getSegmentSlices(int index, std::vector<SegmentSlicer::Region>& slices)
+{
+    int id = 0;
+    {
+        juce::ScopedLock l(segmentLock_);
+        if (index < 0 || index >= static_cast<int>(segments_.size()))
+            return false;
+        auto& seg = segments_[static_cast<size_t>(index)];
+        if (seg.slicesReady)
+            slices = seg.slices;
+        if (seg.slicesReady || seg.slicesRequested)
+            return seg.slicesReady;
+        seg.slicesRequested = true;
+        id = seg.id;
+    }
+    // One pass over the untrimmed segment; the host tempo stands in when no PPQ was captured
+    addDecodeJob([this, id, fallbackBpm = hostBpm_.load()]
+    {
+        const RecordedSegment seg = getSegmentWithAudio(findSegmentIndex(id));
+        if (seg.id != id)
+            return;
+        std::vector<SegmentSlicer::Region> proposed;
+        if (seg.audio != nullptr)
+            proposed = SegmentSlicer::propose(seg.getChannels().data(), seg.getNumMainChannels(), seg.numFrames, seg.sampleRate,
+                                              seg.position, fallbackBpm);
+        juce::ScopedLock l(segmentLock_);
+        const int stored = findSegmentIndex(id);
+        if (stored >= 0)
+        {
+            auto& target = segments_[static_cast<size_t>(stored)];
+            target.slices = std::move(proposed);
+            target.slicesReady = true;
+        }
+    });
+    return false;
+}
+
 bool AceForgeSunoAudioProcessor::hasRecordedAudio() const
 {
     return hasSelectedSegment();
@@ -137,24 +460,22 @@ bool AceForgeSunoAudioProcessor::hasSelectedSegment() const
     if (idx >= static_cast<int>(segments_.size()))
         return false;
     const auto& seg = segments_[static_cast<size_t>(idx)];
-    const int totalFrames = static_cast<int>(seg.buffer.size()) / 2;
-    if (totalFrames < 44100) // at least ~1 sec
+    if (seg.isSilent())
+        return false;
+    const int minFrames = static_cast<int>(kMinSegmentSeconds * seg.sampleRate);
+    const int totalFrames = seg.numFrames;
+    if (totalFrames < minFrames)
         return false;
     int end = seg.trimEndSamples > 0 ? seg.trimEndSamples : totalFrames;
-    return (end - seg.trimStartSamples) >= 44100;
+    return (end - seg.trimStartSamples) >= minFrames;
 }
 
-std::vector<uint8_t> AceForgeSunoAudioProcessor::encodeSegmentAsWav(int segmentIndex) const
+// The upload is stereo: other main input layouts are downmixed here, off the audio thread, one
+// vectorised multiply-add per channel and side; the sidechain is not uploaded
+std::vector<uint8_t> AceForgeSunoAudioProcessor::encodeSegmentAsWav(const RecordedSegment& seg)
 {
-    RecordedSegment seg;
-    {
-        juce::ScopedLock l(segmentLock_);
-        if (segmentIndex < 0 || segmentIndex >= static_cast<int>(segments_.size()))
-            return {};
-        seg = segments_[static_cast<size_t>(segmentIndex)];
-    }
     const int numCh = 2;
-    const int totalFrames = static_cast<int>(seg.buffer.size()) / numCh;
+    const int totalFrames = seg.audio != nullptr ? seg.numFrames : 0;
     if (totalFrames <= 0)
         return {};
     int start = seg.trimStartSamples;
@@ -164,27 +485,138 @@ std::vector<uint8_t> AceForgeSunoAudioProcessor::encodeSegmentAsWav(int segmentI
         return {};
 
     juce::AudioBuffer<float> buf(numCh, numFrames);
-    for (int c = 0; c < numCh; ++c)
-        for (int i = 0; i < numFrames; ++i)
-            buf.setSample(c, i, seg.buffer[static_cast<size_t>(start + i) * 2u + static_cast<size_t>(c)]);
+    const int mainChannels = seg.getNumMainChannels();
+    const auto gains = stereoDownmixGains(seg.getMainChannelSet(), mainChannels);
+    SampleKernels::mixMatrix(seg.getChannels(start).data(), mainChannels, buf.getArrayOfWritePointers(), numCh,
+                             gains.data(), numFrames);
 
+    const auto dataBytes = static_cast<size_t>(numFrames) * numCh * (kUploadBitsPerSample / 8);
     juce::MemoryBlock block;
-    juce::WavAudioFormat wavFormat;
-    auto options = juce::AudioFormatWriterOptions{}
-                      .withSampleRate(seg.sampleRate)
-                      .withNumChannels(numCh)
-                      .withBitsPerSample(24);
-    std::unique_ptr<juce::OutputStream> mos = std::make_unique<juce::MemoryOutputStream>(block, true);
-    if (auto writer = wavFormat.createWriterFor(mos, options))
     {
-        writer->writeFromAudioSampleBuffer(buf, 0, numFrames);
-        writer->flush();
-        size_t sz = block.getSize();
-        if (sz > 0 && block.getData() != nullptr)
-            return std::vector<uint8_t>(static_cast<const uint8_t*>(block.getData()),
-                                        static_cast<const uint8_t*>(block.getData()) + sz);
+        juce::MemoryOutputStream header(block, false);
+        writeWavHeader(header, numCh, seg.sampleRate, kUploadBitsPerSample, static_cast<juce::uint32>(dataBytes));
+    }
+    std::vector<uint8_t> wav(block.getSize() + dataBytes);
+    std::memcpy(wav.data(), block.getData(), block.getSize());
+    SampleKernels::Dither dither;
+    SampleKernels::toPcm(buf.getArrayOfReadPointers(), numCh, numFrames, kUploadBitsPerSample,
+                         wav.data() + block.getSize(), dither);
+    return wav;
+}
+
+// Upload cache key: hash of exactly what encodeSegmentAsWav() reads (trimmed main rows, downmix
+// matrix, rate, output format), so the sidechain or a layout with the same mix never changes it
+juce::String AceForgeSunoAudioProcessor::segmentUploadKey(const RecordedSegment& seg)
+{
+    const int numCh = 2;
+    const int totalFrames = seg.audio != nullptr ? seg.numFrames : 0;
+    const int start = seg.trimStartSamples;
+    const int end = seg.trimEndSamples > 0 ? seg.trimEndSamples : totalFrames;
+    const int numFrames = std::max(0, end - start);
+    if (numFrames <= 0 || start < 0 || end > totalFrames)
+        return {};
+
+    ContentHash hash;
+    hash.updateValue(seg.sampleRate);
+    hash.updateValue(numCh);
+    hash.updateValue(kUploadBitsPerSample);
+    const int mainChannels = seg.getNumMainChannels();
+    hash.updateValue(mainChannels);
+    const auto gains = stereoDownmixGains(seg.getMainChannelSet(), mainChannels);
+    hash.update(gains.data(), gains.size() * sizeof(float));
+    const auto channels = seg.getChannels(start);
+    for (int c = 0; c < mainChannels; ++c)
+        hash.update(channels[static_cast<size_t>(c)], static_cast<size_t>(numFrames) * sizeof(float));
+    return "wav" + juce::String(kUploadBitsPerSample) + "-" + juce::String(hash.hexDigest());
+}
+
+// Encode + upload the job's segment, or reuse the fileUrl of an earlier upload of the same audio.
+// Only reading the segment needs the processor; encoding and the upload run outside its lifetime.
+// On failure sets state/status and returns an empty string.
+std::string AceForgeSunoAudioProcessor::uploadSegmentForJob(const NetworkJob& job, suno::SunoClient& client,
+                                                            const std::string& fileName, juce::String& uploadKey)
+{
+    // Found by id: the list may have changed since the job was submitted
+    RecordedSegment seg;
+    int id = 0;
+    const bool alive = job.withProcessor([&](auto& self)
+    {
+        id = self.jobSegmentId_;
+        seg = self.getSegmentWithAudio(self.findSegmentIndex(id));
+    });
+    if (!alive)
+        return {};
+    if (seg.id != id)
+    {
+        failJob(job, "The selected segment was removed before it could be uploaded");
+        return {};
+    }
+    if (seg.audio == nullptr)
+    {
+        failJob(job, "Audio of the selected segment could not be loaded (" + SegmentStore::getDirectory().getFullPathName() + ")");
+        return {};
+    }
+    uploadKey = segmentUploadKey(seg);
+    const juce::String cachedUrl = job.network->getUploadCache().lookup(uploadKey);
+    if (cachedUrl.isNotEmpty())
+    {
+        job.withProcessor([](auto& self) { self.reportJobProgress("Reusing previous upload of this segment…"); });
+        return cachedUrl.toStdString();
+    }
+
+    std::vector<uint8_t> wavBytes = encodeSegmentAsWav(seg);
+    if (wavBytes.empty())
+    {
+        failJob(job, "Failed to encode selected segment as WAV");
+        return {};
+    }
+
+    if (!job.withProcessor([](auto& self) { self.reportJobProgress("Uploading…"); }))
+        return {};
+    std::string uploadUrl = client.uploadAudio(wavBytes, fileName);
+    if (uploadUrl.empty())
+    {
+        failJob(job, juce::String(client.lastError()));
+        return {};
     }
-    return {};
+    job.network->getUploadCache().store(uploadKey, juce::String(uploadUrl));
+    return uploadUrl;
+}
+
+// Library metadata for the current job; file, duration and format are filled in when the result is saved
+LibraryEntry AceForgeSunoAudioProcessor::makeJobLibraryEntry(const suno::TaskStatus& status) const
+{
+    LibraryEntry e;
+    e.prompt = jobPrompt_;
+    e.style = jobStyle_;
+    e.title = jobTitle_;
+    e.model = suno::modelToString(modelFromIndex(jobModelIndex_));
+    e.taskId = juce::String(status.taskId);
+    e.tags = juce::String(status.tags);
+    e.mode = jobIsCover_ ? "cover" : (jobIsAddVocals_ ? "add-vocals" : "generate");
+    e.sourceSegment = (jobIsCover_ || jobIsAddVocals_) ? findSegmentIndex(jobSegmentId_) : -1;
+    e.hostBpm = jobHostBpm_;
+    if (jobIsCover_ || jobIsAddVocals_)
+        e.sourcePosition = jobSourcePosition_;
+    return e;
+}
+
+suno::GenerateParams AceForgeSunoAudioProcessor::makeJobGenerateParams() const
+{
+    suno::GenerateParams p;
+    p.prompt = jobPrompt_.toStdString();
+    p.style = jobStyle_.toStdString();
+    p.title = jobTitle_.toStdString();
+    p.customMode = jobCustomMode_;
+    p.instrumental = jobInstrumental_;
+    p.model = modelFromIndex(jobModelIndex_);
+    return p;
+}
+
+// Copied when a network job is queued; the job may outlive this instance
+AceForgeSunoAudioProcessor::NetworkJob AceForgeSunoAudioProcessor::makeNetworkJob()
+{
+    return { lifetime_, this, services_->getNetwork(), client_->getApiKey() };
 }
 
 void AceForgeSunoAudioProcessor::startGenerate(const juce::String& prompt, const juce::String& style, const juce::String& title,
@@ -204,9 +636,9 @@ void AceForgeSunoAudioProcessor::startGenerate(const juce::String& prompt, const
     jobModelIndex_ = modelIndex;
     jobIsCover_ = false;
     jobIsAddVocals_ = false;
+    jobHostBpm_ = hostBpm_.load();
     triggerAsyncUpdate();
-    std::thread t(&AceForgeSunoAudioProcessor::runGenerateThread, this);
-    t.detach();
+    services_->addJob(this, [job = makeNetworkJob()] { runGenerateJob(job); });
 }
 
 void AceForgeSunoAudioProcessor::startUploadCover(const juce::String& prompt, const juce::String& style, const juce::String& title,
@@ -236,10 +668,14 @@ void AceForgeSunoAudioProcessor::startUploadCover(const juce::String& prompt, co
     jobModelIndex_ = modelIndex;
     jobIsCover_ = true;
     jobIsAddVocals_ = false;
-    jobSegmentIndex_ = segIdx;
+    jobHostBpm_ = hostBpm_.load();
+    {
+        const RecordedSegment seg = getSegment(segIdx);
+        jobSegmentId_ = seg.id;
+        jobSourcePosition_ = seg.position.shifted(seg.trimStartSamples, seg.sampleRate);
+    }
     triggerAsyncUpdate();
-    std::thread t(&AceForgeSunoAudioProcessor::runUploadCoverThread, this);
-    t.detach();
+    services_->addJob(this, [job = makeNetworkJob()] { runUploadCoverJob(job); });
 }
 
 void AceForgeSunoAudioProcessor::startAddVocals(const juce::String& prompt, const juce::String& style, const juce::String& title)
@@ -265,335 +701,192 @@ void AceForgeSunoAudioProcessor::startAddVocals(const juce::String& prompt, cons
     jobTitle_ = title.isEmpty() ? "aceforge_suno_vocals" : title;
     jobIsCover_ = false;
     jobIsAddVocals_ = true;
-    jobSegmentIndex_ = segIdx;
+    jobHostBpm_ = hostBpm_.load();
+    {
+        const RecordedSegment seg = getSegment(segIdx);
+        jobSegmentId_ = seg.id;
+        jobSourcePosition_ = seg.position.shifted(seg.trimStartSamples, seg.sampleRate);
+    }
     triggerAsyncUpdate();
-    std::thread t(&AceForgeSunoAudioProcessor::runAddVocalsThread, this);
-    t.detach();
+    services_->addJob(this, [job = makeNetworkJob()] { runAddVocalsJob(job); });
 }
 
-void AceForgeSunoAudioProcessor::runGenerateThread()
+void AceForgeSunoAudioProcessor::failJob(const juce::String& message)
 {
-    if (!client_ || !client_->hasApiKey())
-    {
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = "No API key";
-        statusText_ = lastError_;
-        triggerAsyncUpdate();
-        return;
-    }
-    if (!client_->checkCredits())
+    state_.store(State::Failed);
     {
-        connected_.store(false);
-        state_.store(State::Failed);
         juce::ScopedLock l(statusLock_);
-        lastError_ = "API key invalid or no credits: " + juce::String(client_->lastError());
+        lastError_ = message;
         statusText_ = lastError_;
-        triggerAsyncUpdate();
-        return;
     }
-    connected_.store(true);
+    triggerAsyncUpdate();
+}
 
-    suno::GenerateParams p;
-    p.prompt = jobPrompt_.toStdString();
-    p.style = jobStyle_.toStdString();
-    p.title = jobTitle_.toStdString();
-    p.customMode = jobCustomMode_;
-    p.instrumental = jobInstrumental_;
-    p.model = modelFromIndex(jobModelIndex_);
+void AceForgeSunoAudioProcessor::failJob(const NetworkJob& job, const juce::String& message)
+{
+    job.withProcessor([&](auto& self) { self.failJob(message); });
+}
 
-    std::string taskId = client_->startGenerate(p);
-    if (taskId.empty())
-    {
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = juce::String(client_->lastError());
-        statusText_ = lastError_;
-        triggerAsyncUpdate();
-        return;
-    }
+void AceForgeSunoAudioProcessor::addDecodeJob(std::function<void()> job)
+{
+    services_->addDecodeJob(this, [lifetime = lifetime_, job = std::move(job)] { lifetime->run(job); });
+}
 
+void AceForgeSunoAudioProcessor::reportJobProgress(const juce::String& text)
+{
     state_.store(State::Running);
     {
         juce::ScopedLock l(statusLock_);
-        statusText_ = "Generating…";
+        statusText_ = text;
     }
     triggerAsyncUpdate();
+}
 
-    while (true)
+// Credits check shared with the other instances (SharedServices caches it per key)
+bool AceForgeSunoAudioProcessor::checkJobCredits(const NetworkJob& job)
+{
+    if (job.apiKey.empty())
     {
-        suno::TaskStatus st = client_->getTaskStatus(taskId);
-        juce::String statusStr(st.status.c_str());
-        if (statusStr.equalsIgnoreCase("SUCCESS") || statusStr.equalsIgnoreCase("success"))
+        failJob(job, "No API key");
+        return false;
+    }
+    std::string error;
+    const bool ok = job.network->checkCredits(job.apiKey, error);
+    const bool alive = job.withProcessor([&](auto& self)
+    {
+        if (ok)
         {
-            if (st.audioUrls.empty())
-            {
-                state_.store(State::Failed);
-                juce::ScopedLock l(statusLock_);
-                lastError_ = "No audio URL in result";
-                statusText_ = lastError_;
-                triggerAsyncUpdate();
-                return;
-            }
-            std::vector<uint8_t> wavBytes = client_->fetchAudio(st.audioUrls[0]);
-            if (wavBytes.empty())
-            {
-                state_.store(State::Failed);
-                juce::ScopedLock l(statusLock_);
-                lastError_ = juce::String(client_->lastError());
-                triggerAsyncUpdate();
-                return;
-            }
-            {
-                juce::ScopedLock l(pendingWavLock_);
-                pendingWavBytes_ = std::move(wavBytes);
-                pendingPrompt_ = jobPrompt_;
-            }
-            triggerAsyncUpdate();
+            self.connection_.store(Connection::Connected);
             return;
         }
-        if (statusStr.isNotEmpty() && (statusStr.contains("fail") || statusStr.contains("error")))
         {
-            state_.store(State::Failed);
-            juce::ScopedLock l(statusLock_);
-            lastError_ = juce::String(st.errorMessage.empty() ? st.status.c_str() : st.errorMessage.c_str());
-            statusText_ = lastError_;
-            triggerAsyncUpdate();
-            return;
+            juce::ScopedLock l(self.statusLock_);
+            self.connectionError_ = juce::String(error);
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(800));
-    }
+        self.connection_.store(Connection::Failed);
+        self.failJob("API key invalid or no credits: " + juce::String(error));
+    });
+    return alive && ok;
 }
 
-void AceForgeSunoAudioProcessor::runUploadCoverThread()
+// Hands the submitted task to the shared poller; the job thread is free again until it finishes.
+// Registered inside the lifetime, so the destructor's cancelAll() always sees it.
+void AceForgeSunoAudioProcessor::watchJobTask(const NetworkJob& job, const std::string& taskId, bool isTest)
 {
-    if (!client_ || !client_->hasApiKey())
+    job.withProcessor([&](auto& self)
     {
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = "No API key";
-        statusText_ = lastError_;
-        triggerAsyncUpdate();
-        return;
-    }
-    if (!client_->checkCredits())
+        self.services_->watchTask(&self, job.apiKey, taskId,
+                                  [job, isTest](const suno::TaskStatus& st) { finishJobTask(job, st, isTest); });
+    });
+}
+
+// Runs on the shared job pool once the task succeeded or failed: downloads the result and queues
+// it for handleAsyncUpdate()
+void AceForgeSunoAudioProcessor::finishJobTask(const NetworkJob& job, const suno::TaskStatus& st, bool isTest)
+{
+    if (!SharedServices::isTaskSucceeded(st))
+        return failJob(job, juce::String(st.errorMessage.empty() ? st.status.c_str() : st.errorMessage.c_str()));
+    if (st.audioUrls.empty())
+        return failJob(job, isTest ? "No audio URL in test result" : "No audio URL in result");
+    suno::SunoClient client(job.apiKey);
+    std::vector<uint8_t> audioBytes = client.fetchAudio(st.audioUrls[0]);
+    if (audioBytes.empty())
+        return failJob(job, juce::String(client.lastError()));
+    job.withProcessor([&](auto& self)
     {
-        connected_.store(false);
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = "API key invalid or no credits";
-        statusText_ = lastError_;
-        triggerAsyncUpdate();
+        {
+            juce::ScopedLock l(self.pendingAudioLock_);
+            self.pendingAudioBytes_ = std::move(audioBytes);
+            if (isTest)
+            {
+                self.pendingLibraryEntry_ = {};
+                self.pendingLibraryEntry_.prompt = "API test";
+            }
+            else
+            {
+                self.pendingLibraryEntry_ = self.makeJobLibraryEntry(st);
+            }
+            self.pendingIsTest_.store(isTest);
+        }
+        self.triggerAsyncUpdate();
+    });
+}
+
+void AceForgeSunoAudioProcessor::runGenerateJob(const NetworkJob& job)
+{
+    if (!checkJobCredits(job))
         return;
-    }
-    connected_.store(true);
 
-    std::vector<uint8_t> wavBytes = encodeSegmentAsWav(jobSegmentIndex_);
-    if (wavBytes.empty())
-    {
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = "Failed to encode selected segment as WAV";
-        statusText_ = lastError_;
-        triggerAsyncUpdate();
+    suno::GenerateParams p;
+    if (!job.withProcessor([&](auto& self) { p = self.makeJobGenerateParams(); }))
         return;
-    }
 
-    state_.store(State::Running);
-    { juce::ScopedLock l(statusLock_); statusText_ = "Uploading…"; }
-    triggerAsyncUpdate();
+    suno::SunoClient client(job.apiKey);
+    std::string taskId = client.startGenerate(p);
+    if (taskId.empty())
+        return failJob(job, juce::String(client.lastError()));
+
+    job.withProcessor([](auto& self) { self.reportJobProgress("Generating…"); });
+    watchJobTask(job, taskId, false);
+}
 
-    std::string uploadUrl = client_->uploadAudio(wavBytes, "recorded.wav");
+void AceForgeSunoAudioProcessor::runUploadCoverJob(const NetworkJob& job)
+{
+    if (!checkJobCredits(job))
+        return;
+
+    suno::SunoClient client(job.apiKey);
+    juce::String uploadKey;
+    std::string uploadUrl = uploadSegmentForJob(job, client, "recorded.wav", uploadKey);
     if (uploadUrl.empty())
-    {
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = juce::String(client_->lastError());
-        statusText_ = lastError_;
-        triggerAsyncUpdate();
         return;
-    }
 
     suno::GenerateParams p;
-    p.prompt = jobPrompt_.toStdString();
-    p.style = jobStyle_.toStdString();
-    p.title = jobTitle_.toStdString();
-    p.customMode = jobCustomMode_;
-    p.instrumental = jobInstrumental_;
-    p.model = modelFromIndex(jobModelIndex_);
+    if (!job.withProcessor([&](auto& self) { p = self.makeJobGenerateParams(); }))
+        return;
 
-    std::string taskId = client_->startUploadCover(uploadUrl, p);
+    std::string taskId = client.startUploadCover(uploadUrl, p);
     if (taskId.empty())
     {
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = juce::String(client_->lastError());
-        statusText_ = lastError_;
-        triggerAsyncUpdate();
-        return;
+        job.network->getUploadCache().invalidate(uploadKey);
+        return failJob(job, juce::String(client.lastError()));
     }
 
-    { juce::ScopedLock l(statusLock_); statusText_ = "Generating cover…"; }
-    triggerAsyncUpdate();
-
-    while (true)
-    {
-        suno::TaskStatus st = client_->getTaskStatus(taskId);
-        juce::String statusStr(st.status.c_str());
-        if (statusStr.equalsIgnoreCase("SUCCESS") || statusStr.equalsIgnoreCase("success"))
-        {
-            if (st.audioUrls.empty())
-            {
-                state_.store(State::Failed);
-                juce::ScopedLock l(statusLock_);
-                lastError_ = "No audio URL in result";
-                statusText_ = lastError_;
-                triggerAsyncUpdate();
-                return;
-            }
-            std::vector<uint8_t> audioBytes = client_->fetchAudio(st.audioUrls[0]);
-            if (audioBytes.empty())
-            {
-                state_.store(State::Failed);
-                juce::ScopedLock l(statusLock_);
-                lastError_ = juce::String(client_->lastError());
-                triggerAsyncUpdate();
-                return;
-            }
-            {
-                juce::ScopedLock l(pendingWavLock_);
-                pendingWavBytes_ = std::move(audioBytes);
-                pendingPrompt_ = jobPrompt_;
-            }
-            triggerAsyncUpdate();
-            return;
-        }
-        if (statusStr.isNotEmpty() && (statusStr.contains("fail") || statusStr.contains("error")))
-        {
-            state_.store(State::Failed);
-            juce::ScopedLock l(statusLock_);
-            lastError_ = juce::String(st.errorMessage.empty() ? st.status.c_str() : st.errorMessage.c_str());
-            statusText_ = lastError_;
-            triggerAsyncUpdate();
-            return;
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(800));
-    }
+    job.withProcessor([](auto& self) { self.reportJobProgress("Generating cover…"); });
+    watchJobTask(job, taskId, false);
 }
 
-void AceForgeSunoAudioProcessor::runAddVocalsThread()
+void AceForgeSunoAudioProcessor::runAddVocalsJob(const NetworkJob& job)
 {
-    if (!client_ || !client_->hasApiKey())
-    {
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = "No API key";
-        statusText_ = lastError_;
-        triggerAsyncUpdate();
-        return;
-    }
-    if (!client_->checkCredits())
-    {
-        connected_.store(false);
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = "API key invalid or no credits";
-        statusText_ = lastError_;
-        triggerAsyncUpdate();
-        return;
-    }
-    connected_.store(true);
-
-    std::vector<uint8_t> wavBytes = encodeSegmentAsWav(jobSegmentIndex_);
-    if (wavBytes.empty())
-    {
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = "Failed to encode selected segment as WAV";
-        statusText_ = lastError_;
-        triggerAsyncUpdate();
+    if (!checkJobCredits(job))
         return;
-    }
 
-    state_.store(State::Running);
-    { juce::ScopedLock l(statusLock_); statusText_ = "Uploading…"; }
-    triggerAsyncUpdate();
-
-    std::string uploadUrl = client_->uploadAudio(wavBytes, "instrumental.wav");
+    suno::SunoClient client(job.apiKey);
+    juce::String uploadKey;
+    std::string uploadUrl = uploadSegmentForJob(job, client, "instrumental.wav", uploadKey);
     if (uploadUrl.empty())
-    {
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = juce::String(client_->lastError());
-        statusText_ = lastError_;
-        triggerAsyncUpdate();
         return;
-    }
 
     suno::AddVocalsParams p;
     p.uploadUrl = uploadUrl;
-    p.prompt = jobPrompt_.toStdString();
-    p.style = jobStyle_.toStdString();
-    p.title = jobTitle_.toStdString();
-    p.model = modelFromIndex(jobModelIndex_);
+    if (!job.withProcessor([&](auto& self)
+        {
+            p.prompt = self.jobPrompt_.toStdString();
+            p.style = self.jobStyle_.toStdString();
+            p.title = self.jobTitle_.toStdString();
+            p.model = modelFromIndex(self.jobModelIndex_);
+        }))
+        return;
 
-    std::string taskId = client_->startAddVocals(p);
+    std::string taskId = client.startAddVocals(p);
     if (taskId.empty())
     {
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = juce::String(client_->lastError());
-        statusText_ = lastError_;
-        triggerAsyncUpdate();
-        return;
+        job.network->getUploadCache().invalidate(uploadKey);
+        return failJob(job, juce::String(client.lastError()));
     }
 
-    { juce::ScopedLock l(statusLock_); statusText_ = "Adding vocals…"; }
-    triggerAsyncUpdate();
-
-    while (true)
-    {
-        suno::TaskStatus st = client_->getTaskStatus(taskId);
-        juce::String statusStr(st.status.c_str());
-        if (statusStr.equalsIgnoreCase("SUCCESS") || statusStr.equalsIgnoreCase("success"))
-        {
-            if (st.audioUrls.empty())
-            {
-                state_.store(State::Failed);
-                juce::ScopedLock l(statusLock_);
-                lastError_ = "No audio URL in result";
-                statusText_ = lastError_;
-                triggerAsyncUpdate();
-                return;
-            }
-            std::vector<uint8_t> audioBytes = client_->fetchAudio(st.audioUrls[0]);
-            if (audioBytes.empty())
-            {
-                state_.store(State::Failed);
-                juce::ScopedLock l(statusLock_);
-                lastError_ = juce::String(client_->lastError());
-                triggerAsyncUpdate();
-                return;
-            }
-            {
-                juce::ScopedLock l(pendingWavLock_);
-                pendingWavBytes_ = std::move(audioBytes);
-                pendingPrompt_ = jobPrompt_;
-            }
-            triggerAsyncUpdate();
-            return;
-        }
-        if (statusStr.isNotEmpty() && (statusStr.contains("fail") || statusStr.contains("error")))
-        {
-            state_.store(State::Failed);
-            juce::ScopedLock l(statusLock_);
-            lastError_ = juce::String(st.errorMessage.empty() ? st.status.c_str() : st.errorMessage.c_str());
-            statusText_ = lastError_;
-            triggerAsyncUpdate();
-            return;
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(800));
-    }
+    job.withProcessor([](auto& self) { self.reportJobProgress("Adding vocals…"); });
+    watchJobTask(job, taskId, false);
 }
 
 void AceForgeSunoAudioProcessor::startTestApi()
@@ -604,36 +897,16 @@ void AceForgeSunoAudioProcessor::startTestApi()
     if (!state_.compare_exchange_strong(expected, State::Submitting))
         return;
     triggerAsyncUpdate();
-    std::thread t(&AceForgeSunoAudioProcessor::runTestApiThread, this);
-    t.detach();
+    services_->addJob(this, [job = makeNetworkJob()] { runTestApiJob(job); });
 }
 
-void AceForgeSunoAudioProcessor::runTestApiThread()
+void AceForgeSunoAudioProcessor::runTestApiJob(const NetworkJob& job)
 {
-    if (!client_ || !client_->hasApiKey())
-    {
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = "No API key";
-        statusText_ = lastError_;
-        triggerAsyncUpdate();
+    if (!checkJobCredits(job))
         return;
-    }
-    if (!client_->checkCredits())
-    {
-        connected_.store(false);
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = "API key invalid or no credits: " + juce::String(client_->lastError());
-        statusText_ = lastError_;
-        triggerAsyncUpdate();
-        return;
-    }
-    connected_.store(true);
 
-    state_.store(State::Running);
-    { juce::ScopedLock l(statusLock_); statusText_ = "Testing API (minimal generate)…"; }
-    triggerAsyncUpdate();
+    if (!job.withProcessor([](auto& self) { self.reportJobProgress("Testing API (minimal generate)…"); }))
+        return;
 
     suno::GenerateParams p;
     p.prompt = "test";
@@ -643,99 +916,94 @@ void AceForgeSunoAudioProcessor::runTestApiThread()
     p.instrumental = true;
     p.model = suno::Model::V4_5ALL;
 
-    std::string taskId = client_->startGenerate(p);
+    suno::SunoClient client(job.apiKey);
+    std::string taskId = client.startGenerate(p);
     if (taskId.empty())
-    {
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = juce::String(client_->lastError());
-        statusText_ = lastError_;
-        triggerAsyncUpdate();
-        return;
-    }
-
-    while (true)
-    {
-        suno::TaskStatus st = client_->getTaskStatus(taskId);
-        juce::String statusStr(st.status.c_str());
-        if (statusStr.equalsIgnoreCase("SUCCESS") || statusStr.equalsIgnoreCase("success"))
-        {
-            if (st.audioUrls.empty())
-            {
-                state_.store(State::Failed);
-                juce::ScopedLock l(statusLock_);
-                lastError_ = "No audio URL in test result";
-                statusText_ = lastError_;
-                triggerAsyncUpdate();
-                return;
-            }
-            std::vector<uint8_t> wavBytes = client_->fetchAudio(st.audioUrls[0]);
-            if (wavBytes.empty())
-            {
-                state_.store(State::Failed);
-                juce::ScopedLock l(statusLock_);
-                lastError_ = juce::String(client_->lastError());
-                triggerAsyncUpdate();
-                return;
-            }
-            {
-                juce::ScopedLock l(pendingWavLock_);
-                pendingWavBytes_ = std::move(wavBytes);
-                pendingPrompt_ = "API test";
-                pendingIsTest_.store(true);
-            }
-            triggerAsyncUpdate();
-            return;
-        }
-        if (statusStr.isNotEmpty() && (statusStr.contains("fail") || statusStr.contains("error")))
-        {
-            state_.store(State::Failed);
-            juce::ScopedLock l(statusLock_);
-            lastError_ = juce::String(st.errorMessage.empty() ? st.status.c_str() : st.errorMessage.c_str());
-            statusText_ = lastError_;
-            triggerAsyncUpdate();
-            return;
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(800));
-    }
+        return failJob(job, juce::String(client.lastError()));
+    watchJobTask(job, taskId, true);
 }
 
-void AceForgeSunoAudioProcessor::pushSamplesToPlayback(const float* interleaved, int numFrames,
-                                                       int sourceChannels, double sourceSampleRate)
+void AceForgeSunoAudioProcessor::pushSamplesToPlayback(const float* const* channels, int numChannels, int numFrames,
+                                                       double sourceSampleRate)
 {
-    if (numFrames <= 0 || interleaved == nullptr)
+    if (numFrames <= 0 || numChannels <= 0)
         return;
     const double hostRate = sampleRate_.load(std::memory_order_relaxed);
     const double ratio = sourceSampleRate > 0.0 ? hostRate / sourceSampleRate : 1.0;
     const int outFrames = static_cast<int>(std::round(static_cast<double>(numFrames) * ratio));
-    if (outFrames <= 0 || outFrames > kPlaybackFifoFrames)
+    if (outFrames <= 0 || outFrames > static_cast<int>(kMaxPlaybackSeconds * hostRate))
         return;
 
-    const int writeIdx = nextWriteIndex_.load(std::memory_order_relaxed);
-    std::vector<float>& outBuf = pendingPlaybackBuffer_[writeIdx];
-    outBuf.resize(static_cast<size_t>(outFrames) * 2u);
-    float* out = outBuf.data();
-    for (int i = 0; i < outFrames; ++i)
+    reclaimFinishedPlayback(); // a block the audio thread just finished can be reused right away
+    std::unique_ptr<PlaybackBlock> block = services_->getPlaybackPool().acquire(static_cast<size_t>(outFrames) * 2u);
+    float* out = block->data();
+    const float* const stereo[2] = { channels[0], channels[numChannels > 1 ? 1 : 0] };
+    if (outFrames == numFrames)
+    {
+        SampleKernels::interleave(stereo, 2, numFrames, out);
+    }
+    else
     {
-        const double srcIdx = ratio > 0.0 ? (double)i / ratio : (double)i;
-        const int i0 = std::min(std::max(0, static_cast<int>(srcIdx)), numFrames - 1);
-        const int i1 = std::min(i0 + 1, numFrames - 1);
-        const float t = static_cast<float>(srcIdx - std::floor(srcIdx));
-        float l = 0.0f, r = 0.0f;
-        if (sourceChannels >= 1)
+        for (int i = 0; i < outFrames; ++i)
         {
-            l = interleaved[i0 * sourceChannels] * (1.0f - t) + interleaved[i1 * sourceChannels] * t;
-            r = sourceChannels >= 2
-                    ? interleaved[i0 * sourceChannels + 1] * (1.0f - t) + interleaved[i1 * sourceChannels + 1] * t
-                    : l;
+            const double srcIdx = ratio > 0.0 ? (double)i / ratio : (double)i;
+            const int i0 = std::min(std::max(0, static_cast<int>(srcIdx)), numFrames - 1);
+            const int i1 = std::min(i0 + 1, numFrames - 1);
+            const float t = static_cast<float>(srcIdx - std::floor(srcIdx));
+            out[i * 2] = stereo[0][i0] * (1.0f - t) + stereo[0][i1] * t;
+            out[i * 2 + 1] = stereo[1][i0] * (1.0f - t) + stereo[1][i1] * t;
         }
-        out[i * 2] = l;
-        out[i * 2 + 1] = r;
     }
-    pendingPlaybackFrames_.store(outFrames, std::memory_order_release);
-    pendingPlaybackBufferIndex_.store(writeIdx, std::memory_order_release);
-    pendingPlaybackReady_.store(true, std::memory_order_release);
-    nextWriteIndex_.store(1 - writeIdx, std::memory_order_release);
+    playbackBlocksOut_.fetch_add(1);
+    // A result that was never picked up (no processBlock since) is replaced
+    releasePlaybackBlock(pendingPlayback_.exchange(block.release(), std::memory_order_acq_rel));
+    startTimer(kPlaybackTimerId, kPlaybackReclaimIntervalMs);
+}
+
+// Audio thread: parks a block for reclaimFinishedPlayback(); never frees memory itself
+bool AceForgeSunoAudioProcessor::retirePlayback(PlaybackBlock* block)
+{
+    for (auto& slot : finishedPlayback_)
+    {
+        PlaybackBlock* expected = nullptr;
+        if (slot.compare_exchange_strong(expected, block, std::memory_order_acq_rel))
+            return true;
+    }
+    return false;
+}
+
+void AceForgeSunoAudioProcessor::reclaimFinishedPlayback()
+{
+    for (auto& slot : finishedPlayback_)
+        releasePlaybackBlock(slot.exchange(nullptr, std::memory_order_acq_rel));
+}
+
+void AceForgeSunoAudioProcessor::releasePlaybackBlock(PlaybackBlock* block)
+{
+    if (block == nullptr)
+        return;
+    services_->getPlaybackPool().release(std::unique_ptr<PlaybackBlock>(block));
+    playbackBlocksOut_.fetch_sub(1);
+}
+
+void AceForgeSunoAudioProcessor::timerCallback(int timerId)
+{
+    if (timerId == kSegmentMemoryTimerId)
+    {
+        refillCaptureBuffer();
+        compactIdleSegments();
+        enforceMemoryBudget();
+        reportLiveSegmentKeys();
+        services_->sweepSegmentFilesIfDue();
+        return;
+    }
+    reclaimFinishedPlayback();
+    if (playbackBlocksOut_.load() == 0)
+    {
+        stopTimer(kPlaybackTimerId);
+        if (playbackBlocksOut_.load() > 0) // published while stopping
+            startTimer(kPlaybackTimerId, kPlaybackReclaimIntervalMs);
+    }
 }
 
 void AceForgeSunoAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
@@ -743,13 +1011,13 @@ void AceForgeSunoAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer,
     juce::ignoreUnused(midiMessages);
     juce::ScopedNoDenormals noDenormals;
     const int numSamples = buffer.getNumSamples();
-    const int numCh = buffer.getNumChannels();
 
     // Host BPM and transport from playhead when available
     bool isPlaying = false;
+    juce::Optional<juce::AudioPlayHead::PositionInfo> pos;
     if (auto* playhead = getPlayHead())
     {
-        juce::Optional<juce::AudioPlayHead::PositionInfo> pos = playhead->getPosition();
+        pos = playhead->getPosition();
         if (pos)
         {
             if (pos->getBpm().hasValue())
@@ -763,171 +1031,709 @@ void AceForgeSunoAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer,
         juce::ScopedLock l(segmentLock_);
         if (isPlaying && !wasPlaying_)
         {
-            currentSegmentBuffer_.clear();
+            capturePeaks_.reset();
+            capturePosition_ = MusicalPosition::fromPlayhead(*pos); // isPlaying implies pos
+            numCaptureCuts_ = 0;
+            captureGate_.reset();
+            expectedPpq_ = -1.0;
+            expectedSamples_ = -1;
+            captureFormat_ = inputFormat_;
+            currentSegmentBuffer_.reset(captureFormat_.getNumChannels());
+            ++captureId_;
+            if (isNonRealtime()) // rendering offline: may allocate and block
+                offlineWriter_ = std::make_unique<SegmentStore::Writer>(captureFormat_.getNumChannels());
+            else if (!preRoll_.isFrozen()) // else still held for an earlier capture
+            {
+                preRoll_.freeze();
+                preRollCaptureId_ = captureId_;
+            }
             transportRecording_.store(true);
+            triggerAsyncUpdate(); // takePreRoll()
+        }
+        else if (!isPlaying && wasPlaying_ && offlineWriter_ != nullptr)
+        {
+            finishOfflineCapture();
+            transportRecording_.store(false);
         }
         else if (!isPlaying && wasPlaying_)
         {
-            const int minSamples = 2 * 44100; // ~1 sec stereo at 44.1k
-            if (static_cast<int>(currentSegmentBuffer_.size()) >= minSamples)
+            const auto minFrames = static_cast<juce::int64>(kMinSegmentSeconds * sampleRate_.load());
+            // Hand the capture over without copying; a swap also recycles the blocks committed earlier,
+            // so a free slot that still has them is preferred
+            if (currentSegmentBuffer_.getNumFrames() >= minFrames)
             {
-                RecordedSegment seg;
-                seg.buffer = currentSegmentBuffer_;
-                seg.sampleRate = sampleRate_.load();
-                seg.trimEndSamples = 0; // full length
-                segments_.push_back(std::move(seg));
-                selectedSegmentIndex_.store(static_cast<int>(segments_.size()) - 1);
+                StoppedCapture* slot = nullptr;
+                for (auto& stopped : stoppedCaptures_)
+                    if (stopped.capture.getNumFrames() == 0 && (slot == nullptr || stopped.capture.hasStorage()))
+                        slot = &stopped;
+                if (slot != nullptr)
+                {
+                    std::swap(slot->capture, currentSegmentBuffer_);
+                    slot->format = captureFormat_;
+                    std::swap(slot->peaks, capturePeaks_);
+                    slot->position = capturePosition_;
+                    slot->gate = captureGate_;
+                    std::copy_n(captureCuts_.begin(), numCaptureCuts_, slot->cuts.begin());
+                    slot->numCuts = numCaptureCuts_;
+                    slot->captureId = captureId_;
+                }
+                else
+                {
+                    lostCaptures_.fetch_add(1);
+                }
+                triggerAsyncUpdate(); // commitStoppedCapture()
             }
-            currentSegmentBuffer_.clear();
+            currentSegmentBuffer_.reset(captureFormat_.getNumChannels());
             transportRecording_.store(false);
         }
         wasPlaying_ = isPlaying;
 
-        if (isPlaying && numCh >= 2)
+        // Main input channels, then sidechain channels (null = silence: a bus narrower than the
+        // format, or the sidechain switched off)
+        const CaptureFormat& format = isPlaying ? captureFormat_ : inputFormat_;
+        const auto mainInput = getBusBuffer(buffer, true, 0);
+        std::array<const float*, kMaxCaptureChannels> channels{};
+        for (int c = 0; c < format.mainChannels; ++c)
+            channels[static_cast<size_t>(c)] = c < mainInput.getNumChannels() ? mainInput.getReadPointer(c) : nullptr;
+        if (format.sidechainChannels > 0 && getBusCount(true) > 1)
         {
-            const size_t start = currentSegmentBuffer_.size();
-            currentSegmentBuffer_.resize(start + static_cast<size_t>(numSamples) * 2u);
-            for (int i = 0; i < numSamples; ++i)
-            {
-                currentSegmentBuffer_[start + static_cast<size_t>(i) * 2u] = buffer.getSample(0, i);
-                currentSegmentBuffer_[start + static_cast<size_t>(i) * 2u + 1u] = buffer.getSample(1, i);
-            }
+            const auto sidechain = getBusBuffer(buffer, true, 1);
+            for (int c = 0; c < format.sidechainChannels && c < sidechain.getNumChannels(); ++c)
+                channels[static_cast<size_t>(format.mainChannels + c)] = sidechain.getReadPointer(c);
         }
-    }
+        const int numMonitored = std::min(format.mainChannels, mainInput.getNumChannels());   // peaks and gate
 
-    // Playback: same double-buffer / fifo pattern as AceForge
-    if (pendingPlaybackReady_.exchange(false, std::memory_order_acq_rel))
-    {
-        const int N = pendingPlaybackFrames_.load(std::memory_order_acquire);
-        const int bufIdx = pendingPlaybackBufferIndex_.load(std::memory_order_acquire);
-        const std::vector<float>& srcBuf = pendingPlaybackBuffer_[bufIdx];
-        if (N > 0 && N <= kPlaybackFifoFrames && srcBuf.size() >= static_cast<size_t>(N) * 2u)
+        if (!isPlaying)
         {
-            playbackFifo_.reset();
-            int start1, block1, start2, block2;
-            playbackFifo_.prepareToWrite(N, start1, block1, start2, block2);
-            const float* src = srcBuf.data();
-            auto copyBlock = [&](int fifoStart, int count, int srcOffset)
+            preRoll_.write(channels.data(), numSamples);
+        }
+        else if (numMonitored > 0)
+        {
+            const auto frame = offlineWriter_ != nullptr ? offlineWriter_->getNumFrames()
+                                                         : currentSegmentBuffer_.getNumFrames();
+            if (isLoopWrap(*pos, numSamples) && frame > 0 && numCaptureCuts_ < kMaxLoopCuts && offlineWriter_ == nullptr)
+            {
+                captureCuts_[static_cast<size_t>(numCaptureCuts_++)] = { frame, MusicalPosition::fromPlayhead(*pos), captureGate_ };
+                captureGate_.reset();
+            }
+            if (auto bpm = pos->getBpm())
             {
-                for (int i = 0; i < count && (fifoStart + i) * 2 + 1 < static_cast<int>(playbackBuffer_.size()); ++i)
+                if (numCaptureCuts_ > 0)
                 {
-                    const int s = (srcOffset + i) * 2;
-                    playbackBuffer_[static_cast<size_t>(fifoStart + i) * 2u] = src[s];
-                    playbackBuffer_[static_cast<size_t>(fifoStart + i) * 2u + 1u] = src[s + 1];
+                    auto& cut = captureCuts_[static_cast<size_t>(numCaptureCuts_ - 1)];
+                    cut.position.noteTempo(frame - cut.frame, *bpm);
                 }
-            };
-            copyBlock(start1, block1, 0);
-            copyBlock(start2, block2, block1);
-            playbackFifo_.finishedWrite(block1 + block2);
+                else
+                {
+                    capturePosition_.noteTempo(frame, *bpm);
+                }
+            }
+            if (offlineWriter_ != nullptr) // offline render thread: blocking only slows the bounce down
+                offlineWriter_->write(channels.data(), numSamples);
+            else if (const int dropped = currentSegmentBuffer_.append(channels.data(), numSamples); dropped > 0)
+                droppedCaptureFrames_.fetch_add(dropped);
+            if (offlineWriter_ == nullptr && currentSegmentBuffer_.getNumFreeBlocks() * 2 < getCaptureHeadroomBlocks())
+                triggerAsyncUpdate(); // refillCaptureBuffer()
+            capturePeaks_.append(mainInput.getArrayOfReadPointers(), numMonitored, numSamples);
+            captureGate_.process(mainInput.getArrayOfReadPointers(), numMonitored, numSamples);
         }
     }
 
-    int start1, block1, start2, block2;
-    playbackFifo_.prepareToRead(numSamples, start1, block1, start2, block2);
-    auto readFrames = [&](int fifoStart, int count, int bufferOffset)
+    // Playback: pick up a newly published result (once the current one could be handed back),
+    // then play straight from the block. Paused while the host renders offline, so a bounce
+    // neither contains the preview nor uses it up.
+    if (isNonRealtime())
+    {
+        buffer.clear();
+        return;
+    }
+    if (pendingPlayback_.load(std::memory_order_acquire) != nullptr
+        && (activePlayback_ == nullptr || retirePlayback(activePlayback_)))
+    {
+        activePlayback_ = pendingPlayback_.exchange(nullptr, std::memory_order_acq_rel);
+        playbackReadFrame_ = 0;
+    }
+
+    // Results are stereo: a mono output plays their mix, wider outputs keep the other channels silent
+    auto output = getBusBuffer(buffer, false, 0);
+    const int numOutputs = output.getNumChannels();
+    int played = 0;
+    if (activePlayback_ != nullptr && numOutputs > 0)
     {
-        for (int i = 0; i < count; ++i)
+        const size_t totalFrames = activePlayback_->size() / 2u;
+        played = static_cast<int>(std::min<size_t>(static_cast<size_t>(numSamples), totalFrames - playbackReadFrame_));
+        const float* src = activePlayback_->data() + playbackReadFrame_ * 2u;
+        float* left = output.getWritePointer(0);
+        if (numOutputs > 1)
         {
-            const size_t base = static_cast<size_t>(fifoStart + i) * 2u;
-            if (base + 1 < playbackBuffer_.size() && bufferOffset + i < numSamples)
-            {
-                buffer.setSample(0, bufferOffset + i, playbackBuffer_[base]);
-                buffer.setSample(1, bufferOffset + i, playbackBuffer_[base + 1]);
-            }
+            float* const outs[2] = { left, output.getWritePointer(1) };
+            SampleKernels::deinterleave(src, 2, played, outs);
         }
-    };
-    readFrames(start1, block1, 0);
-    readFrames(start2, block2, block1);
-    playbackFifo_.finishedRead(block1 + block2);
+        else
+        {
+            for (int i = 0; i < played; ++i)
+                left[i] = 0.5f * (src[i * 2] + src[i * 2 + 1]);
+        }
+        playbackReadFrame_ += static_cast<size_t>(played);
+        if (playbackReadFrame_ >= totalFrames && retirePlayback(activePlayback_))
+            activePlayback_ = nullptr;
+    }
 
-    const int readCount = block1 + block2;
-    for (int i = readCount; i < numSamples; ++i)
+    for (int c = 0; c < numOutputs; ++c)
+    {
+        const int from = c < 2 ? played : 0;
+        output.clear(c, from, numSamples - from);
+    }
+}
+
+// A loop wrap shows up as a block starting before the point the previous block ran up to
+bool AceForgeSunoAudioProcessor::isLoopWrap(const juce::AudioPlayHead::PositionInfo& pos, int numSamples)
+{
+    bool wrapped = false;
+    if (auto ppq = pos.getPpqPosition())
+    {
+        const double bpm = pos.getBpm().orFallback(hostBpm_.load());
+        wrapped = pos.getIsLooping() && expectedPpq_ >= 0.0 && *ppq < expectedPpq_ - kLoopWrapTolerancePpq;
+        expectedPpq_ = *ppq + numSamples / sampleRate_.load() * bpm / 60.0;
+        expectedSamples_ = -1;
+    }
+    else if (auto samples = pos.getTimeInSamples())
     {
-        buffer.setSample(0, i, 0.0f);
-        buffer.setSample(1, i, 0.0f);
+        wrapped = pos.getIsLooping() && expectedSamples_ >= 0 && *samples < expectedSamples_;
+        expectedSamples_ = *samples + numSamples;
+        expectedPpq_ = -1.0;
     }
+    return wrapped;
 }
 
 void AceForgeSunoAudioProcessor::handleAsyncUpdate()
 {
-    std::vector<uint8_t> wavBytes;
-    juce::String promptForLibrary;
+    takePreRoll();
+    while (commitStoppedCapture())
+    {
+    }
+    refillCaptureBuffer();
+    if (const int lost = lostCaptures_.exchange(0); lost > 0)
+    {
+        // Not a job failure: a generation may be running meanwhile
+        juce::ScopedLock sl(statusLock_);
+        statusText_ = juce::String(lost) + (lost == 1 ? " capture was" : " captures were")
+                      + " lost: the transport stopped again before earlier ones were saved.";
+    }
+    if (const juce::int64 dropped = droppedCaptureFrames_.exchange(0); dropped > 0)
+    {
+        juce::ScopedLock sl(statusLock_);
+        statusText_ = juce::String(static_cast<double>(dropped) / sampleRate_.load(), 2)
+                      + " s of input were not recorded: the capture outran its free blocks.";
+    }
+    persistNewSegments();
+
+    std::vector<uint8_t> audioBytes;
+    LibraryEntry libraryEntry;
     bool isTest = false;
     {
-        juce::ScopedLock l(pendingWavLock_);
-        if (pendingWavBytes_.empty())
+        juce::ScopedLock l(pendingAudioLock_);
+        if (pendingAudioBytes_.empty())
             return;
-        wavBytes = std::move(pendingWavBytes_);
-        pendingWavBytes_.clear();
-        promptForLibrary = pendingPrompt_;
+        audioBytes = std::move(pendingAudioBytes_);
+        pendingAudioBytes_.clear();
+        libraryEntry = pendingLibraryEntry_;
         isTest = pendingIsTest_.exchange(false);
     }
+    auto bytes = std::make_shared<const std::vector<uint8_t>>(std::move(audioBytes));
+    addDecodeJob([this, bytes, libraryEntry, isTest] { processJobResult(*bytes, libraryEntry, isTest); });
+}
 
-    juce::AudioFormatManager fm;
-    fm.registerFormat(new juce::WavAudioFormat(), true);
-    std::unique_ptr<juce::MemoryInputStream> mis(new juce::MemoryInputStream(wavBytes.data(), wavBytes.size(), false));
-    std::unique_ptr<juce::AudioFormatReader> reader(fm.createReaderFor(std::move(mis)));
-    if (!reader)
+// Copies the newest pre-roll seconds out of the ring frozen on transport start and thaws it
+void AceForgeSunoAudioProcessor::takePreRoll()
+{
+    SegmentAudio preRoll;
     {
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = "Failed to decode WAV";
-        statusText_ = lastError_;
-        return;
+        const juce::ScopedLock pl(preRollLock_);
+        if (!preRoll_.isFrozen())
+            return;
+        preRoll = preRoll_.take(static_cast<int>(preRollSeconds_.load() * sampleRate_.load()));
     }
-    const double fileSampleRate = reader->sampleRate;
-    const int numCh = static_cast<int>(reader->numChannels);
-    const int numSamples = static_cast<int>(reader->lengthInSamples);
-    if (numSamples <= 0 || numCh <= 0)
+    juce::ScopedLock l(segmentLock_);
+    std::swap(pendingPreRoll_, preRoll); // an unused older pre-roll is freed outside the lock
+    pendingPreRollCaptureId_ = preRollCaptureId_;
+}
+
+// Builds the segment from the oldest capture handed over on transport stop. The copy happens
+// outside segmentLock_ so the audio thread is not held up by long captures. A cycling capture
+// becomes one take per pass, all viewing the same audio.
+bool AceForgeSunoAudioProcessor::commitStoppedCapture()
+{
+    CaptureBuffer capture;
+    SegmentAudio preRoll;
+    CaptureFormat format;
+    PeakPyramid capturePeaks;
+    MusicalPosition position;
+    SilenceGate lastTakeGate;
+    std::vector<LoopCut> cuts;
+    int captureId = 0;
     {
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = "Invalid WAV";
-        statusText_ = lastError_;
-        return;
+        juce::ScopedLock l(segmentLock_);
+        StoppedCapture* oldest = nullptr;
+        for (auto& stopped : stoppedCaptures_)
+            if (stopped.capture.getNumFrames() > 0 && (oldest == nullptr || stopped.captureId < oldest->captureId))
+                oldest = &stopped;
+        if (oldest == nullptr)
+            return false;
+        std::swap(capture, oldest->capture);
+        format = oldest->format;
+        std::swap(capturePeaks, oldest->peaks);
+        position = oldest->position;
+        lastTakeGate = oldest->gate;
+        cuts.assign(oldest->cuts.begin(), oldest->cuts.begin() + oldest->numCuts);
+        captureId = oldest->captureId;
+        if (pendingPreRollCaptureId_ == captureId && pendingPreRoll_.getNumChannels() == format.getNumChannels())
+            std::swap(preRoll, pendingPreRoll_);
     }
-    juce::AudioBuffer<float> fileBuffer(numCh, numSamples);
-    if (!reader->read(&fileBuffer, 0, numSamples, 0, true, true))
+
+    // Whole peak buckets of pre-roll only (dropping at most a few ms of its oldest audio), so the
+    // capture's peaks can be appended instead of recomputed
+    const int numChannels = format.getNumChannels();
+    const int skipFrames = preRoll.getNumFrames() % PeakPyramid::kBaseFramesPerPeak;
+    const int preRollLength = preRoll.getNumFrames() - skipFrames;
+    const int totalFrames = preRollLength + static_cast<int>(capture.getNumFrames());
+    auto audio = std::make_shared<SegmentAudio>(numChannels, totalFrames);
+    for (int c = 0; c < numChannels && preRollLength > 0; ++c)
+        juce::FloatVectorOperations::copy(audio->getWritePointer(c), preRoll.getReadPointer(c, skipFrames), preRollLength);
+    capture.copyTo(*audio, preRollLength);
+    std::array<const float*, kMaxCaptureChannels> rows{};
+    audio->getReadPointers(rows.data());
+    const double sampleRate = sampleRate_.load();
+
+    // Take boundaries: the pre-roll belongs to the first pass; the pre-roll runs up to the first
+    // captured block, so frame 0 lies that far before the capture position
+    std::vector<RecordedSegment> takes;
+    auto addTake = [&](int start, const MusicalPosition& takePosition)
     {
-        state_.store(State::Failed);
-        juce::ScopedLock l(statusLock_);
-        lastError_ = "Failed to read WAV samples";
-        statusText_ = lastError_;
+        if (!takes.empty())
+            takes.back().numFrames = start - takes.back().audioOffsetFrames;
+        RecordedSegment seg;
+        seg.audio = audio;
+        seg.numChannels = format.getNumChannels();
+        seg.sidechainChannels = format.sidechainChannels;
+        seg.channelLayout = format.layout;
+        seg.audioOffsetFrames = start;
+        seg.sampleRate = sampleRate;
+        seg.position = takePosition;
+        seg.lastUsedMs = juce::Time::currentTimeMillis();
+        takes.push_back(std::move(seg));
+    };
+    addTake(0, position.shifted(-preRollLength, sampleRate));
+    for (const auto& cut : cuts)
+        addTake(preRollLength + static_cast<int>(cut.frame), cut.position);
+    takes.back().numFrames = totalFrames - takes.back().audioOffsetFrames;
+
+    // Sound bounds per take from the capture-time gates (the pre-roll is scanned here, it is short)
+    // give the default trim: silence at both ends is not uploaded
+    for (size_t i = 0; i < takes.size(); ++i)
+    {
+        SilenceGate gate;
+        if (i == 0)
+            gate.process(rows.data(), format.mainChannels, preRollLength);
+        gate.append(i < cuts.size() ? cuts[i].endedTake : lastTakeGate);
+        applySoundBounds(takes[i], gate);
+    }
+    if (takes.size() > 1 && takes.back().numFrames < static_cast<int>(kMinSegmentSeconds * sampleRate))
+        takes.pop_back(); // stopped just after a wrap
+    if (takes.size() > 1)
+    {
+        for (size_t i = 0; i < takes.size(); ++i)
+            takes[i].loopTake = static_cast<int>(i) + 1;
+    }
+    else
+    {
+        auto peaks = std::make_shared<PeakPyramid>();
+        peaks->append(rows.data(), format.mainChannels, preRollLength);
+        peaks->appendPyramid(capturePeaks);
+        peaks->finish();
+        takes.back().numFrames = totalFrames;
+        takes.back().peaks = std::move(peaks); // takes build theirs from their views on first request
+    }
+
+    capture.reset(numChannels);
+    juce::ScopedLock l(segmentLock_);
+    for (auto& take : takes)
+    {
+        take.id = nextSegmentId_++;
+        segments_.push_back(std::move(take));
+    }
+    selectedSegmentIndex_.store(static_cast<int>(segments_.size()) - 1);
+    for (auto& stopped : stoppedCaptures_)
+    {
+        if (stopped.capture.getNumFrames() == 0 && !stopped.capture.hasStorage())
+        {
+            std::swap(stopped.capture, capture); // the audio thread records into these blocks next time
+            break;
+        }
+    }
+    return true;
+}
+
+// Tops currentSegmentBuffer_ up to getCaptureHeadroomBlocks() free blocks. They are allocated
+// outside segmentLock_ and only moved in under it; blocks of an older width come back out and
+// are freed after the lock.
+void AceForgeSunoAudioProcessor::refillCaptureBuffer()
+{
+    int numChannels = 0;
+    int missing = 0;
+    {
+        juce::ScopedLock l(segmentLock_);
+        if (!wasPlaying_ && currentSegmentBuffer_.getNumChannels() != inputFormat_.getNumChannels())
+            currentSegmentBuffer_.reset(inputFormat_.getNumChannels()); // the next capture's width
+        numChannels = currentSegmentBuffer_.getNumChannels();
+        missing = getCaptureHeadroomBlocks() - currentSegmentBuffer_.getNumFreeBlocks();
+    }
+    if (missing <= 0 || numChannels <= 0)
         return;
+    std::vector<std::unique_ptr<SegmentAudio>> blocks;
+    for (int i = 0; i < missing; ++i)
+        blocks.push_back(CaptureBuffer::makeBlock(numChannels));
+    juce::ScopedLock l(segmentLock_);
+    if (currentSegmentBuffer_.getNumChannels() == numChannels)
+        currentSegmentBuffer_.addBlocks(blocks);
+}
+
+int AceForgeSunoAudioProcessor::getCaptureHeadroomBlocks() const
+{
+    return static_cast<int>(std::ceil(kCaptureHeadroomSeconds * sampleRate_.load() / CaptureBuffer::kBlockFrames));
+}
+
+// Records where seg has sound and trims the silence around it (numFrames and sampleRate set)
+void AceForgeSunoAudioProcessor::applySoundBounds(RecordedSegment& seg, const SilenceGate& gate)
+{
+    seg.soundStartFrame = static_cast<int>(gate.getSoundStart());
+    seg.soundEndFrame = static_cast<int>(gate.getSoundEnd());
+    if (seg.isSilent())
+        return;
+    seg.trimStartSamples = std::max(0, seg.soundStartFrame - static_cast<int>(kTrimLeadSeconds * seg.sampleRate));
+    const int end = seg.soundEndFrame + static_cast<int>(kTrimTailSeconds * seg.sampleRate);
+    seg.trimEndSamples = end < seg.numFrames ? end : 0;
+}
+
+// segmentLock_ held. The sidecar is completed and hashed on the decode pool; the segment then
+// arrives paged out, like a restored one.
+void AceForgeSunoAudioProcessor::finishOfflineCapture()
+{
+    std::shared_ptr<SegmentStore::Writer> writer(std::move(offlineWriter_));
+    auto peaks = std::make_shared<PeakPyramid>(std::move(capturePeaks_));
+    capturePeaks_.clear();
+    addDecodeJob([this, writer, peaks, gate = captureGate_, position = capturePosition_,
+                  format = captureFormat_, sampleRate = sampleRate_.load()]
+    {
+        const juce::int64 numFrames = writer->getNumFrames();
+        if (numFrames < static_cast<juce::int64>(kMinSegmentSeconds * sampleRate))
+            return;
+        const juce::String key = writer->finish();
+        if (key.isEmpty())
+        {
+            // Not a job failure: a generation may be running meanwhile
+            juce::ScopedLock sl(statusLock_);
+            statusText_ = "Offline capture could not be written to " + SegmentStore::getDirectory().getFullPathName();
+            triggerAsyncUpdate();
+            return;
+        }
+        peaks->finish();
+
+        RecordedSegment seg;
+        seg.numFrames = static_cast<int>(numFrames);
+        seg.numChannels = format.getNumChannels();
+        seg.sidechainChannels = format.sidechainChannels;
+        seg.channelLayout = format.layout;
+        seg.sampleRate = sampleRate;
+        seg.audioKey = key;
+        seg.peaks = peaks;
+        seg.position = position;
+        applySoundBounds(seg, gate);
+        juce::ScopedLock l(segmentLock_);
+        seg.id = nextSegmentId_++;
+        segments_.push_back(std::move(seg));
+        selectedSegmentIndex_.store(static_cast<int>(segments_.size()) - 1);
+    });
+}
+
+// Packs and writes each new segment to a SegmentStore sidecar once, on the decode pool, so saving
+// the project only writes its key. Segments are matched by their audio, not by index, since the
+// list may change while a write is running.
+void AceForgeSunoAudioProcessor::persistNewSegments()
+{
+    juce::ScopedLock l(segmentLock_);
+    for (auto& seg : segments_)
+    {
+        if (seg.persistStarted || seg.audioKey.isNotEmpty() || (seg.audio == nullptr && seg.packedAudio == nullptr))
+            continue;
+        for (auto& other : segments_) // loop takes share one sidecar
+            if (other.audio == seg.audio && other.packedAudio == seg.packedAudio)
+                other.persistStarted = true;
+        addDecodeJob([this, audio = seg.audio, packedAudio = seg.packedAudio]
+        {
+            const juce::MemoryBlock packed = packedAudio != nullptr
+                ? *packedAudio
+                : packWholeAudio(*audio);
+            const juce::String key = SegmentStore::keyFor(packed);
+            if (!SegmentStore::store(key, packed))
+                return; // state keeps embedding this segment inline
+            juce::ScopedLock sl(segmentLock_);
+            for (auto& stored : segments_)
+            {
+                if ((audio != nullptr && stored.audio == audio) || (packedAudio != nullptr && stored.packedAudio == packedAudio))
+                {
+                    stored.audioKey = key;
+                    stored.packedAudio = nullptr; // the sidecar now holds it
+                }
+            }
+        });
+    }
+}
+
+// Message thread, every kSegmentMemoryIntervalMs. Audio shared by loop takes is compacted once, when
+// none of them has been used for kCompactIdleMs. Only audio that already has a sidecar is
+// compacted, so a project save never has to decode it. The raw audio is dropped on a later pass,
+// if the takes are still idle by then.
+void AceForgeSunoAudioProcessor::compactIdleSegments()
+{
+    const juce::int64 now = juce::Time::currentTimeMillis();
+    std::vector<std::shared_ptr<const void>> released; // freed after the lock: the audio thread takes it
+    juce::ScopedLock l(segmentLock_);
+    for (auto& seg : segments_)
+    {
+        if (seg.audio == nullptr || seg.audioKey.isEmpty() || seg.compactStarted)
+            continue;
+        const auto audio = seg.audio;
+        bool idle = true;
+        for (const auto& other : segments_)
+            if (other.audio == audio && now - other.lastUsedMs < kCompactIdleMs)
+                idle = false;
+        if (!idle)
+            continue;
+        if (seg.compactAudio != nullptr)
+        {
+            for (auto& other : segments_)
+                if (other.audio == audio)
+                    released.push_back(std::move(other.audio)); // copies still in use keep theirs
+            continue;
+        }
+        for (auto& other : segments_)
+            if (other.audio == audio)
+                other.compactStarted = true;
+        addDecodeJob([this, audio]
+        {
+            auto compact = CompactAudio::encode(*audio, parallelForOn(*services_));
+            juce::ScopedLock sl(segmentLock_);
+            for (auto& stored : segments_)
+            {
+                if (stored.audio == audio)
+                {
+                    stored.compactAudio = compact;
+                    stored.compactStarted = false;
+                }
+            }
+        });
     }
-    std::vector<float> interleaved(static_cast<size_t>(numSamples) * 2u);
-    for (int i = 0; i < numSamples; ++i)
+}
+
+// Message thread, every kSegmentMemoryIntervalMs: reports this instance's usage and spills what
+// the AudioMemoryBudget asks for
+void AceForgeSunoAudioProcessor::enforceMemoryBudget()
+{
+    juce::int64 preRollBytes = 0;
     {
-        interleaved[static_cast<size_t>(i) * 2u] = numCh > 0 ? fileBuffer.getSample(0, i) : 0.0f;
-        interleaved[static_cast<size_t>(i) * 2u + 1u] = numCh > 1 ? fileBuffer.getSample(1, i) : interleaved[static_cast<size_t>(i) * 2u];
+        const juce::ScopedLock pl(preRollLock_);
+        preRollBytes = static_cast<juce::int64>(preRoll_.getCapacity()) * preRoll_.getNumChannels()
+                       * static_cast<juce::int64>(sizeof(float));
     }
-    pushSamplesToPlayback(interleaved.data(), numSamples, 2, fileSampleRate);
+    auto& budget = services_->getAudioMemory();
+    std::vector<std::shared_ptr<const void>> released; // freed after the lock: the audio thread takes it
+    juce::ScopedLock l(segmentLock_);
+    juce::int64 bytes = preRollBytes + getHeldAudioBytes();
+    budget.setUsage(this, bytes);
+    const juce::int64 excess = budget.getExcessFor(this);
+    if (excess > 0)
+    {
+        bytes -= spillLeastRecentlyUsed(excess, released);
+        budget.setUsage(this, bytes);
+    }
+    audioMemoryBytes_.store(bytes);
+}
+
+// The sidecars this session refers to, for SharedServices' sweep of unused ones
+void AceForgeSunoAudioProcessor::reportLiveSegmentKeys()
+{
+    std::set<juce::String> keys;
+    {
+        juce::ScopedLock l(segmentLock_);
+        for (const auto& seg : segments_)
+            if (seg.audioKey.isNotEmpty())
+                keys.insert(seg.audioKey);
+    }
+    services_->setLiveSegmentKeys(this, std::move(keys));
+}
+
+// Each buffer once, however many takes share it
+juce::int64 AceForgeSunoAudioProcessor::getHeldAudioBytes() const
+{
+    std::set<const void*> counted;
+    juce::int64 bytes = 0;
+    auto add = [&](const void* buffer, size_t size)
+    {
+        if (buffer != nullptr && counted.insert(buffer).second)
+            bytes += static_cast<juce::int64>(size);
+    };
+    for (const auto& seg : segments_)
+    {
+        add(seg.audio.get(), seg.audio != nullptr ? seg.audio->getSizeInBytes() : 0);
+        add(seg.compactAudio.get(), seg.compactAudio != nullptr ? seg.compactAudio->getSizeInBytes() : 0);
+        add(seg.packedAudio.get(), seg.packedAudio != nullptr ? seg.packedAudio->getSize() : 0);
+    }
+    for (const auto& stopped : stoppedCaptures_)
+        bytes += static_cast<juce::int64>(stopped.capture.getSizeInBytes());
+    return bytes + static_cast<juce::int64>(currentSegmentBuffer_.getSizeInBytes() + pendingPreRoll_.getSizeInBytes());
+}
+
+// Drops the in-memory audio of whole groups of takes, least recently used first; their sidecar
+// already holds it and getSegmentWithAudio() reads it back on the next use. Audio without a
+// sidecar yet stays, and so does audio a job still holds a copy of (dropping it frees nothing).
+juce::int64 AceForgeSunoAudioProcessor::spillLeastRecentlyUsed(juce::int64 bytes,
+                                                               std::vector<std::shared_ptr<const void>>& released)
+{
+    struct Group
+    {
+        const void* buffer = nullptr;   // audio, or the compact copy once that is all there is
+        juce::int64 lastUsedMs = 0;
+        juce::int64 bytes = 0;
+        long numTakes = 0;
+        bool hasSidecar = true;
+        bool inUse = false;
+    };
+    std::vector<Group> groups;
+    for (const auto& seg : segments_)
+    {
+        const void* buffer = seg.audio != nullptr ? static_cast<const void*>(seg.audio.get()) : seg.compactAudio.get();
+        if (buffer == nullptr)
+            continue;
+        auto it = std::find_if(groups.begin(), groups.end(), [&](const Group& g) { return g.buffer == buffer; });
+        if (it == groups.end())
+        {
+            Group g;
+            g.buffer = buffer;
+            g.bytes = static_cast<juce::int64>((seg.audio != nullptr ? seg.audio->getSizeInBytes() : 0)
+                                               + (seg.compactAudio != nullptr ? seg.compactAudio->getSizeInBytes() : 0));
+            it = groups.insert(groups.end(), g);
+        }
+        it->lastUsedMs = std::max(it->lastUsedMs, seg.lastUsedMs);
+        it->hasSidecar = it->hasSidecar && seg.audioKey.isNotEmpty();
+        ++it->numTakes;
+    }
+    for (auto& g : groups)
+    {
+        for (const auto& seg : segments_)
+        {
+            if (seg.audio.get() == g.buffer || (seg.audio == nullptr && seg.compactAudio.get() == g.buffer))
+            {
+                g.inUse = (seg.audio != nullptr && seg.audio.use_count() > g.numTakes)
+                          || (seg.compactAudio != nullptr && seg.compactAudio.use_count() > g.numTakes);
+                break;
+            }
+        }
+    }
+    std::sort(groups.begin(), groups.end(), [](const Group& a, const Group& b) { return a.lastUsedMs < b.lastUsedMs; });
+
+    juce::int64 freed = 0;
+    for (const auto& g : groups)
+    {
+        if (freed >= bytes)
+            break;
+        if (!g.hasSidecar || g.inUse)
+            continue;
+        for (auto& seg : segments_)
+        {
+            if (seg.audio.get() == g.buffer || (seg.audio == nullptr && seg.compactAudio.get() == g.buffer))
+            {
+                released.push_back(std::move(seg.audio)); // leaves both null
+                released.push_back(std::move(seg.compactAudio));
+                seg.compactStarted = false;
+            }
+        }
+        freed += g.bytes;
+    }
+    return freed;
+}
+
+// Runs on the shared decode pool: decodes the downloaded audio for playback, then stores the original
+// bytes in the library (no re-encode; other formats are derived on demand).
+void AceForgeSunoAudioProcessor::processJobResult(const std::vector<uint8_t>& audioBytes, LibraryEntry libraryEntry, bool isTest)
+{
+    juce::AudioFormatManager fm;
+    fm.registerBasicFormats();
+    std::unique_ptr<juce::MemoryInputStream> mis(new juce::MemoryInputStream(audioBytes.data(), audioBytes.size(), false));
+    std::unique_ptr<juce::AudioFormatReader> reader(fm.createReaderFor(std::move(mis)));
+    if (!reader)
+        return failJob("Failed to decode audio");
+    const double fileSampleRate = reader->sampleRate;
+    const int numCh = static_cast<int>(reader->numChannels);
+    const int numSamples = static_cast<int>(reader->lengthInSamples);
+    if (numSamples <= 0 || numCh <= 0)
+        return failJob("Invalid audio");
+    juce::AudioBuffer<float> fileBuffer(numCh, numSamples);
+    if (!reader->read(&fileBuffer, 0, numSamples, 0, true, true))
+        return failJob("Failed to read audio samples");
+    const float* const stereo[2] = { fileBuffer.getReadPointer(0), fileBuffer.getReadPointer(numCh > 1 ? 1 : 0) };
+    pushSamplesToPlayback(stereo, 2, numSamples, fileSampleRate);
     state_.store(State::Succeeded);
     {
         juce::ScopedLock l(statusLock_);
         statusText_ = isTest ? "API test passed - audio received and playing." : "Generated - playing.";
     }
+    triggerAsyncUpdate();
 
     if (isTest)
         return; // don't save test audio to library
 
-    juce::File libDir = getLibraryDirectory();
-    juce::String baseName = "suno_" + juce::Time::getCurrentTime().formatted("%Y%m%d_%H%M%S");
-    juce::File wavFile = libDir.getChildFile(baseName + ".wav");
-    std::unique_ptr<juce::OutputStream> outStream = wavFile.createOutputStream();
-    if (outStream != nullptr)
-    {
-        juce::WavAudioFormat wavFormat;
-        auto options = juce::AudioFormatWriterOptions{}
-                          .withSampleRate(fileSampleRate)
-                          .withNumChannels(numCh)
-                          .withBitsPerSample(24);
-        if (auto writer = wavFormat.createWriterFor(outStream, options))
+    // Similarity features and tempo / key / loudness from the audio already decoded, so the
+    // library never re-reads it for this
+    libraryEntry.features = AudioFeatureExtractor::extract(stereo, 2, numSamples, fileSampleRate);
+    TrackAnalyzer analyzer(fileSampleRate, numCh);
+    analyzer.process(fileBuffer.getArrayOfReadPointers(), numSamples);
+    libraryEntry.analysis = analyzer.finish();
+    if (libraryEntry.analysis.bpm > 0.0 && state_.load() == State::Succeeded)
+    {
+        juce::String tempo = juce::String(libraryEntry.analysis.bpm, 1) + " BPM";
+        if (libraryEntry.hostBpm > 0.0)
+            tempo << (TrackAnalysis::tempoMatches(libraryEntry.analysis.bpm, libraryEntry.hostBpm) ? ", matches host " : ", host ")
+                  << juce::String(libraryEntry.hostBpm, 1);
         {
-            writer->writeFromAudioSampleBuffer(fileBuffer, 0, numSamples);
-            writer->flush();
+            juce::ScopedLock l(statusLock_);
+            statusText_ = "Generated - playing (" + tempo + ").";
         }
+        triggerAsyncUpdate();
     }
+
+    const juce::Time now = juce::Time::getCurrentTime();
+    const juce::String baseName = "suno_" + now.formatted("%Y%m%d_%H%M%S");
+    juce::String contentHash;
+    const juce::File file = services_->getLibrary().storeAudioFile(audioBytes.data(), audioBytes.size(), baseName, contentHash);
+    if (file == juce::File())
+    {
+        {
+            juce::ScopedLock l(statusLock_);
+            lastError_ = "Could not save to library: " + LibraryIndex::getLibraryDirectory().getFullPathName();
+            statusText_ = "Generated - playing (not saved to library).";
+        }
+        triggerAsyncUpdate();
+        return;
+    }
+    libraryEntry.file = file;
+    libraryEntry.time = now;
+    libraryEntry.durationSeconds = fileSampleRate > 0.0 ? numSamples / fileSampleRate : 0.0;
+    libraryEntry.sampleRate = fileSampleRate;
+    libraryEntry.numChannels = numCh;
+    libraryEntry.fileSize = static_cast<juce::int64>(audioBytes.size());
+    libraryEntry.contentHash = contentHash;
+    services_->getLibrary().addEntry(libraryEntry);
 }
 
 juce::String AceForgeSunoAudioProcessor::getStatusText() const
@@ -936,32 +1742,16 @@ juce::String AceForgeSunoAudioProcessor::getStatusText() const
     return statusText_;
 }
 
-juce::String AceForgeSunoAudioProcessor::getLastError() const
+juce::String AceForgeSunoAudioProcessor::getConnectionError() const
 {
     juce::ScopedLock l(statusLock_);
-    return lastError_;
-}
-
-juce::File AceForgeSunoAudioProcessor::getLibraryDirectory() const
-{
-    juce::File dir = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
-                         .getChildFile("AceForgeSuno")
-                         .getChildFile("Generations");
-    if (!dir.exists())
-        dir.createDirectory();
-    return dir;
+    return connectionError_;
 }
 
-std::vector<AceForgeSunoAudioProcessor::LibraryEntry> AceForgeSunoAudioProcessor::getLibraryEntries() const
+juce::String AceForgeSunoAudioProcessor::getLastError() const
 {
-    juce::Array<juce::File> wavs;
-    getLibraryDirectory().findChildFiles(wavs, juce::File::findFiles, false, "*.wav");
-    std::vector<LibraryEntry> entries;
-    for (const juce::File& f : wavs)
-        entries.push_back({ f, f.getFileName().upToFirstOccurrenceOf(".", false, false), f.getLastModificationTime() });
-    std::sort(entries.begin(), entries.end(),
-              [](const LibraryEntry& a, const LibraryEntry& b) { return a.time > b.time; });
-    return entries;
+    juce::ScopedLock l(statusLock_);
+    return lastError_;
 }
 
 // --- Boilerplate ---
@@ -977,31 +1767,139 @@ int AceForgeSunoAudioProcessor::getCurrentProgram() { return 0; }
 void AceForgeSunoAudioProcessor::setCurrentProgram(int index) { juce::ignoreUnused(index); }
 const juce::String AceForgeSunoAudioProcessor::getProgramName(int index) { juce::ignoreUnused(index); return "Default"; }
 void AceForgeSunoAudioProcessor::changeProgramName(int index, const juce::String& newName) { juce::ignoreUnused(index, newName); }
+// Any main input up to kMaxInputChannels; the output is stereo or matches the input. The sidechain
+// is optional, mono or stereo.
 bool AceForgeSunoAudioProcessor::isBusesLayoutSupported(const juce::AudioProcessor::BusesLayout& layouts) const
 {
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    const auto input = layouts.getMainInputChannelSet();
+    const auto output = layouts.getMainOutputChannelSet();
+    if (input.isDisabled() || input.size() > kMaxInputChannels)
         return false;
-    if (layouts.getMainInputChannelSet() != juce::AudioChannelSet::stereo())
+    if (output != juce::AudioChannelSet::stereo() && output != input)
         return false;
+    if (layouts.inputBuses.size() > 1)
+    {
+        const auto sidechain = layouts.getChannelSet(true, 1);
+        if (!sidechain.isDisabled() && sidechain != juce::AudioChannelSet::mono() && sidechain != juce::AudioChannelSet::stereo())
+            return false;
+    }
     return true;
 }
 
+juce::AudioChannelSet AceForgeSunoAudioProcessor::RecordedSegment::getMainChannelSet() const
+{
+    if (channelLayout.isEmpty())
+        return juce::AudioChannelSet::stereo();
+    const auto set = juce::AudioChannelSet::fromAbbreviatedString(channelLayout);
+    return set.size() == getNumMainChannels() ? set : juce::AudioChannelSet::discreteChannels(getNumMainChannels());
+}
+
+juce::String AceForgeSunoAudioProcessor::RecordedSegment::describeChannels() const
+{
+    const auto set = getMainChannelSet();
+    juce::String text;
+    if (set == juce::AudioChannelSet::mono())
+        text = "mono";
+    else if (set == juce::AudioChannelSet::stereo())
+        text = sidechainChannels > 0 ? "stereo" : "";
+    else
+        text = set.getDescription();
+    if (sidechainChannels > 0)
+        text << " + " << (sidechainChannels == 1 ? "mono" : "stereo") << " sidechain";
+    return text;
+}
+
+// Segments with a sidecar cost only their metadata; others are packed inline (a segment saved
+// before its sidecar write finished, or after that write failed).
 void AceForgeSunoAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
-    juce::MemoryOutputStream stream(destData, true);
-    stream.writeString(apiKey_);
+    PluginState state;
+    state.apiKey = apiKey_;
+    state.preRollSeconds = preRollSeconds_.load();
+    state.selectedSegment = selectedSegmentIndex_.load();
+    std::vector<RecordedSegment> segments;
+    {
+        juce::ScopedLock l(segmentLock_);
+        segments = segments_;
+    }
+    for (const auto& seg : segments)
+    {
+        PluginState::Segment s;
+        s.sampleRate = seg.sampleRate;
+        s.numFrames = seg.numFrames;
+        s.trimStartSamples = seg.trimStartSamples;
+        s.trimEndSamples = seg.trimEndSamples;
+        s.audioKey = seg.audioKey;
+        s.audioOffsetFrames = seg.audioKey.isNotEmpty() ? seg.audioOffsetFrames : 0;
+        s.numChannels = seg.numChannels;
+        s.sidechainChannels = seg.sidechainChannels;
+        s.channelLayout = seg.channelLayout;
+        s.loopTake = seg.loopTake;
+        s.soundStartFrame = seg.soundStartFrame;
+        s.soundEndFrame = seg.soundEndFrame;
+        if (seg.position.valid)
+            s.position = seg.position.toMemoryBlock();
+        if (s.audioKey.isEmpty() && seg.packedAudio != nullptr)
+            s.inlineAudio = *seg.packedAudio;
+        else if (s.audioKey.isEmpty() && seg.audio != nullptr)
+            s.inlineAudio = SegmentStore::pack(seg.getChannels().data(), seg.numChannels, seg.numFrames); // just this take
+        state.segments.push_back(std::move(s));
+    }
+    state.write(destData);
 }
 
 void AceForgeSunoAudioProcessor::setStateInformation(const void* data, int sizeInBytes)
 {
     if (data == nullptr || sizeInBytes <= 0)
         return;
-    juce::MemoryInputStream stream(data, static_cast<size_t>(sizeInBytes), false);
-    apiKey_ = stream.readString();
+    PluginState state;
+    if (!state.read(data, static_cast<size_t>(sizeInBytes)))
+        return;
+
+    // Metadata only: audio pages in from its sidecar or inline chunk when first needed
+    std::vector<RecordedSegment> segments;
+    for (auto& s : state.segments)
+    {
+        RecordedSegment seg;
+        seg.numFrames = s.numFrames;
+        seg.sampleRate = s.sampleRate;
+        seg.trimStartSamples = juce::jlimit(0, s.numFrames, s.trimStartSamples);
+        seg.trimEndSamples = juce::jlimit(0, s.numFrames, s.trimEndSamples);
+        seg.audioKey = s.audioKey;
+        seg.audioOffsetFrames = s.audioKey.isNotEmpty() ? s.audioOffsetFrames : 0;
+        seg.numChannels = juce::jlimit(1, kMaxCaptureChannels, s.numChannels);
+        seg.sidechainChannels = juce::jlimit(0, std::min(kMaxSidechainChannels, seg.numChannels - 1), s.sidechainChannels);
+        seg.channelLayout = s.channelLayout;
+        seg.loopTake = s.loopTake;
+        if (s.soundEndFrame >= 0)
+        {
+            seg.soundStartFrame = juce::jlimit(0, s.numFrames, s.soundStartFrame);
+            seg.soundEndFrame = juce::jlimit(0, s.numFrames, s.soundEndFrame);
+        }
+        seg.position = MusicalPosition::fromMemory(s.position.getData(), s.position.getSize());
+        if (s.inlineAudio.getSize() > 0)
+            seg.packedAudio = std::make_shared<const juce::MemoryBlock>(std::move(s.inlineAudio));
+        segments.push_back(std::move(seg));
+    }
+    {
+        juce::ScopedLock l(segmentLock_);
+        segments_ = std::move(segments);
+        for (auto& seg : segments_)
+            seg.id = nextSegmentId_++;
+        currentSegmentBuffer_.clear();
+        for (auto& stopped : stoppedCaptures_)
+            stopped.capture.clear();
+        selectedSegmentIndex_.store(state.selectedSegment < static_cast<int>(segments_.size()) ? state.selectedSegment : -1);
+    }
+    reportLiveSegmentKeys(); // before any sweep can miss them
+    triggerAsyncUpdate(); // moves inline chunks to sidecars
+    if (state.preRollSeconds >= 0.0f)
+        setPreRollSeconds(state.preRollSeconds);
+
+    apiKey_ = state.apiKey;
     if (client_)
         client_->setApiKey(apiKey_.toStdString());
-    if (client_ && client_->hasApiKey() && client_->checkCredits())
-        connected_.store(true);
+    requestHealthCheck(); // no network here: hosts restore state on their project-load thread
 }
 
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
@@ -4,12 +4,23 @@
 #include <juce_audio_formats/juce_audio_formats.h>
 #include <juce_core/juce_core.h>
 #include "SunoClient/SunoClient.hpp"
+#include "SharedServices.h"
+#include "CompactAudio.h"
+#include "MusicalPosition.h"
+#include "PreRollRing.h"
+#include "SegmentAudio.h"
+#include "SegmentSlicer.h"
+#include "SegmentStore.h"
+#include "SilenceGate.h"
+#include "WaveformPeaks.h"
+#include <array>
 #include <atomic>
 #include <memory>
 #include <vector>
 
 class AceForgeSunoAudioProcessor : public juce::AudioProcessor,
-                                   public juce::AsyncUpdater
+                                   public juce::AsyncUpdater,
+                                   private juce::MultiTimer
 {
 public:
     enum class State
@@ -26,6 +37,7 @@ public:
 
     void prepareToPlay(double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    void setNonRealtime(bool isNonRealtime) noexcept override;
     void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
 
     juce::AudioProcessorEditor* createEditor() override;
@@ -50,32 +62,115 @@ public:
 
     void handleAsyncUpdate() override;
 
-    // API key (persisted in state)
+    /** Result of the background credits check for the current API key. */
+    enum class Connection
+    {
+        NoKey,
+        Checking,
+        Connected,
+        Failed
+    };
+
+    // API key (persisted in state); setting it never blocks, validation runs in the background
     void setApiKey(const juce::String& key);
     juce::String getApiKey() const { return apiKey_; }
     bool hasValidApiKey() const { return client_ && client_->hasApiKey(); }
 
     // Recording follows DAW transport: play = start segment, stop = save segment
+    static constexpr double kMinSegmentSeconds = 1.0;    // shorter captures / trims are not usable
+    static constexpr double kTrimLeadSeconds = 0.05;     // kept before the first sound by the default trim
+    static constexpr double kTrimTailSeconds = 0.25;     // and after the last (release, reverb)
     bool isTransportRecording() const { return transportRecording_.load(); }
     void clearAllSegments();
+    // Input kept while stopped and prepended to the next segment (0 = off, persisted in state)
+    static constexpr float kMaxPreRollSeconds = 30.0f;
+    void setPreRollSeconds(float seconds);
+    float getPreRollSeconds() const { return preRollSeconds_.load(); }
+
+    // Captured audio in memory (segments, capture buffers, pre-roll) against the process-wide
+    // AudioMemoryBudget; updated every kSegmentMemoryIntervalMs
+    juce::int64 getAudioMemoryBytes() const { return audioMemoryBytes_.load(); }
+    juce::int64 getProcessAudioMemoryBytes() const { return services_->getAudioMemory().getTotalUsage(); }
+    int getNumAudioMemoryInstances() const { return services_->getAudioMemory().getNumOwners(); }
+    juce::int64 getAudioMemoryBudgetBytes() const { return services_->getAudioMemory().getBudgetBytes(); }
+    void setAudioMemoryBudgetBytes(juce::int64 bytes) { services_->getAudioMemory().setBudgetBytes(bytes); }
+    // Segment sidecars on disk, as of SharedServices' last sweep
+    juce::int64 getSegmentFileBytes() const { return services_->getSegmentFileBytes(); }
+
+    // Capture follows the main input layout (mono, stereo or up to kMaxInputChannels discrete /
+    // surround channels) plus the optional sidechain bus; uploads are downmixed to stereo
+    static constexpr int kMaxInputChannels = 8;
+    static constexpr int kMaxSidechainChannels = 2;
+    static constexpr int kMaxCaptureChannels = kMaxInputChannels + kMaxSidechainChannels;
 
     // Recorded segments (from DAW play/stop); user can review, trim, then use for Cover/Add Vocals
+    // Audio is immutable once captured, so copies share it; after a state restore it stays on disk
+    // (SegmentStore sidecar or inline chunk) until something needs the samples. The takes of one
+    // cycling capture are views into the same audio (audioOffsetFrames).
     struct RecordedSegment
     {
-        std::vector<float> buffer;  // stereo interleaved
+        int id = 0;                 // stable while the segment exists, unlike its index (nextSegmentId_)
+        std::shared_ptr<const SegmentAudio> audio;  // planar numChannels rows; null until paged in
+        std::shared_ptr<const CompactAudio> compactAudio;  // audio compressed once idle (audio is dropped then)
+        juce::int64 lastUsedMs = 0;  // capture or last getSegmentWithAudio(), Time::currentTimeMillis()
+        bool compactStarted = false;
+        int numChannels = 2;        // main input channels, then sidechainChannels
+        int sidechainChannels = 0;
+        juce::String channelLayout; // main input speaker arrangement (AudioChannelSet); empty = stereo
+        int audioOffsetFrames = 0;  // first frame of this segment within audio
+        int numFrames = 0;
         double sampleRate = 44100.0;
         int trimStartSamples = 0;   // inclusive
         int trimEndSamples = 0;     // exclusive (0 = use full length)
+        std::vector<float> features; // AudioFeatureExtractor vector of the trimmed range; empty until requested
+        juce::String audioKey;       // SegmentStore sidecar, once written
+        std::shared_ptr<const juce::MemoryBlock> packedAudio;  // inline chunk from restored state without a sidecar
+        bool persistStarted = false;
+        std::shared_ptr<const PeakPyramid> peaks;  // built during capture, or from the audio on first request
+        bool peaksRequested = false;
+        MusicalPosition position;   // host timeline position of frame 0 (pre-roll included)
+        int loopTake = 0;           // 1-based pass of a cycling capture; 0 = not cycling
+        int soundStartFrame = 0;    // first frame above SilenceGate::kThreshold
+        int soundEndFrame = -1;     // after the last one; -1 = unknown (state from older builds)
+        std::vector<SegmentSlicer::Region> slices;  // bar-aligned trim proposals, best first
+        bool slicesRequested = false;
+        bool slicesReady = false;
+
+        bool isSilent() const { return soundEndFrame >= 0 && soundEndFrame <= soundStartFrame; }
+        int getNumMainChannels() const { return numChannels - sidechainChannels; }
+        juce::AudioChannelSet getMainChannelSet() const;
+        /** "mono", "5.1 Surround + sidechain", ...; empty for plain stereo. */
+        juce::String describeChannels() const;
+        /** Channel rows from frame of this segment on, main channels first (audio must be paged in). */
+        std::array<const float*, kMaxCaptureChannels> getChannels(int frame = 0) const
+        {
+            std::array<const float*, kMaxCaptureChannels> channels{};
+            audio->getReadPointers(channels.data(), audioOffsetFrames + frame);
+            return channels;
+        }
     };
     int getNumSegments() const;
+    /** Metadata and, if already in memory, the audio (never touches disk). */
     RecordedSegment getSegment(int index) const;
+    /** As getSegment(), paging the audio in first if needed (blocking: not on the message thread).
+        audio stays null if it cannot be loaded. */
+    RecordedSegment getSegmentWithAudio(int index);
+    /** Index of the segment with this RecordedSegment::id; -1 once it is gone. */
+    int findSegmentIndex(int id) const;
     double getSegmentDurationSeconds(int index) const;
     void setSegmentTrim(int index, int startSamples, int endSamples);
     void removeSegment(int index);
     int getSelectedSegmentIndex() const { return selectedSegmentIndex_.load(); }
     void setSelectedSegmentIndex(int index) { selectedSegmentIndex_.store(index); }
+    /** Waveform peaks of a segment; nullptr while they are built from paged-in audio (poll again). */
+    std::shared_ptr<const PeakPyramid> getSegmentPeaks(int index);
+    /** Bar-aligned trim proposals (SegmentSlicer); false while they are computed (poll again). */
+    bool getSegmentSlices(int index, std::vector<SegmentSlicer::Region>& slices);
     bool hasRecordedAudio() const;  // true if at least one segment with usable length
     bool hasSelectedSegment() const;
+    // Similarity: analyses the trimmed segment on the result thread; poll getSegmentFeatures()
+    void requestSegmentFeatures(int index);
+    std::vector<float> getSegmentFeatures(int index) const;
 
     // Generation modes
     void startGenerate(const juce::String& prompt, const juce::String& style, const juce::String& title,
@@ -87,7 +182,9 @@ public:
     State getState() const { return state_.load(); }
     juce::String getStatusText() const;
     juce::String getLastError() const;
-    bool isConnected() const { return connected_.load(); }
+    bool isConnected() const { return connection_.load() == Connection::Connected; }
+    Connection getConnection() const { return connection_.load(); }
+    juce::String getConnectionError() const;
 
     // Host tempo when available (from DAW)
     double getHostBpm() const { return hostBpm_.load(); }
@@ -95,52 +192,205 @@ public:
     // Built-in API test: check credits and optionally run a minimal generate to verify audio return
     void startTestApi();
 
-    // Library (saved generations on disk)
-    struct LibraryEntry { juce::File file; juce::String prompt; juce::Time time; };
-    juce::File getLibraryDirectory() const;
-    std::vector<LibraryEntry> getLibraryEntries() const;
+    // Library (saved generations on disk); the index is shared by all plugin instances (SharedServices)
+    using LibraryEntry = ::LibraryEntry;
+    juce::File getLibraryDirectory() const { return LibraryIndex::getLibraryDirectory(); }
+    LibraryIndex::SnapshotPtr getLibrarySnapshot() const { return services_->getLibrary().getSnapshot(); }
+    juce::uint32 getLibraryVersion() const { return services_->getLibrary().getVersion(); }
+    void refreshLibrary() { services_->getLibrary().requestRescan(); }
+    LibraryIndex::SnapshotPtr searchLibrary(const juce::String& query) const { return services_->getLibrary().search(query); }
+    // "Sounds like": best matches for a feature vector (library entry or segment), best first
+    LibraryIndex::SnapshotPtr findSimilarInLibrary(const std::vector<float>& features, const juce::File& exclude = {}) const
+    {
+        return services_->getLibrary().findSimilar(features, kMaxSimilarResults, exclude);
+    }
+    void touchLibraryFile(const juce::File& file) { services_->getLibrary().touch(file); }
+    void setLibraryFilePinned(const juce::File& file, bool pinned) { services_->getLibrary().setPinned(file, pinned); }
+    // Storage quota (0 = unlimited); enforced by the index thread, LRU and unpinned entries first
+    juce::int64 getLibraryQuotaBytes() const { return services_->getLibrary().getQuotaBytes(); }
+    void setLibraryQuotaBytes(juce::int64 bytes) { services_->getLibrary().setQuotaBytes(bytes); }
+    juce::int64 getLibraryTotalBytes() const { return services_->getLibrary().getTotalBytes(); }
+    juce::int64 getLibraryReclaimedBytes() const { return services_->getLibrary().getReclaimedBytes(); }
 
 private:
-    void runGenerateThread();
-    void runUploadCoverThread();
-    void runAddVocalsThread();
-    void runTestApiThread();
-    void pushSamplesToPlayback(const float* interleaved, int numFrames, int sourceChannels, double sourceSampleRate);
-    std::vector<uint8_t> encodeSegmentAsWav(int segmentIndex) const;
+    // What a network job holds instead of the processor and SharedServices, which it may outlive:
+    // the processor is only reached through withProcessor(), and requests go through a client of
+    // the job's own
+    struct NetworkJob
+    {
+        std::shared_ptr<OwnerLifetime> lifetime;
+        AceForgeSunoAudioProcessor* processor = nullptr;   // only dereferenced inside lifetime->run()
+        std::shared_ptr<NetworkServices> network;          // outlives SharedServices if need be
+        std::string apiKey;
+
+        /** Runs fn(processor) and returns true if the processor is still alive. */
+        template <typename Fn>
+        bool withProcessor(Fn&& fn) const
+        {
+            return lifetime->run([&] { fn(*processor); });
+        }
+    };
+    NetworkJob makeNetworkJob();
+    static void runGenerateJob(const NetworkJob& job);
+    static void runUploadCoverJob(const NetworkJob& job);
+    static void runAddVocalsJob(const NetworkJob& job);
+    static void runTestApiJob(const NetworkJob& job);
+    void requestHealthCheck();
+    static bool checkJobCredits(const NetworkJob& job);
+    static void watchJobTask(const NetworkJob& job, const std::string& taskId, bool isTest);
+    static void finishJobTask(const NetworkJob& job, const suno::TaskStatus& st, bool isTest);
+    void failJob(const juce::String& message);
+    static void failJob(const NetworkJob& job, const juce::String& message);
+    void reportJobProgress(const juce::String& text);   // State::Running with this status
+    // Decode pool job that runs, and keeps this instance alive, only while it has not been destroyed
+    void addDecodeJob(std::function<void()> job);
+    void pushSamplesToPlayback(const float* const* channels, int numChannels, int numFrames, double sourceSampleRate);
+    bool retirePlayback(PlaybackBufferPool::Block* block);   // audio thread; false if no slot is free yet
+    void reclaimFinishedPlayback();
+    void releasePlaybackBlock(PlaybackBufferPool::Block* block);
+    void timerCallback(int timerId) override;
+    void resizePreRoll();
+    void takePreRoll();
+    bool commitStoppedCapture();   // false if no capture was waiting
+    void refillCaptureBuffer();
+    int getCaptureHeadroomBlocks() const;   // audio thread too: arithmetic only
+    static void applySoundBounds(RecordedSegment& seg, const SilenceGate& gate);
+    void finishOfflineCapture();
+    bool isLoopWrap(const juce::AudioPlayHead::PositionInfo& pos, int numSamples);   // audio thread
+    void persistNewSegments();
+    void compactIdleSegments();
+    void enforceMemoryBudget();
+    void reportLiveSegmentKeys();
+    juce::int64 getHeldAudioBytes() const;                    // segmentLock_ held
+    // segmentLock_ held; returns the bytes freed. The dropped buffers go to released, to be freed
+    // after the lock
+    juce::int64 spillLeastRecentlyUsed(juce::int64 bytes, std::vector<std::shared_ptr<const void>>& released);
+    static std::vector<uint8_t> encodeSegmentAsWav(const RecordedSegment& seg);
+    static juce::String segmentUploadKey(const RecordedSegment& seg);
+    static std::string uploadSegmentForJob(const NetworkJob& job, suno::SunoClient& client, const std::string& fileName,
+                                           juce::String& uploadKey);
+    LibraryEntry makeJobLibraryEntry(const suno::TaskStatus& status) const;
+    suno::GenerateParams makeJobGenerateParams() const;
+    void processJobResult(const std::vector<uint8_t>& audioBytes, LibraryEntry libraryEntry, bool isTest);
+
+    static constexpr int kMaxSimilarResults = 50;
 
     std::unique_ptr<suno::SunoClient> client_;
+    juce::SharedResourcePointer<SharedServices> services_;   // jobs, poller, decode pool, library
+    std::shared_ptr<OwnerLifetime> lifetime_ = std::make_shared<OwnerLifetime>();   // shared with running jobs
     juce::String apiKey_;
     std::atomic<State> state_{ State::Idle };
-    std::atomic<bool> connected_{ false };
+    std::atomic<Connection> connection_{ Connection::NoKey };
+    std::atomic<int> healthCheckGeneration_{ 0 };
     std::atomic<bool> transportRecording_{ false };
     juce::CriticalSection statusLock_;
     juce::String lastError_;
     juce::String statusText_;
+    juce::String connectionError_;   // from the last failed credits check
     std::atomic<double> hostBpm_{ 0.0 };
 
+    // Channels a capture records, fixed when it starts (layout changes come with prepareToPlay)
+    struct CaptureFormat
+    {
+        int mainChannels = 2;
+        int sidechainChannels = 0;
+        juce::String layout;   // as RecordedSegment::channelLayout
+
+        int getNumChannels() const { return mainChannels + sidechainChannels; }
+    };
+
     // Transport-driven recording: current in-progress segment while DAW is playing
-    std::vector<float> currentSegmentBuffer_;
+    CaptureFormat inputFormat_;     // under segmentLock_: current bus layout
+    CaptureFormat captureFormat_;   // of the running capture
+    // The audio thread only fills blocks already in currentSegmentBuffer_; refillCaptureBuffer()
+    // keeps kCaptureHeadroomSeconds of free blocks in it from the message thread (timer, and
+    // an async update whenever the audio thread finds fewer than half of them)
+    static constexpr double kCaptureHeadroomSeconds = 4.0;
+    CaptureBuffer currentSegmentBuffer_;
+    std::atomic<juce::int64> droppedCaptureFrames_{ 0 };   // recorded while no block was free
+    PeakPyramid capturePeaks_;    // updated per block alongside currentSegmentBuffer_
+    MusicalPosition capturePosition_;  // playhead at the first captured block, plus tempo changes
+    SilenceGate captureGate_;          // sound of the current take
+
+    // Cycle passes of the running capture: a loop wrap starts a new take at that capture frame.
+    // Fixed size so the audio thread never allocates; passes beyond the limit join the last take.
+    struct LoopCut
+    {
+        juce::int64 frame = 0;
+        MusicalPosition position;
+        SilenceGate endedTake;   // sound of the take this cut ends
+    };
+    static constexpr int kMaxLoopCuts = 63;
+    static constexpr double kLoopWrapTolerancePpq = 0.01;   // host rounding, not a jump
+    std::array<LoopCut, kMaxLoopCuts> captureCuts_{};
+    int numCaptureCuts_ = 0;
+    double expectedPpq_ = -1.0;          // audio thread: where the next block should start if not wrapping
+    juce::int64 expectedSamples_ = -1;
     bool wasPlaying_ = false;
     juce::CriticalSection segmentLock_;
 
+    // Pre-roll ring: frozen by the audio thread on transport start, emptied by takePreRoll(). A
+    // finished capture is handed over in a free stoppedCaptures_ slot and committed by
+    // commitStoppedCapture(), oldest first, with the pre-roll of the same capture (captureId_) in
+    // front. Several slots, so stopping again before the message thread got to the last one
+    // keeps both takes.
+    PreRollRing preRoll_;
+    juce::CriticalSection preRollLock_;           // resizing vs takePreRoll(); never the audio thread
+    std::atomic<float> preRollSeconds_{ 2.0f };
+    int captureId_ = 0;                           // under segmentLock_: one per transport start
+    int preRollCaptureId_ = 0;                    // capture the frozen ring belongs to
+    SegmentAudio pendingPreRoll_;
+    int pendingPreRollCaptureId_ = 0;
+    struct StoppedCapture
+    {
+        CaptureBuffer capture;   // free while empty; its blocks are recycled for the next capture
+        CaptureFormat format;
+        PeakPyramid peaks;
+        MusicalPosition position;
+        SilenceGate gate;
+        std::array<LoopCut, kMaxLoopCuts> cuts{};
+        int numCuts = 0;
+        int captureId = 0;
+    };
+    static constexpr int kMaxStoppedCaptures = 4;
+    std::array<StoppedCapture, kMaxStoppedCaptures> stoppedCaptures_;
+    std::atomic<int> lostCaptures_{ 0 };   // stopped while every slot was still waiting; reported in the status
+
+    // Offline bounce: a capture that starts while the host renders non-realtime streams straight
+    // into a SegmentStore sidecar instead of growing currentSegmentBuffer_, so a long bounce is
+    // never held in memory and ends as a paged-out segment.
+    std::unique_ptr<SegmentStore::Writer> offlineWriter_;   // under segmentLock_
+
     // Saved segments (one per DAW play/stop); user selects one for Cover/Add Vocals
     std::vector<RecordedSegment> segments_;
+    int nextSegmentId_ = 1;   // under segmentLock_
+    // Segments with a sidecar that nothing has used for kCompactIdleMs keep their audio as
+    // CompactAudio only; getSegmentWithAudio() decodes it again on the next use. Over the memory
+    // budget, the least recently used ones are dropped to their sidecar altogether.
+    static constexpr int kSegmentMemoryTimerId = 2;
+    static constexpr int kSegmentMemoryIntervalMs = 1000;
+    static constexpr juce::int64 kCompactIdleMs = 30 * 1000;
+    std::atomic<juce::int64> audioMemoryBytes_{ 0 };
     std::atomic<int> selectedSegmentIndex_{ -1 };
 
-    // Playback (same double-buffer pattern as AceForge plugin)
-    static constexpr int kPlaybackFifoFrames = 1 << 20;
-    juce::AbstractFifo playbackFifo_{ kPlaybackFifoFrames };
-    std::vector<float> playbackBuffer_;
-    std::vector<float> pendingPlaybackBuffer_[2];
-    std::atomic<int> pendingPlaybackFrames_{ 0 };
-    std::atomic<int> pendingPlaybackBufferIndex_{ 0 };
-    std::atomic<int> nextWriteIndex_{ 0 };
-    std::atomic<bool> pendingPlaybackReady_{ false };
+    // Playback: the decode thread fills a block from the shared PlaybackBufferPool (nothing is
+    // allocated before the first result) and publishes it; the audio thread plays it in place and
+    // hands it back when done; timerCallback() returns handed-back blocks to the pool.
+    using PlaybackBlock = PlaybackBufferPool::Block;
+    static constexpr double kMaxPlaybackSeconds = 10.0 * 60.0;
+    static constexpr int kNumFinishedPlaybackSlots = 2;
+    static constexpr int kPlaybackReclaimIntervalMs = 500;
+    static constexpr int kPlaybackTimerId = 1;
+    std::atomic<PlaybackBlock*> pendingPlayback_{ nullptr };         // published, not yet picked up
+    PlaybackBlock* activePlayback_ = nullptr;                         // audio thread only
+    size_t playbackReadFrame_ = 0;                                    // audio thread only
+    std::atomic<PlaybackBlock*> finishedPlayback_[kNumFinishedPlaybackSlots] {};
+    std::atomic<int> playbackBlocksOut_{ 0 };                         // taken from the pool, not yet returned
     std::atomic<double> sampleRate_{ 44100.0 };
 
-    juce::CriticalSection pendingWavLock_;
-    std::vector<uint8_t> pendingWavBytes_;
-    juce::String pendingPrompt_;
+    juce::CriticalSection pendingAudioLock_;
+    std::vector<uint8_t> pendingAudioBytes_;
+    LibraryEntry pendingLibraryEntry_;
     std::atomic<bool> pendingIsTest_{ false };
 
     // Params for current job (set before starting thread)
@@ -152,7 +402,9 @@ private:
     int jobModelIndex_{ 3 };  // V4_5ALL
     bool jobIsCover_{ false };
     bool jobIsAddVocals_{ false };
-    int jobSegmentIndex_{ -1 };
+    int jobSegmentId_{ 0 };   // RecordedSegment::id of the source; the job finds it again by id
+    double jobHostBpm_{ 0.0 };
+    MusicalPosition jobSourcePosition_;   // of the trimmed segment
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AceForgeSunoAudioProcessor)
 };
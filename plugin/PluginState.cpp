@@ -0,0 +1,187 @@
+#include "PluginState.h"
+#include <cstring>
+
+namespace
+{
+const char kMagic[8] = { 'A', 'F', 'S', 'S', 'T', 'A', 'T', 'E' };
+constexpr size_t kHeaderSize = 12;
+constexpr size_t kFieldHeaderSize = 5;
+
+// Field ids are part of the state format: append new ids, never renumber.
+enum Field : juce::uint8
+{
+    kFieldApiKey = 1,
+    kFieldSelectedSegment = 2,
+    kFieldSegment = 3,
+    kFieldPreRollSeconds = 4
+};
+
+enum SegmentField : juce::uint8
+{
+    kSegmentSampleRate = 1,
+    kSegmentNumFrames = 2,
+    kSegmentTrimStart = 3,
+    kSegmentTrimEnd = 4,
+    kSegmentAudioKey = 5,
+    kSegmentInlineAudio = 6,
+    kSegmentPosition = 7,
+    kSegmentAudioOffset = 8,
+    kSegmentLoopTake = 9,
+    kSegmentSoundStart = 10,
+    kSegmentSoundEnd = 11,
+    kSegmentNumChannels = 12,
+    kSegmentSidechainChannels = 13,
+    kSegmentChannelLayout = 14
+};
+
+void writeField(juce::OutputStream& out, juce::uint8 id, const void* data, size_t size)
+{
+    out.writeByte(static_cast<char>(id));
+    out.writeInt(static_cast<int>(size));
+    out.write(data, size);
+}
+
+void writeStringField(juce::OutputStream& out, juce::uint8 id, const juce::String& s)
+{
+    if (s.isEmpty())
+        return;
+    writeField(out, id, s.toRawUTF8(), s.getNumBytesAsUTF8());
+}
+
+template <typename T>
+void writeValueField(juce::OutputStream& out, juce::uint8 id, T value)
+{
+    writeField(out, id, &value, sizeof(T));
+}
+
+template <typename T>
+bool readValue(const juce::uint8* data, juce::uint32 length, T& value)
+{
+    if (length != sizeof(T))
+        return false;
+    std::memcpy(&value, data, sizeof(T));
+    return true;
+}
+
+juce::String readText(const juce::uint8* data, juce::uint32 length)
+{
+    return juce::String::fromUTF8(reinterpret_cast<const char*>(data), static_cast<int>(length));
+}
+
+/** Calls fn(id, data, length) for each field; false if a field runs past the end. */
+template <typename Fn>
+bool forEachField(const juce::uint8* data, size_t size, Fn&& fn)
+{
+    size_t pos = 0;
+    while (pos + kFieldHeaderSize <= size)
+    {
+        const juce::uint8 id = data[pos];
+        const juce::uint32 length = juce::ByteOrder::littleEndianInt(data + pos + 1);
+        pos += kFieldHeaderSize;
+        if (length > size - pos)
+            return false;
+        fn(id, data + pos, length);
+        pos += length;
+    }
+    return pos == size;
+}
+} // namespace
+
+void PluginState::write(juce::MemoryBlock& dest) const
+{
+    juce::MemoryOutputStream out(dest, false);
+    out.write(kMagic, sizeof(kMagic));
+    out.writeInt(static_cast<int>(kFormatVersion));
+    writeStringField(out, kFieldApiKey, apiKey);
+    writeValueField(out, kFieldSelectedSegment, static_cast<juce::int32>(selectedSegment));
+    if (preRollSeconds >= 0.0f)
+        writeValueField(out, kFieldPreRollSeconds, preRollSeconds);
+    for (const auto& s : segments)
+    {
+        juce::MemoryOutputStream seg;
+        writeValueField(seg, kSegmentSampleRate, s.sampleRate);
+        writeValueField(seg, kSegmentNumFrames, static_cast<juce::int32>(s.numFrames));
+        writeValueField(seg, kSegmentTrimStart, static_cast<juce::int32>(s.trimStartSamples));
+        writeValueField(seg, kSegmentTrimEnd, static_cast<juce::int32>(s.trimEndSamples));
+        writeStringField(seg, kSegmentAudioKey, s.audioKey);
+        if (s.audioOffsetFrames > 0)
+            writeValueField(seg, kSegmentAudioOffset, static_cast<juce::int32>(s.audioOffsetFrames));
+        if (s.loopTake > 0)
+            writeValueField(seg, kSegmentLoopTake, static_cast<juce::int32>(s.loopTake));
+        if (s.soundEndFrame >= 0)
+        {
+            writeValueField(seg, kSegmentSoundStart, static_cast<juce::int32>(s.soundStartFrame));
+            writeValueField(seg, kSegmentSoundEnd, static_cast<juce::int32>(s.soundEndFrame));
+        }
+        if (s.numChannels != 2 || s.sidechainChannels > 0)
+        {
+            writeValueField(seg, kSegmentNumChannels, static_cast<juce::int32>(s.numChannels));
+            writeValueField(seg, kSegmentSidechainChannels, static_cast<juce::int32>(s.sidechainChannels));
+        }
+        if (s.channelLayout.isNotEmpty())
+            writeStringField(seg, kSegmentChannelLayout, s.channelLayout);
+        if (s.inlineAudio.getSize() > 0)
+            writeField(seg, kSegmentInlineAudio, s.inlineAudio.getData(), s.inlineAudio.getSize());
+        if (s.position.getSize() > 0)
+            writeField(seg, kSegmentPosition, s.position.getData(), s.position.getSize());
+        writeField(out, kFieldSegment, seg.getData(), seg.getDataSize());
+    }
+}
+
+bool PluginState::read(const void* data, size_t size)
+{
+    *this = {};
+    auto* p = static_cast<const juce::uint8*>(data);
+    if (p == nullptr || size == 0)
+        return false;
+    if (size < kHeaderSize || std::memcmp(p, kMagic, sizeof(kMagic)) != 0)
+    {
+        // Unversioned state: just the API key, as written by MemoryOutputStream::writeString
+        juce::MemoryInputStream stream(data, size, false);
+        apiKey = stream.readString();
+        return true;
+    }
+    if (juce::ByteOrder::littleEndianInt(p + sizeof(kMagic)) > kFormatVersion)
+        return false;
+
+    return forEachField(p + kHeaderSize, size - kHeaderSize, [this](juce::uint8 id, const juce::uint8* v, juce::uint32 length)
+    {
+        juce::int32 i32 = 0;
+        switch (id)
+        {
+        case kFieldApiKey: apiKey = readText(v, length); break;
+        case kFieldSelectedSegment: if (readValue(v, length, i32)) selectedSegment = i32; break;
+        case kFieldPreRollSeconds: readValue(v, length, preRollSeconds); break;
+        case kFieldSegment:
+        {
+            Segment s;
+            const bool complete = forEachField(v, length, [&s](juce::uint8 segId, const juce::uint8* sv, juce::uint32 segLength)
+            {
+                juce::int32 value = 0;
+                switch (segId)
+                {
+                case kSegmentSampleRate: readValue(sv, segLength, s.sampleRate); break;
+                case kSegmentNumFrames: if (readValue(sv, segLength, value)) s.numFrames = value; break;
+                case kSegmentTrimStart: if (readValue(sv, segLength, value)) s.trimStartSamples = value; break;
+                case kSegmentTrimEnd: if (readValue(sv, segLength, value)) s.trimEndSamples = value; break;
+                case kSegmentAudioKey: s.audioKey = readText(sv, segLength); break;
+                case kSegmentInlineAudio: s.inlineAudio.replaceAll(sv, segLength); break;
+                case kSegmentPosition: s.position.replaceAll(sv, segLength); break;
+                case kSegmentAudioOffset: if (readValue(sv, segLength, value)) s.audioOffsetFrames = juce::jmax(0, value); break;
+                case kSegmentLoopTake: if (readValue(sv, segLength, value)) s.loopTake = value; break;
+                case kSegmentSoundStart: if (readValue(sv, segLength, value)) s.soundStartFrame = value; break;
+                case kSegmentSoundEnd: if (readValue(sv, segLength, value)) s.soundEndFrame = value; break;
+                case kSegmentNumChannels: if (readValue(sv, segLength, value)) s.numChannels = value; break;
+                case kSegmentSidechainChannels: if (readValue(sv, segLength, value)) s.sidechainChannels = value; break;
+                case kSegmentChannelLayout: s.channelLayout = readText(sv, segLength); break;
+                default: break; // field from a newer build
+                }
+            });
+            if (complete && s.numFrames > 0 && s.sampleRate > 0.0)
+                segments.push_back(std::move(s));
+            break;
+        }
+        default: break; // field from a newer build
+        }
+    });
+}
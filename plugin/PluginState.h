@@ -0,0 +1,47 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <vector>
+
+/**
+ * The plugin's saved state (getStateInformation / setStateInformation).
+ *
+ * Layout (little endian):
+ *   header  : "AFSSTATE" magic, uint32 format version
+ *   fields  : repeated { uint8 field id, uint32 length, bytes }
+ * A segment field holds its own nested fields. Segment audio is a SegmentStore
+ * sidecar key or, when no sidecar has been written, an inline pack() chunk.
+ * Unknown field ids are skipped, so new fields do not need a version bump.
+ * State saved before versioning (a bare API key string) still loads.
+ */
+struct PluginState
+{
+    static constexpr juce::uint32 kFormatVersion = 1;
+
+    struct Segment
+    {
+        double sampleRate = 44100.0;
+        int numFrames = 0;
+        int trimStartSamples = 0;
+        int trimEndSamples = 0;
+        int audioOffsetFrames = 0;      // first frame within the sidecar (loop takes share one)
+        int loopTake = 0;
+        int soundStartFrame = 0;
+        int soundEndFrame = -1;         // -1 = not stored
+        int numChannels = 2;            // main input channels, then sidechain ones
+        int sidechainChannels = 0;
+        juce::String channelLayout;     // main input speaker arrangement; empty = stereo
+        juce::String audioKey;          // SegmentStore sidecar
+        juce::MemoryBlock inlineAudio;  // SegmentStore::pack() chunk when there is no sidecar
+        juce::MemoryBlock position;     // MusicalPosition::toMemoryBlock(); empty if unknown
+    };
+
+    juce::String apiKey;
+    int selectedSegment = -1;
+    float preRollSeconds = -1.0f;   // -1 = not stored
+    std::vector<Segment> segments;
+
+    void write(juce::MemoryBlock& dest) const;
+    /** False if data is neither this format nor a legacy API key string. */
+    bool read(const void* data, size_t size);
+};
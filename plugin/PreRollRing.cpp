@@ -0,0 +1,58 @@
+#include "PreRollRing.h"
+#include <algorithm>
+#include <cstring>
+
+void PreRollRing::setCapacity(int numChannels, int frames)
+{
+    numChannels_ = std::max(0, numChannels);
+    capacity_ = numChannels_ > 0 ? std::max(0, frames) : 0;
+    samples_.assign(static_cast<size_t>(numChannels_) * static_cast<size_t>(capacity_), 0.0f);
+    writePos_ = 0;
+    filled_ = 0;
+    frozen_.store(false, std::memory_order_release);
+}
+
+void PreRollRing::write(const float* const* channels, int numFrames)
+{
+    if (capacity_ == 0 || isFrozen())
+        return;
+    // Only the newest capacity_ frames of a long block can survive
+    const int skip = std::max(0, numFrames - capacity_);
+    numFrames -= skip;
+    const int first = std::min(numFrames, capacity_ - writePos_);
+    for (int c = 0; c < numChannels_; ++c)
+    {
+        float* row = samples_.data() + static_cast<size_t>(c) * static_cast<size_t>(capacity_);
+        if (channels[c] == nullptr)
+        {
+            std::memset(row + writePos_, 0, static_cast<size_t>(first) * sizeof(float));
+            std::memset(row, 0, static_cast<size_t>(numFrames - first) * sizeof(float));
+            continue;
+        }
+        const float* src = channels[c] + skip;
+        std::memcpy(row + writePos_, src, static_cast<size_t>(first) * sizeof(float));
+        std::memcpy(row, src + first, static_cast<size_t>(numFrames - first) * sizeof(float));
+    }
+    writePos_ = (writePos_ + numFrames) % capacity_;
+    filled_ = std::min(capacity_, filled_ + numFrames);
+}
+
+SegmentAudio PreRollRing::take(int maxFrames)
+{
+    if (!isFrozen())
+        return {};
+    const int frames = std::min(std::max(0, maxFrames), filled_);
+    SegmentAudio out(numChannels_, frames);
+    const int start = (writePos_ - frames + capacity_) % std::max(1, capacity_);
+    const int first = std::min(frames, capacity_ - start);
+    for (int c = 0; c < numChannels_; ++c)
+    {
+        const float* row = samples_.data() + static_cast<size_t>(c) * static_cast<size_t>(capacity_);
+        std::memcpy(out.getWritePointer(c), row + start, static_cast<size_t>(first) * sizeof(float));
+        std::memcpy(out.getWritePointer(c, first), row, static_cast<size_t>(frames - first) * sizeof(float));
+    }
+    writePos_ = 0;
+    filled_ = 0;
+    frozen_.store(false, std::memory_order_release);
+    return out;
+}
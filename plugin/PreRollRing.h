@@ -0,0 +1,42 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <vector>
+#include "SegmentAudio.h"
+
+/**
+ * Input history for capture pre-roll. While the transport is stopped the
+ * audio thread appends every block (one memcpy per channel, two at the wrap).
+ * On transport start it freezes the ring; the message thread then copies out
+ * the newest frames for the new segment and thaws it, empty, for the next
+ * stop. Planar, one row per captured channel; storage is only (re)allocated
+ * by setCapacity(), which must not run concurrently with write() (the
+ * processor holds its callback lock), so the audio thread never allocates.
+ */
+class PreRollRing
+{
+public:
+    /** Drops the history. 0 frames or channels turns the ring off. */
+    void setCapacity(int numChannels, int frames);
+    int getCapacity() const { return capacity_; }
+    int getNumChannels() const { return numChannels_; }
+
+    /** Audio thread; ignored while frozen. One pointer per channel; nullptr records silence. */
+    void write(const float* const* channels, int numFrames);
+    /** Audio thread: keeps the current history for take(). */
+    void freeze() { frozen_.store(true, std::memory_order_release); }
+    bool isFrozen() const { return frozen_.load(std::memory_order_acquire); }
+
+    /** While frozen: the newest min(maxFrames, available) frames, oldest first (two copies per
+        channel). Thaws the ring empty. */
+    SegmentAudio take(int maxFrames);
+
+private:
+    std::vector<float> samples_;   // numChannels_ rows of capacity_ frames
+    int numChannels_ = 0;
+    int capacity_ = 0;
+    int writePos_ = 0;   // written by the audio thread only while thawed
+    int filled_ = 0;
+    std::atomic<bool> frozen_{ false };
+};
@@ -0,0 +1,150 @@
+#include "SampleKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr int kBlockFrames = 256;   // dither / conversion scratch, on the stack
+
+juce::uint32 nextRandom(juce::uint32& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Sum of two uniform values in [-0.5, 0.5): triangular over (-1, 1) LSB
+void fillDither(float* dest, int n, juce::uint32& state)
+{
+    constexpr float kScale = 1.0f / 4294967296.0f;
+    for (int i = 0; i < n; ++i)
+    {
+        const auto a = static_cast<float>(static_cast<juce::int32>(nextRandom(state)));
+        const auto b = static_cast<float>(static_cast<juce::int32>(nextRandom(state)));
+        dest[i] = (a + b) * kScale;
+    }
+}
+} // namespace
+
+void SampleKernels::interleave(const float* const* channels, int numChannels, int numFrames, float* dest)
+{
+    if (numChannels == 1)
+    {
+        if (channels[0] != nullptr)
+            std::memcpy(dest, channels[0], static_cast<size_t>(numFrames) * sizeof(float));
+        else
+            std::memset(dest, 0, static_cast<size_t>(numFrames) * sizeof(float));
+        return;
+    }
+    if (numChannels == 2 && channels[0] != nullptr && channels[1] != nullptr)
+    {
+        const float* left = channels[0];
+        const float* right = channels[1];
+        for (int i = 0; i < numFrames; ++i)
+        {
+            dest[2 * i] = left[i];
+            dest[2 * i + 1] = right[i];
+        }
+        return;
+    }
+    const auto stride = static_cast<size_t>(numChannels);
+    for (int c = 0; c < numChannels; ++c)
+    {
+        float* out = dest + c;
+        if (const float* src = channels[c])
+            for (int i = 0; i < numFrames; ++i)
+                out[static_cast<size_t>(i) * stride] = src[i];
+        else
+            for (int i = 0; i < numFrames; ++i)
+                out[static_cast<size_t>(i) * stride] = 0.0f;
+    }
+}
+
+void SampleKernels::deinterleave(const float* src, int numChannels, int numFrames, float* const* channels)
+{
+    if (numChannels == 1)
+    {
+        std::memcpy(channels[0], src, static_cast<size_t>(numFrames) * sizeof(float));
+        return;
+    }
+    if (numChannels == 2)
+    {
+        float* left = channels[0];
+        float* right = channels[1];
+        for (int i = 0; i < numFrames; ++i)
+        {
+            left[i] = src[2 * i];
+            right[i] = src[2 * i + 1];
+        }
+        return;
+    }
+    const auto stride = static_cast<size_t>(numChannels);
+    for (int c = 0; c < numChannels; ++c)
+    {
+        const float* in = src + c;
+        float* out = channels[c];
+        for (int i = 0; i < numFrames; ++i)
+            out[i] = in[static_cast<size_t>(i) * stride];
+    }
+}
+
+void SampleKernels::mixMatrix(const float* const* src, int numSrc, float* const* dest, int numDest, const float* gains,
+                              int numFrames)
+{
+    for (int o = 0; o < numDest; ++o)
+    {
+        bool written = false;
+        for (int s = 0; s < numSrc; ++s)
+        {
+            const float gain = gains[s * numDest + o];
+            if (gain == 0.0f || src[s] == nullptr)
+                continue;
+            if (written)
+                juce::FloatVectorOperations::addWithMultiply(dest[o], src[s], gain, numFrames);
+            else
+                juce::FloatVectorOperations::copyWithMultiply(dest[o], src[s], gain, numFrames);
+            written = true;
+        }
+        if (!written)
+            juce::FloatVectorOperations::clear(dest[o], numFrames);
+    }
+}
+
+void SampleKernels::toPcm(const float* const* channels, int numChannels, int numFrames, int bitsPerSample, void* dest,
+                          Dither& dither)
+{
+    const int bytesPerSample = bitsPerSample / 8;
+    const auto scale = static_cast<float>(1 << (bitsPerSample - 1));
+    const float maxValue = scale - 1.0f;
+    float noise[kBlockFrames];
+    float scaled[kBlockFrames];
+    juce::int32 quantised[kBlockFrames];
+    auto* out = static_cast<juce::uint8*>(dest);
+    const auto frameBytes = static_cast<size_t>(numChannels * bytesPerSample);
+
+    for (int done = 0; done < numFrames; done += kBlockFrames)
+    {
+        const int n = std::min(kBlockFrames, numFrames - done);
+        for (int c = 0; c < numChannels; ++c)
+        {
+            fillDither(noise, n, dither.state);
+            if (const float* src = channels[c])
+                for (int i = 0; i < n; ++i)
+                    scaled[i] = src[done + i] * scale + noise[i];
+            else
+                std::memcpy(scaled, noise, static_cast<size_t>(n) * sizeof(float));
+            for (int i = 0; i < n; ++i)
+                quantised[i] = static_cast<juce::int32>(std::floor(std::min(maxValue, std::max(-scale, scaled[i])) + 0.5f));
+
+            juce::uint8* sample = out + static_cast<size_t>(done) * frameBytes + static_cast<size_t>(c * bytesPerSample);
+            for (int i = 0; i < n; ++i, sample += frameBytes)
+            {
+                const auto bits = static_cast<juce::uint32>(quantised[i]);
+                for (int b = 0; b < bytesPerSample; ++b)
+                    sample[b] = static_cast<juce::uint8>(bits >> (8 * b));
+            }
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+/**
+ * Sample loops shared by capture, segment storage, upload encoding and result
+ * playback. Each kernel walks contiguous rows with a fixed stride and no
+ * per-sample branches, so the compiler vectorises it (stereo and mono have
+ * their own unit-stride paths); gains use FloatVectorOperations. A channel
+ * pointer of nullptr stands for silence wherever channels are read.
+ * Stateless and allocation-free: safe on the audio thread.
+ */
+class SampleKernels
+{
+public:
+    /** dest[i * numChannels + c] = channels[c][i] */
+    static void interleave(const float* const* channels, int numChannels, int numFrames, float* dest);
+    /** channels[c][i] = src[i * numChannels + c] */
+    static void deinterleave(const float* src, int numChannels, int numFrames, float* const* channels);
+
+    /** dest[o] = sum over s of gains[s * numDest + o] * src[s]; rows without a gain are cleared. */
+    static void mixMatrix(const float* const* src, int numSrc, float* const* dest, int numDest, const float* gains,
+                          int numFrames);
+
+    /** Triangular dither of +-1 LSB; one per stream so repeated encodes give the same bytes. */
+    struct Dither
+    {
+        juce::uint32 state = 0x9e3779b9u;
+    };
+
+    /** Interleaved little-endian signed PCM (16 or 24 bits), dithered, rounded and clipped. */
+    static void toPcm(const float* const* channels, int numChannels, int numFrames, int bitsPerSample, void* dest,
+                      Dither& dither);
+};
@@ -0,0 +1,108 @@
+#include "SegmentAudio.h"
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+SegmentAudio::SegmentAudio(int numChannels, int numFrames)
+    : numChannels_(std::max(0, numChannels)), numFrames_(std::max(0, numFrames))
+{
+    constexpr size_t floatsPerAlignment = kAlignment / sizeof(float);
+    rowFloats_ = (static_cast<size_t>(numFrames_) + floatsPerAlignment - 1) / floatsPerAlignment * floatsPerAlignment;
+    storage_.malloc(getSizeInBytes() + kAlignment);
+    const auto address = reinterpret_cast<std::uintptr_t>(storage_.get());
+    data_ = reinterpret_cast<float*>((address + kAlignment - 1) & ~static_cast<std::uintptr_t>(kAlignment - 1));
+}
+
+SegmentAudio::SegmentAudio(SegmentAudio&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+SegmentAudio& SegmentAudio::operator=(SegmentAudio&& other) noexcept
+{
+    std::swap(storage_, other.storage_);
+    std::swap(data_, other.data_);
+    std::swap(rowFloats_, other.rowFloats_);
+    std::swap(numChannels_, other.numChannels_);
+    std::swap(numFrames_, other.numFrames_);
+    other.storage_.free();
+    other.data_ = nullptr;
+    other.rowFloats_ = 0;
+    other.numChannels_ = 0;
+    other.numFrames_ = 0;
+    return *this;
+}
+
+void CaptureBuffer::reset(int numChannels)
+{
+    numChannels_ = numChannels;
+    numFrames_ = 0;
+}
+
+void CaptureBuffer::clear()
+{
+    blocks_.clear();
+    numFrames_ = 0;
+}
+
+int CaptureBuffer::append(const float* const* channels, int numFrames)
+{
+    if (blockChannels_ != numChannels_)
+        return numFrames;
+    int done = 0;
+    while (done < numFrames)
+    {
+        const auto block = static_cast<size_t>(numFrames_ / kBlockFrames);
+        const int offset = static_cast<int>(numFrames_ % kBlockFrames);
+        if (block == blocks_.size())
+            break;
+        const int n = std::min(numFrames - done, kBlockFrames - offset);
+        for (int c = 0; c < numChannels_; ++c)
+        {
+            float* dest = blocks_[block]->getWritePointer(c, offset);
+            if (channels[c] != nullptr)
+                juce::FloatVectorOperations::copy(dest, channels[c] + done, n);
+            else
+                juce::FloatVectorOperations::clear(dest, n);
+        }
+        done += n;
+        numFrames_ += n;
+    }
+    return numFrames - done;
+}
+
+int CaptureBuffer::getNumFreeBlocks() const
+{
+    if (blockChannels_ != numChannels_)
+        return 0;
+    return static_cast<int>(static_cast<juce::int64>(blocks_.size()) - numFrames_ / kBlockFrames);
+}
+
+std::unique_ptr<SegmentAudio> CaptureBuffer::makeBlock(int numChannels)
+{
+    return std::make_unique<SegmentAudio>(numChannels, kBlockFrames);
+}
+
+void CaptureBuffer::addBlocks(std::vector<std::unique_ptr<SegmentAudio>>& blocks)
+{
+    std::vector<std::unique_ptr<SegmentAudio>> stale;
+    if (blockChannels_ != numChannels_) // append() never wrote to them
+    {
+        std::swap(stale, blocks_);
+        blockChannels_ = numChannels_;
+    }
+    for (auto& block : blocks)
+        blocks_.push_back(std::move(block));
+    blocks = std::move(stale);
+}
+
+void CaptureBuffer::copyTo(SegmentAudio& dest, int destFrame) const
+{
+    for (juce::int64 from = 0; from < numFrames_; from += kBlockFrames)
+    {
+        const auto& block = *blocks_[static_cast<size_t>(from / kBlockFrames)];
+        const int n = static_cast<int>(std::min<juce::int64>(kBlockFrames, numFrames_ - from));
+        for (int c = 0; c < numChannels_; ++c)
+            juce::FloatVectorOperations::copy(dest.getWritePointer(c, destFrame + static_cast<int>(from)), block.getReadPointer(c), n);
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <memory>
+#include <vector>
+
+/**
+ * Planar float audio of a recorded segment in one allocation. Every channel
+ * row starts on a kAlignment boundary (rows are padded to a multiple of it),
+ * so per-channel loops and FloatVectorOperations run on whole aligned rows
+ * and a channel's frames are always contiguous. Shared immutable once built
+ * (std::shared_ptr<const SegmentAudio>).
+ */
+class SegmentAudio
+{
+public:
+    static constexpr size_t kAlignment = 64;   // bytes: a cache line, covers every SIMD width
+
+    SegmentAudio() = default;
+    /** Uninitialised rows. */
+    SegmentAudio(int numChannels, int numFrames);
+    /** Leaves other empty. */
+    SegmentAudio(SegmentAudio&& other) noexcept;
+    SegmentAudio& operator=(SegmentAudio&& other) noexcept;
+
+    int getNumChannels() const { return numChannels_; }
+    int getNumFrames() const { return numFrames_; }
+    size_t getSizeInBytes() const { return static_cast<size_t>(numChannels_) * rowFloats_ * sizeof(float); }
+
+    const float* getReadPointer(int channel, int frame = 0) const
+    {
+        return data_ + static_cast<size_t>(channel) * rowFloats_ + static_cast<size_t>(frame);
+    }
+    float* getWritePointer(int channel, int frame = 0)
+    {
+        return data_ + static_cast<size_t>(channel) * rowFloats_ + static_cast<size_t>(frame);
+    }
+    /** dest[c] = getReadPointer(c, frame) for every channel. */
+    void getReadPointers(const float** dest, int frame = 0) const
+    {
+        for (int c = 0; c < numChannels_; ++c)
+            dest[c] = getReadPointer(c, frame);
+    }
+
+private:
+    juce::HeapBlock<char> storage_;
+    float* data_ = nullptr;   // storage_ rounded up to kAlignment
+    size_t rowFloats_ = 0;
+    int numChannels_ = 0;
+    int numFrames_ = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(SegmentAudio)
+};
+
+/**
+ * The growing audio of a running capture: planar SegmentAudio blocks of
+ * kBlockFrames. The audio thread appends with one copy per channel into
+ * blocks that are already there; it never allocates, frees or moves what it
+ * has recorded. Blocks come from addBlocks() off the audio thread, which the
+ * owner calls to keep a few free ahead of the capture. reset() keeps the
+ * blocks, so a buffer that is recycled after its capture was committed
+ * records the next one from them.
+ */
+class CaptureBuffer
+{
+public:
+    static constexpr int kBlockFrames = 1 << 15;
+
+    /** Empties the buffer for numChannels. Blocks of another width stay in place, unused, until
+        addBlocks() swaps them out, so this is safe on the audio thread. */
+    void reset(int numChannels);
+    /** Frees every block. */
+    void clear();
+    /** Audio thread. One pointer per channel; nullptr records silence. Frames beyond the free
+        blocks are dropped; returns how many. */
+    int append(const float* const* channels, int numFrames);
+
+    /** Blocks of the current width not yet full, the one being filled included. */
+    int getNumFreeBlocks() const;
+    /** A block for a buffer of numChannels; allocates, so never on the audio thread. */
+    static std::unique_ptr<SegmentAudio> makeBlock(int numChannels);
+    /** Takes blocks (made for getNumChannels()). Blocks of an older width come back in blocks,
+        for the caller to free after its lock. */
+    void addBlocks(std::vector<std::unique_ptr<SegmentAudio>>& blocks);
+
+    int getNumChannels() const { return numChannels_; }
+    juce::int64 getNumFrames() const { return numFrames_; }
+    bool hasStorage() const { return !blocks_.empty(); }
+    size_t getSizeInBytes() const { return blocks_.empty() ? 0 : blocks_.size() * blocks_.front()->getSizeInBytes(); }
+
+    /** Copies every recorded frame into dest from destFrame on (same channel count). */
+    void copyTo(SegmentAudio& dest, int destFrame) const;
+
+private:
+    std::vector<std::unique_ptr<SegmentAudio>> blocks_;
+    int blockChannels_ = 0;   // width of blocks_; unusable while it differs from numChannels_
+    int numChannels_ = 0;
+    juce::int64 numFrames_ = 0;
+};
@@ -0,0 +1,176 @@
+#include "SegmentSlicer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+constexpr float kSilenceDb = -60.0f;
+constexpr float kMaxOnsetDb = 20.0f;         // a start out of silence counts like a strong hit
+constexpr int kStrengthRadiusHops = 2;       // bar lines may sit a few ms off the hit
+constexpr float kEndWeight = 0.5f;
+constexpr float kPhraseBonus = 0.5f;
+constexpr float kSilentStartPenalty = 2.0f;
+constexpr double kMinBpm = 30.0;
+constexpr double kMaxBpm = 300.0;
+constexpr size_t kMaxBars = 4096;
+
+struct Envelope
+{
+    std::vector<float> onset;      // positive change of log energy per hop, dB
+    std::vector<float> energyDb;
+    float mean = 0.0f;
+    float deviation = 1.0f;
+};
+
+// Mono mix, first difference (a cheap high-pass that favours attacks), energy per hop
+Envelope buildEnvelope(const float* const* channels, int numChannels, int numFrames)
+{
+    constexpr int hop = SegmentSlicer::kHopFrames;
+    const int numHops = numFrames / hop;
+    Envelope env;
+    env.onset.resize(static_cast<size_t>(numHops));
+    env.energyDb.resize(static_cast<size_t>(numHops));
+    float mono[hop + 1] = {};   // [0] is the last sample of the previous hop
+    float diff[hop];
+    const float gain = 1.0f / static_cast<float>(numChannels);
+    float previousDb = kSilenceDb;
+    for (int h = 0; h < numHops; ++h)
+    {
+        const int first = h * hop;
+        juce::FloatVectorOperations::copyWithMultiply(mono + 1, channels[0] + first, gain, hop);
+        for (int c = 1; c < numChannels; ++c)
+            juce::FloatVectorOperations::addWithMultiply(mono + 1, channels[c] + first, gain, hop);
+        juce::FloatVectorOperations::subtract(diff, mono + 1, mono, hop);
+        juce::FloatVectorOperations::multiply(diff, diff, hop);
+        // Four partial sums so the reduction vectorises
+        float acc[4] = {};
+        for (int i = 0; i < hop; i += 4)
+            for (int k = 0; k < 4; ++k)
+                acc[k] += diff[i + k];
+        mono[0] = mono[hop];
+
+        const float db = std::max(kSilenceDb, 10.0f * std::log10((acc[0] + acc[1] + acc[2] + acc[3]) / hop + 1.0e-12f));
+        env.energyDb[static_cast<size_t>(h)] = db;
+        env.onset[static_cast<size_t>(h)] = std::min(kMaxOnsetDb, std::max(0.0f, db - previousDb));
+        previousDb = db;
+    }
+
+    if (numHops > 0)
+    {
+        double sum = 0.0, sumSquares = 0.0;
+        for (float v : env.onset)
+        {
+            sum += v;
+            sumSquares += static_cast<double>(v) * v;
+        }
+        env.mean = static_cast<float>(sum / numHops);
+        env.deviation = static_cast<float>(std::sqrt(std::max(0.0, sumSquares / numHops - static_cast<double>(env.mean) * env.mean)));
+        env.deviation = std::max(env.deviation, 0.1f);
+    }
+    return env;
+}
+
+// Standardised onset strength around frame
+float strengthAt(const Envelope& env, double frame)
+{
+    const int centre = static_cast<int>(std::lround(frame / SegmentSlicer::kHopFrames));
+    const int n = static_cast<int>(env.onset.size());
+    float best = 0.0f;
+    for (int h = std::max(0, centre - kStrengthRadiusHops); h <= std::min(n - 1, centre + kStrengthRadiusHops); ++h)
+        best = std::max(best, env.onset[static_cast<size_t>(h)]);
+    return (best - env.mean) / env.deviation;
+}
+
+bool isSilentFrom(const Envelope& env, double frame, double framesPerBeat)
+{
+    const int first = static_cast<int>(frame / SegmentSlicer::kHopFrames);
+    const int last = std::min(static_cast<int>(env.energyDb.size()),
+                              static_cast<int>((frame + framesPerBeat) / SegmentSlicer::kHopFrames));
+    for (int h = std::max(0, first); h < last; ++h)
+        if (env.energyDb[static_cast<size_t>(h)] > kSilenceDb + 10.0f)
+            return false;
+    return true;
+}
+} // namespace
+
+std::vector<SegmentSlicer::Region> SegmentSlicer::propose(const float* const* channels, int numChannels, int numFrames,
+                                                          double sampleRate, const MusicalPosition& position,
+                                                          double fallbackBpm)
+{
+    if (channels == nullptr || numChannels <= 0 || numFrames < kHopFrames || sampleRate <= 0.0)
+        return {};
+    const Envelope env = buildEnvelope(channels, numChannels, numFrames);
+
+    // Bar lines inside the segment
+    std::vector<double> barFrames;
+    int firstBar = 1;
+    bool hostBars = false;
+    double framesPerBeat = 0.0;
+    if (position.valid && position.hasPpq && position.bpm > 0.0)
+    {
+        const double perBar = position.timeSigNumerator * 4.0 / position.timeSigDenominator;
+        const auto first = static_cast<int>(std::ceil((position.ppq - position.ppqOfBarStart) / perBar - 1.0e-6));
+        for (int k = first; barFrames.size() < kMaxBars; ++k)
+        {
+            const double frame = position.frameAtPpq(position.ppqOfBarStart + k * perBar, sampleRate);
+            if (frame > numFrames + kHopFrames)
+                break;
+            barFrames.push_back(std::max(0.0, frame));
+        }
+        firstBar = position.bar + first;
+        hostBars = true;
+        framesPerBeat = 60.0 / position.bpm * sampleRate * 4.0 / position.timeSigDenominator;
+    }
+    else if (fallbackBpm >= kMinBpm && fallbackBpm <= kMaxBpm)
+    {
+        framesPerBeat = 60.0 / fallbackBpm * sampleRate;
+        const double barLength = 4.0 * framesPerBeat;
+        const int anchorHops = std::min(static_cast<int>(env.onset.size()), static_cast<int>(barLength / kHopFrames));
+        int anchor = 0;
+        for (int h = 1; h < anchorHops; ++h)
+            if (env.onset[static_cast<size_t>(h)] > env.onset[static_cast<size_t>(anchor)])
+                anchor = h;
+        for (double frame = static_cast<double>(anchor) * kHopFrames; frame <= numFrames + kHopFrames && barFrames.size() < kMaxBars;
+             frame += barLength)
+            barFrames.push_back(frame);
+    }
+
+    std::vector<Region> regions;
+    for (int bars : kBarCounts)
+    {
+        Region best;
+        float bestScore = -1.0e9f;
+        for (size_t i = 0; i + static_cast<size_t>(bars) < barFrames.size(); ++i)
+        {
+            const double start = barFrames[i];
+            const double end = barFrames[i + static_cast<size_t>(bars)];
+            const int bar = firstBar + static_cast<int>(i);
+            float score = strengthAt(env, start);
+            if (end < numFrames - kHopFrames)
+                score += kEndWeight * strengthAt(env, end);
+            if (((bar - 1) % 4 + 4) % 4 == 0)
+                score += kPhraseBonus;
+            if (isSilentFrom(env, start, framesPerBeat))
+                score -= kSilentStartPenalty;
+            if (score > bestScore)
+            {
+                bestScore = score;
+                best.startFrame = static_cast<int>(std::lround(start));
+                best.endFrame = std::min(numFrames, static_cast<int>(std::lround(end)));
+                best.bars = bars;
+                best.startBar = bar;
+                best.hostBars = hostBars;
+                best.score = score;
+            }
+        }
+        if (best.bars > 0)
+            regions.push_back(best);
+    }
+    std::sort(regions.begin(), regions.end(), [](const Region& a, const Region& b) { return a.score > b.score; });
+    return regions;
+}
+
+juce::String SegmentSlicer::describe(const Region& region)
+{
+    return juce::String(region.bars) + " bars from " + (region.hostBars ? "bar " : "segment bar ") + juce::String(region.startBar);
+}
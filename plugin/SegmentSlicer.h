@@ -0,0 +1,42 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <vector>
+#include "MusicalPosition.h"
+
+/**
+ * Proposes bar-aligned regions of a recorded segment (kBarCounts bars each)
+ * as trim candidates for Cover / Add Vocals.
+ *
+ * Bar lines come from the segment's MusicalPosition (PPQ and tempo map). When
+ * the host gave no PPQ, a grid of 4/4 bars at fallbackBpm is anchored at the
+ * strongest onset of the first bar. One pass over the audio builds an onset
+ * envelope (high-passed energy per kHopFrames, positive log-energy change);
+ * each candidate is scored by the onsets at its start and end bar lines, a
+ * bonus for starting on a 4-bar phrase, and a penalty for a silent start.
+ * The best region per bar count is returned, best first.
+ * Stateless; O(audio) once plus O(bars) per length: call off the message thread.
+ */
+class SegmentSlicer
+{
+public:
+    struct Region
+    {
+        int startFrame = 0;
+        int endFrame = 0;     // exclusive
+        int bars = 0;
+        int startBar = 1;     // host bar number, or counted from the segment start without PPQ
+        bool hostBars = false;
+        float score = 0.0f;
+    };
+
+    static constexpr int kHopFrames = 256;
+    static constexpr int kBarCounts[] = { 4, 8, 16, 32 };
+
+    /** channels: numChannels planar rows of numFrames. */
+    static std::vector<Region> propose(const float* const* channels, int numChannels, int numFrames, double sampleRate,
+                                       const MusicalPosition& position, double fallbackBpm);
+
+    /** "8 bars from bar 17" */
+    static juce::String describe(const Region& region);
+};
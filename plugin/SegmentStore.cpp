@@ -0,0 +1,282 @@
+#include "SegmentStore.h"
+#include "BlobStore.h"
+#include "SampleKernels.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+const char kMagic[4] = { 'A', 'F', 'S', 'A' };
+constexpr size_t kHeaderSize = 12;   // magic, uint8 codec, uint8 channels, uint16 reserved, uint32 frames
+constexpr juce::uint8 kCodecPlanarDeflate = 1;
+constexpr size_t kChunkFloats = 1 << 16;
+constexpr int kStageFrames = 4096;
+constexpr int kCompressionLevel = 6;
+
+// Byte b of every float goes to plane b
+void splitPlanes(const float* src, size_t n, juce::uint8* planes)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        juce::uint32 bits;
+        std::memcpy(&bits, src + i, sizeof(bits));
+        for (size_t b = 0; b < sizeof(bits); ++b)
+            planes[b * n + i] = static_cast<juce::uint8>(bits >> (8 * b));
+    }
+}
+
+void joinPlanes(const juce::uint8* planes, size_t n, float* dest)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        juce::uint32 bits = 0;
+        for (size_t b = 0; b < sizeof(bits); ++b)
+            bits |= static_cast<juce::uint32>(planes[b * n + i]) << (8 * b);
+        std::memcpy(dest + i, &bits, sizeof(bits));
+    }
+}
+} // namespace
+
+juce::File SegmentStore::getDirectory()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("AceForgeSuno")
+        .getChildFile("Segments");
+}
+
+juce::File SegmentStore::getSidecarFile(const juce::String& key)
+{
+    return getDirectory().getChildFile(key + ".afsa");
+}
+
+// Interleaves a few thousand frames at a time into the stream and deflates every full chunk
+bool SegmentStore::ChunkQueue::write(juce::OutputStream& out, const float* const* channels, int numChannels, int numFrames)
+{
+    const auto stride = static_cast<size_t>(numChannels);
+    stage.resize(static_cast<size_t>(kStageFrames) * stride);
+    chunk.reserve(kChunkFloats);
+    std::vector<const float*> rows(channels, channels + numChannels);
+    for (int done = 0; done < numFrames; done += kStageFrames)
+    {
+        const int n = std::min(kStageFrames, numFrames - done);
+        SampleKernels::interleave(rows.data(), numChannels, n, stage.data());
+        for (auto& row : rows)
+            if (row != nullptr)
+                row += n;
+        const float* src = stage.data();
+        size_t remaining = static_cast<size_t>(n) * stride;
+        while (remaining > 0)
+        {
+            const size_t take = std::min(remaining, kChunkFloats - chunk.size());
+            chunk.insert(chunk.end(), src, src + take);
+            src += take;
+            remaining -= take;
+            if (chunk.size() == kChunkFloats && !flush(out))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool SegmentStore::ChunkQueue::flush(juce::OutputStream& out)
+{
+    if (chunk.empty())
+        return true;
+    planes.resize(chunk.size() * sizeof(float));
+    splitPlanes(chunk.data(), chunk.size(), planes.data());
+    const bool ok = out.write(planes.data(), planes.size());
+    chunk.clear();
+    return ok;
+}
+
+juce::MemoryBlock SegmentStore::pack(const float* const* channels, int numChannels, int numFrames)
+{
+    juce::MemoryBlock packed;
+    {
+        juce::MemoryOutputStream out(packed, false);
+        out.write(kMagic, sizeof(kMagic));
+        out.writeByte(static_cast<char>(kCodecPlanarDeflate));
+        out.writeByte(static_cast<char>(numChannels));
+        out.writeShort(0);
+        out.writeInt(numFrames);
+
+        juce::GZIPCompressorOutputStream deflate(out, kCompressionLevel);
+        ChunkQueue queue;
+        queue.write(deflate, channels, numChannels, std::max(0, numFrames));
+        queue.flush(deflate);
+        deflate.flush();
+    }
+    return packed;
+}
+
+// Chunks end anywhere in a frame: the floats of a split frame wait at the front of the buffer
+bool SegmentStore::unpack(const void* data, size_t size, SegmentAudio& audio)
+{
+    auto* p = static_cast<const juce::uint8*>(data);
+    if (p == nullptr || size < kHeaderSize || std::memcmp(p, kMagic, sizeof(kMagic)) != 0 || p[4] != kCodecPlanarDeflate)
+        return false;
+    const int numChannels = p[5];
+    const int numFrames = static_cast<int>(juce::ByteOrder::littleEndianInt(p + 8));
+    if (numChannels <= 0 || numFrames < 0)
+        return false;
+
+    juce::MemoryInputStream source(p + kHeaderSize, size - kHeaderSize, false);
+    juce::GZIPDecompressorInputStream inflate(source);
+    SegmentAudio decoded(numChannels, numFrames);
+    const auto stride = static_cast<size_t>(numChannels);
+    const size_t total = static_cast<size_t>(numFrames) * stride;
+    std::vector<juce::uint8> planes(std::min(total, kChunkFloats) * sizeof(float));
+    std::vector<float> interleaved(std::min(total, kChunkFloats) + stride);
+    std::vector<float*> rows(stride);
+    size_t carried = 0;
+    int frame = 0;
+    for (size_t pos = 0; pos < total; pos += kChunkFloats)
+    {
+        const size_t n = std::min(kChunkFloats, total - pos);
+        const int bytes = static_cast<int>(n * sizeof(float));
+        if (inflate.read(planes.data(), bytes) != bytes)
+            return false;
+        joinPlanes(planes.data(), n, interleaved.data() + carried);
+        const size_t available = carried + n;
+        const auto frames = static_cast<int>(available / stride);
+        for (int c = 0; c < numChannels; ++c)
+            rows[static_cast<size_t>(c)] = decoded.getWritePointer(c, frame);
+        SampleKernels::deinterleave(interleaved.data(), numChannels, frames, rows.data());
+        frame += frames;
+        carried = available - static_cast<size_t>(frames) * stride;
+        std::memmove(interleaved.data(), interleaved.data() + static_cast<size_t>(frames) * stride, carried * sizeof(float));
+    }
+    audio = std::move(decoded);
+    return true;
+}
+
+juce::String SegmentStore::keyFor(const juce::MemoryBlock& packed)
+{
+    return BlobStore::keyFor(packed.getData(), packed.getSize());
+}
+
+bool SegmentStore::isValidKey(const juce::String& key)
+{
+    return key.length() > 17 && key.length() < 64 && key.containsOnly("0123456789abcdef-");
+}
+
+bool SegmentStore::store(const juce::String& key, const juce::MemoryBlock& packed)
+{
+    if (!isValidKey(key))
+        return false;
+    const juce::File file = getSidecarFile(key);
+    if (file.getSize() == static_cast<juce::int64>(packed.getSize()))
+    {
+        // Same key and size: written by an earlier save or another instance, and in use again
+        file.setLastModificationTime(juce::Time::getCurrentTime());
+        return true;
+    }
+    if (!getDirectory().createDirectory().wasOk())
+        return false;
+    juce::TemporaryFile temp(file);
+    if (!temp.getFile().replaceWithData(packed.getData(), packed.getSize()))
+        return false;
+    return temp.overwriteTargetFileWithTemporary();
+}
+
+SegmentStore::Writer::Writer(int numChannels) : numChannels_(numChannels)
+{
+    if (numChannels_ <= 0 || !getDirectory().createDirectory().wasOk())
+        return;
+    file_ = getDirectory().getNonexistentChildFile("capture", ".tmp", false);
+    out_ = std::make_unique<juce::FileOutputStream>(file_);
+    if (!out_->openedOk())
+        return;
+    out_->write(kMagic, sizeof(kMagic));
+    out_->writeByte(static_cast<char>(kCodecPlanarDeflate));
+    out_->writeByte(static_cast<char>(numChannels_));
+    out_->writeShort(0);
+    out_->writeInt(0); // frame count, patched by finish()
+    deflate_ = std::make_unique<juce::GZIPCompressorOutputStream>(*out_, kCompressionLevel);
+    ok_ = true;
+}
+
+SegmentStore::Writer::~Writer()
+{
+    deflate_.reset();
+    out_.reset();
+    if (file_ != juce::File() && file_.getFileExtension() == ".tmp")
+        file_.deleteFile();
+}
+
+bool SegmentStore::Writer::write(const float* const* channels, int numFrames)
+{
+    ok_ = ok_ && queue_.write(*deflate_, channels, numChannels_, std::max(0, numFrames));
+    if (ok_)
+        numFrames_ += numFrames;
+    return ok_;
+}
+
+juce::String SegmentStore::Writer::finish()
+{
+    ok_ = ok_ && queue_.flush(*deflate_);
+    if (!ok_ || numFrames_ > std::numeric_limits<int>::max())
+        return {};
+    deflate_->flush();
+    deflate_.reset();
+    ok_ = out_->setPosition(8) && out_->writeInt(static_cast<int>(numFrames_));
+    out_->flush();
+    ok_ = ok_ && out_->getStatus().wasOk();
+    out_.reset();
+    if (!ok_)
+        return {};
+
+    const juce::String key = BlobStore::keyForFile(file_);
+    if (!isValidKey(key))
+        return {};
+    const juce::File sidecar = getSidecarFile(key);
+    if (sidecar.getSize() == file_.getSize())
+    {
+        sidecar.setLastModificationTime(juce::Time::getCurrentTime()); // keeps sweep() off it
+        return key; // identical audio is already stored; the destructor drops the temp file
+    }
+    if (!file_.moveFileTo(sidecar))
+        return {};
+    file_ = sidecar;
+    return key;
+}
+
+bool SegmentStore::load(const juce::String& key, SegmentAudio& audio)
+{
+    if (!isValidKey(key))
+        return false;
+    juce::MemoryBlock packed;
+    if (!getSidecarFile(key).loadFileAsData(packed))
+        return false;
+    return unpack(packed.getData(), packed.getSize(), audio);
+}
+
+// Touching a live sidecar once a day is enough to keep it out of reach of any cutoff
+juce::int64 SegmentStore::sweep(const std::set<juce::String>& liveKeys, juce::Time cutoff)
+{
+    const juce::Time now = juce::Time::getCurrentTime();
+    juce::int64 kept = 0;
+    for (const auto& item : juce::RangedDirectoryIterator(getDirectory(), false, "*.afsa;*.tmp", juce::File::findFiles))
+    {
+        const juce::File file = item.getFile();
+        if (file.hasFileExtension("tmp"))
+        {
+            // An open Writer's file is always younger than a day
+            if (now - item.getModificationTime() > juce::RelativeTime::days(1))
+                file.deleteFile();
+            continue;
+        }
+        if (liveKeys.count(file.getFileNameWithoutExtension()) > 0)
+        {
+            if (now - item.getModificationTime() > juce::RelativeTime::days(1))
+                file.setLastModificationTime(now);
+        }
+        else if (file.getLastModificationTime() < cutoff && file.deleteFile()) // re-read: store() may have just used it
+        {
+            continue;
+        }
+        kept += item.getFileSize();
+    }
+    return kept;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <memory>
+#include <set>
+#include <vector>
+#include "SegmentAudio.h"
+
+/**
+ * Storage for recorded segment audio outside the plugin state.
+ *
+ * pack() encodes float audio losslessly (bit-exact): the channels are
+ * interleaved into one stream, the bytes of each chunk of samples are
+ * regrouped into four planes (sign/exponent bytes compress far better
+ * together) and deflated; unpack() fills planar SegmentAudio rows. Packed
+ * chunks are written once to AceForgeSuno/Segments/<key>.afsa, keyed by
+ * their content hash, so the plugin state only needs to reference them and
+ * saving a project with hours of capture costs metadata only. Identical audio shares one sidecar.
+ * Saved projects may still refer to a sidecar after its segment left the
+ * session, so sweep() only deletes sidecars that no loaded session has used
+ * for a long time (their modification time says when one last did).
+ * Stateless; blocking file I/O and codec work: call off the message thread.
+ */
+class SegmentStore
+{
+    // The interleaved sample stream, deflated in plane chunks of kChunkFloats
+    struct ChunkQueue
+    {
+        bool write(juce::OutputStream& out, const float* const* channels, int numChannels, int numFrames);
+        bool flush(juce::OutputStream& out);
+
+        std::vector<float> chunk;
+        std::vector<juce::uint8> planes;
+        std::vector<float> stage;   // interleaving scratch
+    };
+
+public:
+    static juce::File getDirectory();
+
+    /** Lossless chunk for numFrames of planar audio (one pointer per channel). */
+    static juce::MemoryBlock pack(const float* const* channels, int numChannels, int numFrames);
+    /** Decodes a pack() chunk; false if it is truncated or not a chunk. */
+    static bool unpack(const void* data, size_t size, SegmentAudio& audio);
+
+    /** Content key for a packed chunk ("<16 hex>-<bytes>", as BlobStore). */
+    static juce::String keyFor(const juce::MemoryBlock& packed);
+    /** Keys come from saved state: only well-formed ones may name a file. */
+    static bool isValidKey(const juce::String& key);
+
+    /** Writes packed to the sidecar for key unless it is already there. */
+    static bool store(const juce::String& key, const juce::MemoryBlock& packed);
+    /** Reads and decodes the sidecar for key; false if missing or damaged. */
+    static bool load(const juce::String& key, SegmentAudio& audio);
+
+    /** Marks the sidecars in liveKeys as used now, deletes the others last used before cutoff
+        (and capture files a crash left behind) and returns the bytes of the sidecars kept. */
+    static juce::int64 sweep(const std::set<juce::String>& liveKeys, juce::Time cutoff);
+
+    /**
+     * Streams audio straight into a new sidecar (same bytes as pack() of the whole
+     * recording), so long captures never exist in memory as a whole. The file is
+     * written under a temporary name and moved to its content key by finish();
+     * an unfinished file is deleted with the writer.
+     */
+    class Writer
+    {
+    public:
+        explicit Writer(int numChannels);
+        ~Writer();
+
+        /** One pointer per channel; nullptr writes silence. */
+        bool write(const float* const* channels, int numFrames);
+        juce::int64 getNumFrames() const { return numFrames_; }
+        /** Completes the file; its key, or empty on failure. */
+        juce::String finish();
+
+    private:
+        int numChannels_;
+        juce::int64 numFrames_ = 0;
+        juce::File file_;
+        std::unique_ptr<juce::FileOutputStream> out_;
+        std::unique_ptr<juce::GZIPCompressorOutputStream> deflate_;
+        ChunkQueue queue_;
+        bool ok_ = false;
+
+        JUCE_DECLARE_NON_COPYABLE(Writer)
+    };
+
+private:
+    static juce::File getSidecarFile(const juce::String& key);
+};
@@ -0,0 +1,291 @@
+#include "SharedServices.h"
+#include "SegmentStore.h"
+#include <algorithm>
+#include <atomic>
+
+class SharedServices::OwnedJob : public juce::ThreadPoolJob
+{
+public:
+    OwnedJob(const void* owner, std::function<void()> job)
+        : juce::ThreadPoolJob("AceForgeSuno job"), owner_(owner), job_(std::move(job))
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        job_();
+        return jobHasFinished;
+    }
+
+    const void* getOwner() const { return owner_; }
+
+private:
+    const void* const owner_;
+    std::function<void()> job_;
+};
+
+class SharedServices::OwnerSelector : public juce::ThreadPool::JobSelector
+{
+public:
+    explicit OwnerSelector(const void* owner) : owner_(owner) {}
+
+    bool isJobSuitable(juce::ThreadPoolJob* job) override
+    {
+        auto* owned = dynamic_cast<OwnedJob*>(job);
+        return owned != nullptr && owned->getOwner() == owner_;
+    }
+
+private:
+    const void* const owner_;
+};
+
+/** One thread for all running tasks; each is polled every kPollIntervalMs. */
+class SharedServices::TaskPoller : public juce::Thread
+{
+public:
+    explicit TaskPoller(SharedServices& services)
+        : juce::Thread("AceForgeSuno task poller"), services_(services)
+    {
+        startThread();
+    }
+
+    ~TaskPoller() override { stopThread(kStopTimeoutMs); }
+
+    void watch(const void* owner, const std::string& apiKey, const std::string& taskId, TaskCallback onFinished)
+    {
+        auto task = std::make_shared<Task>(Task{ owner, suno::SunoClient(apiKey), taskId, std::move(onFinished),
+                                                 juce::Time::getMillisecondCounter() });
+        {
+            juce::ScopedLock l(lock_);
+            tasks_.push_back(std::move(task));
+        }
+        notify();
+    }
+
+    void forget(const void* owner)
+    {
+        juce::ScopedLock l(lock_);
+        tasks_.erase(std::remove_if(tasks_.begin(), tasks_.end(), [owner](const auto& t) { return t->owner == owner; }),
+                     tasks_.end());
+    }
+
+private:
+    struct Task
+    {
+        const void* owner;
+        suno::SunoClient client;      // only used on the poller thread
+        std::string taskId;
+        TaskCallback onFinished;
+        juce::uint32 dueMs;
+    };
+
+    static constexpr int kPollIntervalMs = 800;
+    static constexpr int kStopTimeoutMs = 10000;
+
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            std::vector<std::shared_ptr<Task>> due;
+            int waitMs = -1;
+            {
+                juce::ScopedLock l(lock_);
+                const juce::uint32 now = juce::Time::getMillisecondCounter();
+                for (const auto& t : tasks_)
+                {
+                    const auto remaining = static_cast<int>(t->dueMs - now);
+                    if (remaining <= 0)
+                        due.push_back(t);
+                    else
+                        waitMs = waitMs < 0 ? remaining : std::min(waitMs, remaining);
+                }
+            }
+            for (const auto& t : due)
+            {
+                if (threadShouldExit())
+                    return;
+                const suno::TaskStatus status = t->client.getTaskStatus(t->taskId);
+                const bool finished = isTaskSucceeded(status) || isTaskFailed(status);
+                juce::ScopedLock l(lock_);
+                const auto it = std::find(tasks_.begin(), tasks_.end(), t);
+                if (it == tasks_.end())
+                    continue; // owner cancelled while the request was in flight
+                if (!finished)
+                {
+                    t->dueMs = juce::Time::getMillisecondCounter() + kPollIntervalMs;
+                    continue;
+                }
+                tasks_.erase(it);
+                // Posted under lock_, so cancelAll() either sees this job or prevented it
+                services_.addJob(t->owner, [onFinished = t->onFinished, status] { onFinished(status); });
+            }
+            if (due.empty())
+                wait(waitMs);
+        }
+    }
+
+    SharedServices& services_;
+    juce::CriticalSection lock_;
+    std::vector<std::shared_ptr<Task>> tasks_;
+};
+
+SharedServices::SharedServices()
+    : poller_(std::make_unique<TaskPoller>(*this))
+{
+}
+
+// Only jobs of instances that are gone are left. Failing their requests lets the network jobs
+// and the poller finish at once; those still running past the timeout hold network_ themselves.
+SharedServices::~SharedServices()
+{
+    suno::SunoClient::cancelAllRequests();
+    poller_.reset();
+    jobPool_.removeAllJobs(true, kShutdownTimeoutMs);
+    decodePool_.removeAllJobs(true, kShutdownTimeoutMs);
+    codecPool_.removeAllJobs(true, kShutdownTimeoutMs);
+    suno::SunoClient::resumeRequests();
+}
+
+void SharedServices::addJob(const void* owner, std::function<void()> job)
+{
+    jobPool_.addJob(new OwnedJob(owner, std::move(job)), true);
+}
+
+void SharedServices::addDecodeJob(const void* owner, std::function<void()> job)
+{
+    decodePool_.addJob(new OwnedJob(owner, std::move(job)), true);
+}
+
+void SharedServices::parallelFor(int numItems, const std::function<void(int)>& item)
+{
+    if (numItems <= 0)
+        return;
+    struct Batch
+    {
+        std::atomic<int> next{ 0 };
+        std::atomic<int> done{ 0 };
+        int numItems = 0;
+        const std::function<void(int)>* item = nullptr;   // only called while items are left
+        juce::WaitableEvent finished;
+    };
+    auto batch = std::make_shared<Batch>();
+    batch->numItems = numItems;
+    batch->item = &item;
+    auto work = [batch]
+    {
+        for (int i = batch->next++; i < batch->numItems; i = batch->next++)
+        {
+            (*batch->item)(i);
+            if (++batch->done == batch->numItems)
+                batch->finished.signal();
+        }
+    };
+    for (int t = 0; t < std::min(kNumCodecThreads, numItems - 1); ++t)
+        codecPool_.addJob(work);
+    work();
+    batch->finished.wait();
+}
+
+void SharedServices::watchTask(const void* owner, const std::string& apiKey, const std::string& taskId,
+                               TaskCallback onFinished)
+{
+    poller_->watch(owner, apiKey, taskId, std::move(onFinished));
+}
+
+// The owner's lifetime has ended, so its running jobs can no longer register tasks or post work:
+// stop its tasks, then drop whatever is queued. Running jobs finish on their own (the pools
+// delete them) and skip every step that would touch the owner.
+void SharedServices::cancelAll(const void* owner)
+{
+    OwnerSelector selector(owner);
+    poller_->forget(owner);
+    jobPool_.removeAllJobs(true, 0, &selector);
+    decodePool_.removeAllJobs(true, 0, &selector);
+    juce::ScopedLock l(segmentKeysLock_);
+    liveSegmentKeys_.erase(owner);
+}
+
+void SharedServices::setLiveSegmentKeys(const void* owner, std::set<juce::String> keys)
+{
+    juce::ScopedLock l(segmentKeysLock_);
+    if (liveSegmentKeys_.count(owner) == 0)
+        lastOwnerAddedMs_ = juce::Time::currentTimeMillis();
+    liveSegmentKeys_[owner] = std::move(keys);
+}
+
+// A sidecar stored after the keys were copied is younger than any cutoff. The job touches no
+// member, so it may outlive this object.
+void SharedServices::sweepSegmentFilesIfDue()
+{
+    std::set<juce::String> liveKeys;
+    {
+        juce::ScopedLock l(segmentKeysLock_);
+        const juce::int64 now = juce::Time::currentTimeMillis();
+        if (now - lastSweepMs_ < kSweepIntervalMs || now - lastOwnerAddedMs_ < kSweepGraceMs)
+            return;
+        lastSweepMs_ = now;
+        for (const auto& owner : liveSegmentKeys_)
+            liveKeys.insert(owner.second.begin(), owner.second.end());
+    }
+    decodePool_.addJob(new OwnedJob(this, [liveKeys = std::move(liveKeys), bytes = segmentFileBytes_]
+    {
+        const juce::Time cutoff = juce::Time::getCurrentTime() - juce::RelativeTime::days(kSegmentFileRetentionDays);
+        bytes->store(SegmentStore::sweep(liveKeys, cutoff), std::memory_order_relaxed);
+    }), true);
+}
+
+bool NetworkServices::checkCredits(const std::string& apiKey, std::string& error)
+{
+    if (apiKey.empty())
+    {
+        error = "No API key";
+        return false;
+    }
+    std::shared_ptr<CreditsCheck> check;
+    bool sendRequest = false;
+    {
+        juce::ScopedLock l(creditsLock_);
+        const auto cached = creditsValidUntilMs_.find(apiKey);
+        if (cached != creditsValidUntilMs_.end() && cached->second > juce::Time::currentTimeMillis())
+            return true;
+        auto& inFlight = creditsInFlight_[apiKey];
+        if (inFlight == nullptr)
+        {
+            inFlight = std::make_shared<CreditsCheck>();
+            sendRequest = true;
+        }
+        check = inFlight;
+    }
+    if (sendRequest)
+    {
+        suno::SunoClient client(apiKey);
+        check->ok = client.checkCredits();
+        check->error = check->ok ? std::string() : client.lastError();
+        {
+            juce::ScopedLock l(creditsLock_);
+            if (check->ok)
+                creditsValidUntilMs_[apiKey] = juce::Time::currentTimeMillis() + kCreditsCacheMs;
+            else
+                creditsValidUntilMs_.erase(apiKey);
+            creditsInFlight_.erase(apiKey);
+        }
+        check->done.signal();
+    }
+    else
+    {
+        check->done.wait();
+    }
+    error = check->error;
+    return check->ok;
+}
+
+bool SharedServices::isTaskSucceeded(const suno::TaskStatus& status)
+{
+    return juce::String(status.status).equalsIgnoreCase("SUCCESS");
+}
+
+bool SharedServices::isTaskFailed(const suno::TaskStatus& status)
+{
+    const juce::String s(status.status);
+    return s.containsIgnoreCase("fail") || s.containsIgnoreCase("error");
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include "SunoClient/SunoClient.hpp"
+#include "AudioMemoryBudget.h"
+#include "LibraryIndex.h"
+#include "PlaybackBufferPool.h"
+#include "UploadCache.h"
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * Liveness of a job owner, shared with its jobs so they can outlive it. Jobs
+ * capture the shared_ptr and touch the owner only inside run(); the owner
+ * calls end() first thing in its destructor, which waits for the run() calls
+ * in progress and makes every later one a no-op. Network requests are made
+ * outside run(), so an owner never waits on the network to go away.
+ */
+class OwnerLifetime
+{
+public:
+    /** Runs fn and returns true while the owner is alive; false, without running fn, once it ended. */
+    template <typename Fn>
+    bool run(Fn&& fn)
+    {
+        const juce::ScopedReadLock l(lock_);
+        if (!alive_)
+            return false;
+        fn();
+        return true;
+    }
+    void end()
+    {
+        const juce::ScopedWriteLock l(lock_);
+        alive_ = false;
+    }
+
+private:
+    juce::ReadWriteLock lock_;   // read: a run() in progress (re-entrant), write: end()
+    bool alive_ = true;
+};
+
+/**
+ * What network jobs use besides their own SunoClient: the UploadCache and a
+ * per-key cache of credit checks. Jobs hold it by shared_ptr, so a job still
+ * finishing a request when the last instance (and SharedServices) goes away
+ * never reaches freed state.
+ */
+class NetworkServices
+{
+public:
+    /** Shared with network jobs, which may outlive this object. */
+    std::shared_ptr<NetworkServices> getNetwork() const { return network_; }
+
+    /** Validates apiKey with one request per key and kCreditsCacheMs; concurrent callers with
+        the same key wait for the request in flight instead of sending their own. Blocking,
+        call from a job. */
+    bool checkCredits(const std::string& apiKey, std::string& error);
+
+private:
+    static constexpr juce::int64 kCreditsCacheMs = 60 * 1000;
+
+    struct CreditsCheck
+    {
+        juce::WaitableEvent done{ true };   // manual reset: wakes every waiter
+        bool ok = false;
+        std::string error;
+    };
+
+    UploadCache uploadCache_;
+    juce::CriticalSection creditsLock_;   // never held across a request
+    std::map<std::string, juce::int64> creditsValidUntilMs_;
+    std::map<std::string, std::shared_ptr<CreditsCheck>> creditsInFlight_;
+};
+
+/**
+ * Services shared by every plugin instance in the process (use via
+ * juce::SharedResourcePointer: created with the first instance, destroyed with
+ * the last). Instances attach on construction instead of owning threads, so a
+ * session with ten instances still runs one set of workers:
+ *  - job pool: network steps of a job (credits, upload, submit, download)
+ *  - task poller: one thread polling every running Suno task
+ *  - decode pool: decoding, analysing and storing finished results
+ *  - codec pool: helpers for parallelFor() (CompactAudio block coding)
+ *  - the LibraryIndex, PlaybackBufferPool and AudioMemoryBudget
+ *  - NetworkServices (UploadCache, credit checks), shared with network jobs
+ *  - the sweep of segment sidecars that no loaded session uses any more
+ * HTTP goes through one process-wide NSURLSession (SunoClientMac.mm), and
+ * credit checks are cached per API key so instances restoring the same key
+ * cost one request. The destructor cancels the requests in flight before it
+ * joins the pools, so the last instance never waits on the network. Work is tagged with an owner (the instance) so its queued
+ * jobs can be dropped when that instance goes away; jobs already running hold
+ * the owner's OwnerLifetime instead of the owner.
+ */
+class SharedServices
+{
+public:
+    using TaskCallback = std::function<void(const suno::TaskStatus&)>;
+
+    SharedServices();
+    ~SharedServices();
+
+    LibraryIndex& getLibrary() { return library_; }
+    /** Shared with network jobs, which may outlive this object. */
+    std::shared_ptr<NetworkServices> getNetwork() const { return network_; }
+    PlaybackBufferPool& getPlaybackPool() { return playbackPool_; }
+    AudioMemoryBudget& getAudioMemory() { return audioMemory_; }
+
+    /** Runs job on the shared job pool. */
+    void addJob(const void* owner, std::function<void()> job);
+    /** Runs job on the shared decode pool (CPU-bound result processing). */
+    void addDecodeJob(const void* owner, std::function<void()> job);
+    /** Runs item(0 .. numItems - 1) on the codec pool and the calling thread and returns when all
+        are done. The caller works through the items too, so this never waits on a busy pool. */
+    void parallelFor(int numItems, const std::function<void(int)>& item);
+    /** Polls taskId until it succeeds or fails, then runs onFinished with the final status on
+        the job pool. Transient errors (empty status) keep polling. */
+    void watchTask(const void* owner, const std::string& apiKey, const std::string& taskId, TaskCallback onFinished);
+    /** Stops watching owner's tasks and drops its queued jobs, without waiting for running ones,
+        and forgets its segment keys. Call from the owner's destructor after ending its
+        OwnerLifetime. */
+    void cancelAll(const void* owner);
+
+    /** The SegmentStore sidecars owner's session refers to; the sweep keeps them. The first
+        call registers owner, and no sweep starts within kSweepGraceMs of that, since hosts
+        restore an instance's state right after creating it. */
+    void setLiveSegmentKeys(const void* owner, std::set<juce::String> keys);
+    /** Queues SegmentStore::sweep() on the decode pool once every kSweepIntervalMs: sidecars no
+        instance refers to are deleted kSegmentFileRetentionDays after one last did. */
+    void sweepSegmentFilesIfDue();
+    /** Bytes of segment sidecars on disk as of the last sweep; 0 before the first. */
+    juce::int64 getSegmentFileBytes() const { return segmentFileBytes_->load(std::memory_order_relaxed); }
+
+    static bool isTaskSucceeded(const suno::TaskStatus& status);
+    static bool isTaskFailed(const suno::TaskStatus& status);
+
+private:
+    class OwnedJob;
+    class OwnerSelector;
+    class TaskPoller;
+
+    static constexpr int kNumJobThreads = 4;
+    static constexpr int kNumDecodeThreads = 2;
+    static constexpr int kNumCodecThreads = 3;
+    static constexpr int kShutdownTimeoutMs = 5000;   // requests are cancelled first: CPU work only
+    static constexpr juce::int64 kSweepIntervalMs = 10 * 60 * 1000;
+    static constexpr juce::int64 kSweepGraceMs = 60 * 1000;
+    static constexpr int kSegmentFileRetentionDays = 90;
+
+    LibraryIndex library_;
+    std::shared_ptr<NetworkServices> network_ = std::make_shared<NetworkServices>();
+    PlaybackBufferPool playbackPool_;
+    AudioMemoryBudget audioMemory_;
+    juce::ThreadPool jobPool_{ kNumJobThreads };
+    juce::ThreadPool decodePool_{ kNumDecodeThreads };
+    juce::ThreadPool codecPool_{ kNumCodecThreads };
+    std::unique_ptr<TaskPoller> poller_;
+
+    juce::CriticalSection segmentKeysLock_;
+    std::map<const void*, std::set<juce::String>> liveSegmentKeys_;
+    juce::int64 lastOwnerAddedMs_ = 0;   // under segmentKeysLock_
+    juce::int64 lastSweepMs_ = 0;        // under segmentKeysLock_
+    std::shared_ptr<std::atomic<juce::int64>> segmentFileBytes_ = std::make_shared<std::atomic<juce::int64>>(0);
+
+    JUCE_DECLARE_NON_COPYABLE(SharedServices)
+};
@@ -0,0 +1,49 @@
+#include "SilenceGate.h"
+#include <cmath>
+
+namespace
+{
+bool isAudible(const float* const* channels, int numChannels, int frame)
+{
+    for (int c = 0; c < numChannels; ++c)
+        if (std::abs(channels[c][frame]) > SilenceGate::kThreshold)
+            return true;
+    return false;
+}
+} // namespace
+
+void SilenceGate::process(const float* const* channels, int numChannels, int numFrames)
+{
+    bool audible = false;
+    for (int c = 0; c < numChannels && !audible; ++c)
+    {
+        const auto range = juce::FloatVectorOperations::findMinAndMax(channels[c], numFrames);
+        audible = range.getStart() < -kThreshold || range.getEnd() > kThreshold;
+    }
+    if (audible)
+    {
+        if (soundStart_ < 0)
+        {
+            int first = 0;
+            while (!isAudible(channels, numChannels, first))
+                ++first;
+            soundStart_ = numFrames_ + first;
+        }
+        int last = numFrames - 1;
+        while (!isAudible(channels, numChannels, last))
+            --last;
+        soundEnd_ = numFrames_ + last + 1;
+    }
+    numFrames_ += numFrames;
+}
+
+void SilenceGate::append(const SilenceGate& other)
+{
+    if (other.hasSound())
+    {
+        if (!hasSound())
+            soundStart_ = numFrames_ + other.soundStart_;
+        soundEnd_ = numFrames_ + other.soundEnd_;
+    }
+    numFrames_ += other.numFrames_;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+/**
+ * Tracks where a recording has signal: the first and last frame whose peak
+ * exceeds kThreshold on any channel. process() gates each block with a
+ * vectorised min/max per channel and only scans samples in the first and last
+ * audible blocks, so the audio thread can run it on every captured block
+ * without allocating. Bounds of concatenated audio combine with append().
+ */
+class SilenceGate
+{
+public:
+    static constexpr float kThreshold = 0.001f;   // -60 dBFS
+
+    void reset() { *this = {}; }
+    /** Audio thread. */
+    void process(const float* const* channels, int numChannels, int numFrames);
+    /** As if other's audio followed this one. */
+    void append(const SilenceGate& other);
+
+    juce::int64 getNumFrames() const { return numFrames_; }
+    bool hasSound() const { return soundEnd_ > soundStart_; }
+    juce::int64 getSoundStart() const { return hasSound() ? soundStart_ : 0; }
+    juce::int64 getSoundEnd() const { return hasSound() ? soundEnd_ : 0; }   // exclusive
+
+private:
+    juce::int64 numFrames_ = 0;
+    juce::int64 soundStart_ = -1;
+    juce::int64 soundEnd_ = -1;
+};
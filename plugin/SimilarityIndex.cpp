@@ -0,0 +1,135 @@
+#include "SimilarityIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace
+{
+constexpr size_t kMinCandidates = 64;
+constexpr size_t kCandidatesPerResult = 8;
+} // namespace
+
+void SimilarityIndex::build(const std::vector<const std::vector<float>*>& vectors, size_t dims)
+{
+    dims_ = dims;
+    mean_.assign(dims, 0.0f);
+    invStd_.assign(dims, 1.0f);
+    vectors_.clear();
+    signatures_.clear();
+    indices_.clear();
+    if (dims == 0)
+        return;
+
+    // Per-dimension mean / deviation over the set, so no feature group dominates the cosine
+    std::vector<double> sum(dims, 0.0), sumSq(dims, 0.0);
+    size_t count = 0;
+    for (const auto* v : vectors)
+    {
+        if (v == nullptr || v->size() != dims)
+            continue;
+        for (size_t d = 0; d < dims; ++d)
+        {
+            sum[d] += (*v)[d];
+            sumSq[d] += static_cast<double>((*v)[d]) * (*v)[d];
+        }
+        ++count;
+    }
+    if (count == 0)
+        return;
+    for (size_t d = 0; d < dims; ++d)
+    {
+        const double mean = sum[d] / count;
+        const double variance = std::max(0.0, sumSq[d] / count - mean * mean);
+        mean_[d] = static_cast<float>(mean);
+        invStd_[d] = variance > 1e-12 ? static_cast<float>(1.0 / std::sqrt(variance)) : 1.0f;
+    }
+
+    std::mt19937 rng(0x5eedu);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    planes_.resize(static_cast<size_t>(kSignatureBits) * dims);
+    for (auto& p : planes_)
+        p = gauss(rng);
+
+    vectors_.resize(count * dims);
+    signatures_.reserve(count);
+    indices_.reserve(count);
+    for (size_t i = 0; i < vectors.size(); ++i)
+    {
+        const auto* v = vectors[i];
+        if (v == nullptr || v->size() != dims)
+            continue;
+        float* unit = vectors_.data() + indices_.size() * dims;
+        normalise(v->data(), unit);
+        signatures_.push_back(signature(unit));
+        indices_.push_back(i);
+    }
+}
+
+std::vector<SimilarityIndex::Match> SimilarityIndex::query(const std::vector<float>& v, size_t maxResults) const
+{
+    if (indices_.empty() || v.size() != dims_ || maxResults == 0)
+        return {};
+    std::vector<float> unit(dims_);
+    if (!normalise(v.data(), unit.data()))
+        return {};
+    const uint64_t sig = signature(unit.data());
+
+    // Coarse pass: Hamming distance between signatures approximates the angle between vectors
+    const size_t n = indices_.size();
+    std::vector<std::pair<int, uint32_t>> byDistance(n);
+    for (size_t i = 0; i < n; ++i)
+        byDistance[i] = { __builtin_popcountll(signatures_[i] ^ sig), static_cast<uint32_t>(i) };
+    const size_t numCandidates = std::min(n, std::max(kMinCandidates, maxResults * kCandidatesPerResult));
+    std::partial_sort(byDistance.begin(), byDistance.begin() + static_cast<std::ptrdiff_t>(numCandidates), byDistance.end());
+
+    // Exact re-rank of the candidates
+    std::vector<Match> matches;
+    matches.reserve(numCandidates);
+    for (size_t c = 0; c < numCandidates; ++c)
+    {
+        const size_t i = byDistance[c].second;
+        const float* u = vectors_.data() + i * dims_;
+        float dot = 0.0f;
+        for (size_t d = 0; d < dims_; ++d)
+            dot += u[d] * unit[d];
+        matches.push_back({ indices_[i], dot });
+    }
+    std::sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) { return a.similarity > b.similarity; });
+    if (matches.size() > maxResults)
+        matches.resize(maxResults);
+    return matches;
+}
+
+bool SimilarityIndex::normalise(const float* in, float* out) const
+{
+    double norm = 0.0;
+    for (size_t d = 0; d < dims_; ++d)
+    {
+        out[d] = (in[d] - mean_[d]) * invStd_[d];
+        norm += static_cast<double>(out[d]) * out[d];
+    }
+    if (norm <= 1e-12)
+    {
+        std::fill(out, out + dims_, 0.0f);
+        return false;
+    }
+    const auto scale = static_cast<float>(1.0 / std::sqrt(norm));
+    for (size_t d = 0; d < dims_; ++d)
+        out[d] *= scale;
+    return true;
+}
+
+uint64_t SimilarityIndex::signature(const float* unit) const
+{
+    uint64_t sig = 0;
+    for (int b = 0; b < kSignatureBits; ++b)
+    {
+        const float* plane = planes_.data() + static_cast<size_t>(b) * dims_;
+        float dot = 0.0f;
+        for (size_t d = 0; d < dims_; ++d)
+            dot += plane[d] * unit[d];
+        if (dot >= 0.0f)
+            sig |= uint64_t(1) << b;
+    }
+    return sig;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Approximate nearest-neighbour search over fixed-length feature vectors
+ * (AudioFeatureExtractor). build() standardises every dimension over the
+ * whole set, normalises to unit length and hashes each vector to a 64-bit
+ * signature with random hyperplanes (SimHash, fixed seed). A query ranks all
+ * signatures by Hamming distance (one popcount per entry), keeps the closest
+ * candidates and re-ranks only those by exact cosine similarity.
+ * Pure C++ and not thread-safe; LibraryIndex guards it with its own lock.
+ */
+class SimilarityIndex
+{
+public:
+    static constexpr int kSignatureBits = 64;
+
+    struct Match
+    {
+        size_t index;       // position in the vectors passed to build()
+        float similarity;   // cosine of the standardised vectors, 1 = identical
+    };
+
+    /** vectors[i] may be null or of another length; such entries are not indexed. */
+    void build(const std::vector<const std::vector<float>*>& vectors, size_t dims);
+
+    /** Best matches first; at most maxResults. */
+    std::vector<Match> query(const std::vector<float>& v, size_t maxResults) const;
+
+    size_t size() const { return indices_.size(); }
+
+private:
+    bool normalise(const float* in, float* out) const;
+    uint64_t signature(const float* unit) const;
+
+    size_t dims_ = 0;
+    std::vector<float> mean_;
+    std::vector<float> invStd_;
+    std::vector<float> planes_;          // kSignatureBits x dims_
+    std::vector<float> vectors_;         // standardised unit vectors, size() x dims_
+    std::vector<uint64_t> signatures_;
+    std::vector<size_t> indices_;
+};
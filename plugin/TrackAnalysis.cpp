@@ -0,0 +1,473 @@
+#include "TrackAnalysis.h"
+#include <juce_dsp/juce_dsp.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr int kFftOrder = 11;
+constexpr int kFftSize = 1 << kFftOrder;
+constexpr int kHopSize = 512;
+constexpr int kNumBins = kFftSize / 2 + 1;
+constexpr int kMinBeatHops = 64;              // ~0.75 s at 44.1 kHz
+constexpr double kMinTempo = 60.0;
+constexpr double kMaxTempo = 200.0;
+constexpr double kBeatTightness = 100.0;      // penalty for beat intervals off the estimated period
+constexpr int kOversampling = 4;
+constexpr int kTapsPerPhase = 12;
+constexpr double kAbsoluteGateLufs = -70.0;
+constexpr double kRelativeGateLu = -10.0;
+constexpr int kDecodeBlockFrames = 1 << 16;
+
+// Krumhansl-Kessler key profiles, tonic first
+constexpr double kMajorProfile[12] = { 6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88 };
+constexpr double kMinorProfile[12] = { 6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17 };
+
+double loudnessOf(double meanSquare) { return -0.691 + 10.0 * std::log10(std::max(meanSquare, 1.0e-20)); }
+
+struct Biquad
+{
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+    double z1 = 0.0, z2 = 0.0;
+
+    double process(double x)
+    {
+        const double y = b0 * x + z1;
+        z1 = b1 * x - a1 * y + z2;
+        z2 = b2 * x - a2 * y;
+        return y;
+    }
+};
+
+// BS.1770 pre-filter (high shelf) and RLB high-pass, re-derived for any sample rate
+void makeKWeighting(double sampleRate, Biquad& shelf, Biquad& highPass)
+{
+    const double pi = juce::MathConstants<double>::pi;
+    {
+        const double f0 = 1681.974450955533, gainDb = 3.999843853973347, q = 0.7071752369554196;
+        const double k = std::tan(pi * f0 / sampleRate);
+        const double vh = std::pow(10.0, gainDb / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+        shelf.b0 = (vh + vb * k / q + k * k) / a0;
+        shelf.b1 = 2.0 * (k * k - vh) / a0;
+        shelf.b2 = (vh - vb * k / q + k * k) / a0;
+        shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+        shelf.a2 = (1.0 - k / q + k * k) / a0;
+    }
+    {
+        const double f0 = 38.13547087602444, q = 0.5003270373238773;
+        const double k = std::tan(pi * f0 / sampleRate);
+        const double a0 = 1.0 + k / q + k * k;
+        highPass.b0 = 1.0;
+        highPass.b1 = -2.0;
+        highPass.b2 = 1.0;
+        highPass.a1 = 2.0 * (k * k - 1.0) / a0;
+        highPass.a2 = (1.0 - k / q + k * k) / a0;
+    }
+}
+
+// Windowed-sinc interpolator split into kOversampling phases, each normalised to unity DC gain
+std::array<float, kOversampling * kTapsPerPhase> makeInterpolator()
+{
+    constexpr int n = kOversampling * kTapsPerPhase;
+    std::array<float, n> taps {};
+    const double centre = (n - 1) * 0.5;
+    for (int i = 0; i < n; ++i)
+    {
+        const double x = (i - centre) / kOversampling;
+        const double sinc = std::abs(x) < 1.0e-9 ? 1.0 : std::sin(juce::MathConstants<double>::pi * x) / (juce::MathConstants<double>::pi * x);
+        const double w = 0.42 - 0.5 * std::cos(2.0 * juce::MathConstants<double>::pi * (i + 0.5) / n)
+                         + 0.08 * std::cos(4.0 * juce::MathConstants<double>::pi * (i + 0.5) / n);
+        taps[static_cast<size_t>(i)] = static_cast<float>(sinc * w);
+    }
+    for (int p = 0; p < kOversampling; ++p)
+    {
+        double sum = 0.0;
+        for (int k = 0; k < kTapsPerPhase; ++k)
+            sum += taps[static_cast<size_t>(p + k * kOversampling)];
+        for (int k = 0; k < kTapsPerPhase; ++k)
+            taps[static_cast<size_t>(p + k * kOversampling)] /= static_cast<float>(sum);
+    }
+    return taps;
+}
+
+// Period of the onset envelope in hops: autocorrelation over kMinTempo..kMaxTempo, weighted
+// towards 120 BPM, refined by parabolic interpolation around the best lag.
+double estimatePeriod(const std::vector<float>& onset, double hopsPerSecond)
+{
+    const int n = static_cast<int>(onset.size());
+    const int minLag = std::max(1, static_cast<int>(std::floor(hopsPerSecond * 60.0 / kMaxTempo)));
+    const int maxLag = std::min(n - 2, static_cast<int>(std::ceil(hopsPerSecond * 60.0 / kMinTempo)));
+    if (maxLag <= minLag + 1)
+        return 0.0;
+    std::vector<double> score(static_cast<size_t>(maxLag) + 2, 0.0);
+    for (int lag = minLag - 1; lag <= maxLag + 1; ++lag)
+    {
+        if (lag < 1)
+            continue;
+        double acf = 0.0;
+        for (int i = lag; i < n; ++i)
+            acf += static_cast<double>(onset[static_cast<size_t>(i)]) * onset[static_cast<size_t>(i - lag)];
+        const double octaves = std::log2(60.0 * hopsPerSecond / lag / 120.0);
+        score[static_cast<size_t>(lag)] = acf / (n - lag) * std::exp(-0.5 * octaves * octaves);
+    }
+    int best = minLag;
+    for (int lag = minLag; lag <= maxLag; ++lag)
+        if (score[static_cast<size_t>(lag)] > score[static_cast<size_t>(best)])
+            best = lag;
+    if (score[static_cast<size_t>(best)] <= 0.0)
+        return 0.0;
+    const double l = score[static_cast<size_t>(best - 1)], c = score[static_cast<size_t>(best)], r = score[static_cast<size_t>(best + 1)];
+    const double denom = l - 2.0 * c + r;
+    const double offset = denom < 0.0 ? juce::jlimit(-0.5, 0.5, 0.5 * (l - r) / denom) : 0.0;
+    return best + offset;
+}
+
+// Dynamic-programming beat tracker (Ellis 2007): each hop's score is its onset strength plus the
+// best predecessor score, penalised by the squared log-ratio of the interval to the period.
+std::vector<int> trackBeats(const std::vector<float>& onset, double period)
+{
+    const int n = static_cast<int>(onset.size());
+    std::vector<double> score(static_cast<size_t>(n));
+    std::vector<int> backlink(static_cast<size_t>(n), -1);
+    const int minGap = std::max(1, static_cast<int>(std::round(period * 0.5)));
+    const int maxGap = static_cast<int>(std::round(period * 2.0));
+    for (int t = 0; t < n; ++t)
+    {
+        double best = 0.0;
+        int link = -1;
+        for (int gap = minGap; gap <= maxGap && t - gap >= 0; ++gap)
+        {
+            const double penalty = std::log(gap / period);
+            const double candidate = score[static_cast<size_t>(t - gap)] - kBeatTightness * penalty * penalty;
+            if (link < 0 || candidate > best)
+            {
+                best = candidate;
+                link = t - gap;
+            }
+        }
+        score[static_cast<size_t>(t)] = onset[static_cast<size_t>(t)] + (link >= 0 ? std::max(0.0, best) : 0.0);
+        backlink[static_cast<size_t>(t)] = link >= 0 && best > 0.0 ? link : -1;
+    }
+
+    // Finish on the strongest hop within the last period
+    int end = std::max(0, n - static_cast<int>(std::ceil(period)));
+    for (int t = end; t < n; ++t)
+        if (score[static_cast<size_t>(t)] > score[static_cast<size_t>(end)])
+            end = t;
+    std::vector<int> beats;
+    for (int t = end; t >= 0; t = backlink[static_cast<size_t>(t)])
+        beats.push_back(t);
+    std::reverse(beats.begin(), beats.end());
+    return beats;
+}
+} // namespace
+
+std::string TrackAnalysis::keyName(int key)
+{
+    static const char* const names[12] = { "C", "C#", "D", "Eb", "E", "F", "F#", "G", "Ab", "A", "Bb", "B" };
+    if (key < 0 || key >= 24)
+        return {};
+    return std::string(names[key % 12]) + (key >= 12 ? "m" : "");
+}
+
+bool TrackAnalysis::tempoMatches(double bpm, double reference, double tolerance)
+{
+    if (bpm <= 0.0 || reference <= 0.0)
+        return false;
+    for (double ratio : { 1.0, 0.5, 2.0 })
+        if (std::abs(bpm * ratio / reference - 1.0) <= tolerance)
+            return true;
+    return false;
+}
+
+struct TrackAnalyzer::Impl
+{
+    Impl(double sr, int channels)
+        : sampleRate(sr), numChannels(std::max(1, channels)), fft(kFftOrder),
+          window(kFftSize, juce::dsp::WindowingFunction<float>::hann, false),
+          framesPerBlock(std::max(1, static_cast<int>(std::lround(sr * 0.1)))),
+          interpolator(makeInterpolator())
+    {
+        frame.resize(2 * kFftSize);
+        previousLog.assign(kNumBins, 0.0f);
+        chromaMap.assign(kNumBins, -1);
+        for (int k = 1; k < kNumBins; ++k)
+        {
+            const double hz = k * sampleRate / kFftSize;
+            if (hz < 55.0 || hz > 5000.0)
+                continue;
+            const int midi = static_cast<int>(std::lround(69.0 + 12.0 * std::log2(hz / 440.0)));
+            chromaMap[static_cast<size_t>(k)] = ((midi % 12) + 12) % 12;
+        }
+        kWeighting.resize(static_cast<size_t>(numChannels));
+        for (auto& stages : kWeighting)
+            makeKWeighting(sampleRate, stages[0], stages[1]);
+        history.assign(static_cast<size_t>(numChannels) * kTapsPerPhase, 0.0f);
+    }
+
+    void process(const float* const* channels, int numFrames)
+    {
+        const float gain = 1.0f / static_cast<float>(numChannels);
+        for (int i = 0; i < numFrames; ++i)
+        {
+            float mono = 0.0f;
+            double weightedSquares = 0.0;
+            for (int c = 0; c < numChannels; ++c)
+            {
+                const float x = channels[c][i];
+                mono += x;
+                auto& stages = kWeighting[static_cast<size_t>(c)];
+                const double k = stages[1].process(stages[0].process(x));
+                weightedSquares += k * k;
+                pushTruePeak(c, x);
+            }
+            pending.push_back(mono * gain);
+
+            blockSum += weightedSquares;
+            if (++blockFrames == framesPerBlock)
+            {
+                blockMeanSquares.push_back(blockSum / framesPerBlock);
+                blockSum = 0.0;
+                blockFrames = 0;
+            }
+        }
+
+        size_t pos = 0;
+        while (pending.size() - pos >= static_cast<size_t>(kFftSize))
+        {
+            analyseFrame(pending.data() + pos);
+            pos += kHopSize;
+        }
+        pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(pos));
+    }
+
+    void pushTruePeak(int channel, float x)
+    {
+        float* h = history.data() + static_cast<size_t>(channel) * kTapsPerPhase;
+        std::memmove(h + 1, h, (kTapsPerPhase - 1) * sizeof(float));
+        h[0] = x;
+        for (int p = 0; p < kOversampling; ++p)
+        {
+            float y = 0.0f;
+            for (int k = 0; k < kTapsPerPhase; ++k)
+                y += interpolator[static_cast<size_t>(p + k * kOversampling)] * h[k];
+            peak = std::max(peak, std::abs(y));
+        }
+        peak = std::max(peak, std::abs(x));
+    }
+
+    void analyseFrame(const float* in)
+    {
+        std::copy(in, in + kFftSize, frame.begin());
+        std::fill(frame.begin() + kFftSize, frame.end(), 0.0f);
+        window.multiplyWithWindowingTable(frame.data(), static_cast<size_t>(kFftSize));
+        fft.performFrequencyOnlyForwardTransform(frame.data(), true);
+
+        double flux = 0.0;
+        for (int k = 1; k < kNumBins; ++k)
+        {
+            const float m = frame[static_cast<size_t>(k)];
+            const float logMag = std::log1p(100.0f * m);
+            flux += std::max(0.0f, logMag - previousLog[static_cast<size_t>(k)]);
+            previousLog[static_cast<size_t>(k)] = logMag;
+            if (chromaMap[static_cast<size_t>(k)] >= 0)
+                chroma[static_cast<size_t>(chromaMap[static_cast<size_t>(k)])] += static_cast<double>(m) * m;
+        }
+        onset.push_back(static_cast<float>(flux / (kNumBins - 1)));
+    }
+
+    TrackAnalysis finish()
+    {
+        TrackAnalysis result;
+        result.valid = true;
+        result.truePeakDb = 20.0 * std::log10(std::max(peak, 1.0e-5f));
+        result.integratedLufs = integratedLoudness();
+        result.bpm = beatTrackedTempo();
+        estimateKey(result);
+        return result;
+    }
+
+    double integratedLoudness() const
+    {
+        // 400 ms gating blocks (4 x 100 ms), hop 100 ms = 75 % overlap
+        std::vector<double> blocks;
+        for (size_t i = 0; i + 4 <= blockMeanSquares.size(); ++i)
+            blocks.push_back(0.25 * (blockMeanSquares[i] + blockMeanSquares[i + 1] + blockMeanSquares[i + 2] + blockMeanSquares[i + 3]));
+        double sum = 0.0;
+        int count = 0;
+        for (double z : blocks)
+            if (loudnessOf(z) > kAbsoluteGateLufs)
+            {
+                sum += z;
+                ++count;
+            }
+        if (count == 0)
+            return kAbsoluteGateLufs;
+        const double relativeGate = loudnessOf(sum / count) + kRelativeGateLu;
+        sum = 0.0;
+        count = 0;
+        for (double z : blocks)
+            if (loudnessOf(z) > kAbsoluteGateLufs && loudnessOf(z) > relativeGate)
+            {
+                sum += z;
+                ++count;
+            }
+        return count > 0 ? loudnessOf(sum / count) : kAbsoluteGateLufs;
+    }
+
+    double beatTrackedTempo()
+    {
+        const int n = static_cast<int>(onset.size());
+        if (n < kMinBeatHops)
+            return 0.0;
+        const double hopsPerSecond = sampleRate / kHopSize;
+
+        // Remove the local (~0.5 s) mean and scale to unit deviation
+        const int half = std::max(1, static_cast<int>(hopsPerSecond * 0.25));
+        std::vector<double> prefix(static_cast<size_t>(n) + 1, 0.0);
+        for (int i = 0; i < n; ++i)
+            prefix[static_cast<size_t>(i) + 1] = prefix[static_cast<size_t>(i)] + onset[static_cast<size_t>(i)];
+        std::vector<float> env(static_cast<size_t>(n));
+        double sumSq = 0.0;
+        for (int i = 0; i < n; ++i)
+        {
+            const int lo = std::max(0, i - half), hi = std::min(n, i + half + 1);
+            const double localMean = (prefix[static_cast<size_t>(hi)] - prefix[static_cast<size_t>(lo)]) / (hi - lo);
+            const double v = std::max(0.0, onset[static_cast<size_t>(i)] - localMean);
+            env[static_cast<size_t>(i)] = static_cast<float>(v);
+            sumSq += v * v;
+        }
+        if (sumSq <= 0.0)
+            return 0.0;
+        const auto scale = static_cast<float>(1.0 / std::sqrt(sumSq / n));
+        for (auto& v : env)
+            v *= scale;
+
+        const double period = estimatePeriod(env, hopsPerSecond);
+        if (period <= 0.0)
+            return 0.0;
+        const std::vector<int> beats = trackBeats(env, period);
+        if (beats.size() < 4)
+            return 60.0 * hopsPerSecond / period;
+
+        // Least-squares slope of beat time against beat number
+        const double count = static_cast<double>(beats.size());
+        double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+        for (size_t i = 0; i < beats.size(); ++i)
+        {
+            const double x = static_cast<double>(i), y = beats[i];
+            sx += x;
+            sy += y;
+            sxx += x * x;
+            sxy += x * y;
+        }
+        const double slope = (count * sxy - sx * sy) / (count * sxx - sx * sx);
+        return slope > 0.0 ? 60.0 * hopsPerSecond / slope : 0.0;
+    }
+
+    void estimateKey(TrackAnalysis& result) const
+    {
+        double total = 0.0;
+        for (double v : chroma)
+            total += v;
+        if (total <= 0.0)
+            return;
+
+        auto correlate = [this](const double* profile, int tonic) {
+            double mx = 0.0, my = 0.0;
+            for (int i = 0; i < 12; ++i)
+            {
+                mx += chroma[static_cast<size_t>((tonic + i) % 12)];
+                my += profile[i];
+            }
+            mx /= 12.0;
+            my /= 12.0;
+            double sxy = 0.0, sxx = 0.0, syy = 0.0;
+            for (int i = 0; i < 12; ++i)
+            {
+                const double dx = chroma[static_cast<size_t>((tonic + i) % 12)] - mx, dy = profile[i] - my;
+                sxy += dx * dy;
+                sxx += dx * dx;
+                syy += dy * dy;
+            }
+            return sxx > 0.0 ? sxy / std::sqrt(sxx * syy) : 0.0;
+        };
+
+        double best = -2.0, second = -2.0;
+        for (int key = 0; key < 24; ++key)
+        {
+            const double r = correlate(key < 12 ? kMajorProfile : kMinorProfile, key % 12);
+            if (r > best)
+            {
+                second = best;
+                best = r;
+                result.key = key;
+            }
+            else if (r > second)
+            {
+                second = r;
+            }
+        }
+        result.keyConfidence = best - second;
+    }
+
+    double sampleRate;
+    int numChannels;
+    juce::dsp::FFT fft;
+    juce::dsp::WindowingFunction<float> window;
+    std::vector<float> frame, previousLog, pending, onset;
+    std::vector<int> chromaMap;
+    std::array<double, 12> chroma {};
+
+    std::vector<std::array<Biquad, 2>> kWeighting;
+    const int framesPerBlock;
+    int blockFrames = 0;
+    double blockSum = 0.0;
+    std::vector<double> blockMeanSquares;
+
+    const std::array<float, kOversampling * kTapsPerPhase> interpolator;
+    std::vector<float> history;   // newest first, kTapsPerPhase per channel
+    float peak = 0.0f;
+};
+
+TrackAnalyzer::TrackAnalyzer(double sampleRate, int numChannels)
+    : impl_(std::make_unique<Impl>(sampleRate, numChannels))
+{
+}
+
+TrackAnalyzer::~TrackAnalyzer() = default;
+
+void TrackAnalyzer::process(const float* const* channels, int numFrames)
+{
+    if (channels != nullptr && numFrames > 0)
+        impl_->process(channels, numFrames);
+}
+
+TrackAnalysis TrackAnalyzer::finish()
+{
+    return impl_->finish();
+}
+
+TrackAnalysis TrackAnalyzer::analyseFile(const juce::File& file)
+{
+    juce::AudioFormatManager fm;
+    fm.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(fm.createReaderFor(file));
+    if (reader == nullptr || reader->numChannels == 0 || reader->sampleRate <= 0.0 || reader->lengthInSamples <= 0)
+        return {};
+    const int numCh = static_cast<int>(reader->numChannels);
+    TrackAnalyzer analyzer(reader->sampleRate, numCh);
+    juce::AudioBuffer<float> block(numCh, kDecodeBlockFrames);
+    for (juce::int64 pos = 0; pos < reader->lengthInSamples; pos += kDecodeBlockFrames)
+    {
+        const int n = static_cast<int>(std::min<juce::int64>(kDecodeBlockFrames, reader->lengthInSamples - pos));
+        if (!reader->read(&block, 0, n, pos, true, true))
+            return {};
+        analyzer.process(block.getArrayOfReadPointers(), n);
+    }
+    return analyzer.finish();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <memory>
+#include <string>
+
+/** Tempo, key and loudness of a finished track (TrackAnalyzer). */
+struct TrackAnalysis
+{
+    bool valid = false;
+    double bpm = 0.0;               // beat-tracked tempo; 0 if no steady beat was found
+    int key = -1;                   // 0..11 = C..B major, 12..23 = C..B minor, -1 = unknown
+    double keyConfidence = 0.0;     // correlation margin over the runner-up key
+    double integratedLufs = -70.0;  // ITU-R BS.1770-4 integrated loudness (gated)
+    double truePeakDb = -100.0;     // dBTP, 4x oversampled
+
+    /** "C", "F#m", ... or an empty string for an unknown key. */
+    static std::string keyName(int key);
+    /** True if bpm is within tolerance of reference, also at half / double tempo. */
+    static bool tempoMatches(double bpm, double reference, double tolerance = 0.03);
+};
+
+/**
+ * Streaming analysis: feed planar blocks of any size with process(), then call
+ * finish() once. Memory stays small (onset envelope, 100 ms loudness blocks),
+ * so whole tracks can be analysed while they are decoded chunk by chunk.
+ *  - Tempo: log-magnitude spectral-flux onset envelope (2048-point STFT, hop
+ *    512), autocorrelation period estimate, then dynamic-programming beat
+ *    tracking; BPM is the least-squares slope of the tracked beat times.
+ *  - Key: energy-weighted chroma correlated with the Krumhansl-Kessler major /
+ *    minor profiles in all 12 rotations.
+ *  - Loudness: K-weighting, 400 ms blocks with 75 % overlap, absolute (-70
+ *    LUFS) and relative (-10 LU) gates.
+ *  - True peak: 48-tap polyphase 4x interpolation per channel.
+ */
+class TrackAnalyzer
+{
+public:
+    TrackAnalyzer(double sampleRate, int numChannels);
+    ~TrackAnalyzer();
+
+    void process(const float* const* channels, int numFrames);
+    TrackAnalysis finish();
+
+    /** Decodes (any basic format) and analyses the whole file in blocks; blocking. */
+    static TrackAnalysis analyseFile(const juce::File& file);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
@@ -0,0 +1,82 @@
+#include "UploadCache.h"
+
+UploadCache::UploadCache()
+    : file_(juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                .getChildFile("AceForgeSuno")
+                .getChildFile("upload-cache.json"))
+{
+    load();
+}
+
+juce::String UploadCache::lookup(const juce::String& key) const
+{
+    if (key.isEmpty())
+        return {};
+    juce::ScopedLock l(lock_);
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+        return {};
+    if (juce::Time::currentTimeMillis() >= it->second.expiresAtMs)
+        return {};
+    return it->second.fileUrl;
+}
+
+void UploadCache::store(const juce::String& key, const juce::String& fileUrl)
+{
+    if (key.isEmpty() || fileUrl.isEmpty())
+        return;
+    juce::ScopedLock l(lock_);
+    const juce::int64 now = juce::Time::currentTimeMillis();
+    for (auto it = entries_.begin(); it != entries_.end();)
+        it = (it->second.expiresAtMs <= now) ? entries_.erase(it) : std::next(it);
+    entries_[key] = { fileUrl, now + kRetentionMs - kSafetyMarginMs };
+    save();
+}
+
+void UploadCache::invalidate(const juce::String& key)
+{
+    juce::ScopedLock l(lock_);
+    if (entries_.erase(key) > 0)
+        save();
+}
+
+void UploadCache::load()
+{
+    juce::ScopedLock l(lock_);
+    entries_.clear();
+    if (!file_.existsAsFile())
+        return;
+    const juce::var root = juce::JSON::parse(file_);
+    const juce::int64 now = juce::Time::currentTimeMillis();
+    if (auto* items = root.getProperty("entries", {}).getArray())
+    {
+        for (const auto& item : *items)
+        {
+            Entry e;
+            e.fileUrl = item.getProperty("fileUrl", {}).toString();
+            e.expiresAtMs = static_cast<juce::int64>(item.getProperty("expiresAt", 0));
+            const juce::String key = item.getProperty("key", {}).toString();
+            if (key.isNotEmpty() && e.fileUrl.isNotEmpty() && e.expiresAtMs > now)
+                entries_[key] = e;
+        }
+    }
+}
+
+// Caller holds lock_
+void UploadCache::save() const
+{
+    juce::Array<juce::var> items;
+    for (const auto& kv : entries_)
+    {
+        auto* obj = new juce::DynamicObject();
+        obj->setProperty("key", kv.first);
+        obj->setProperty("fileUrl", kv.second.fileUrl);
+        obj->setProperty("expiresAt", kv.second.expiresAtMs);
+        items.add(juce::var(obj));
+    }
+    auto* root = new juce::DynamicObject();
+    root->setProperty("version", 1);
+    root->setProperty("entries", items);
+    file_.getParentDirectory().createDirectory();
+    file_.replaceWithText(juce::JSON::toString(juce::var(root)));
+}
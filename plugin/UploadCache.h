@@ -0,0 +1,42 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <map>
+
+/**
+ * Remembers the Suno fileUrl returned for each uploaded segment so that a
+ * repeated Cover / Add Vocals on the same audio skips encode and upload.
+ * Keys are content hashes of the trimmed segment plus its encoding settings.
+ * Entries expire before the upload host deletes the file (~3 days).
+ * Process-wide (owned by SharedServices); persisted as JSON in
+ * ~/Library/Application Support/AceForgeSuno/upload-cache.json.
+ */
+class UploadCache
+{
+public:
+    static constexpr juce::int64 kRetentionMs = 3LL * 24 * 60 * 60 * 1000;
+    static constexpr juce::int64 kSafetyMarginMs = 2LL * 60 * 60 * 1000;
+
+    UploadCache();
+
+    /** Returns the cached fileUrl, or an empty string if unknown or expired. */
+    juce::String lookup(const juce::String& key) const;
+    void store(const juce::String& key, const juce::String& fileUrl);
+    void invalidate(const juce::String& key);
+
+private:
+    struct Entry
+    {
+        juce::String fileUrl;
+        juce::int64 expiresAtMs = 0;
+    };
+
+    void load();
+    void save() const;
+
+    juce::File file_;
+    juce::CriticalSection lock_;
+    std::map<juce::String, Entry> entries_;
+
+    JUCE_DECLARE_NON_COPYABLE(UploadCache)
+};
@@ -0,0 +1,326 @@
+#include "WaveformPeaks.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+const char kPeaksMagic[8] = { 'A', 'F', 'S', 'P', 'E', 'A', 'K', '1' };
+constexpr int kPeaksFormatVersion = 1;
+
+juce::int16 quantise(float v)
+{
+    return static_cast<juce::int16>(std::lround(juce::jlimit(-1.0f, 1.0f, v) * 32767.0f));
+}
+} // namespace
+
+// --- PeakPyramid ---
+void PeakPyramid::clear()
+{
+    levels_.clear();
+    partials_.clear();
+    numFrames_ = 0;
+}
+
+void PeakPyramid::reset()
+{
+    for (auto& level : levels_)
+        level.clear();
+    for (auto& p : partials_)
+        p = Partial{};
+    numFrames_ = 0;
+}
+
+void PeakPyramid::append(const float* const* channels, int numChannels, int numFrames)
+{
+    if (channels == nullptr || numChannels <= 0 || numFrames <= 0)
+        return;
+    if (partials_.empty())
+        partials_.resize(1);
+    int done = 0;
+    while (done < numFrames)
+    {
+        Partial& p = partials_[0];
+        const int n = std::min(numFrames - done, kBaseFramesPerPeak - p.count);
+        for (int c = 0; c < numChannels; ++c)
+        {
+            const auto range = juce::FloatVectorOperations::findMinAndMax(channels[c] + done, n);
+            p.peak.min = std::min(p.peak.min, range.getStart());
+            p.peak.max = std::max(p.peak.max, range.getEnd());
+        }
+        p.count += n;
+        done += n;
+        if (p.count == kBaseFramesPerPeak)
+        {
+            const Peak complete = p.peak;
+            p = Partial{};
+            pushPeak(0, complete);
+        }
+    }
+    numFrames_ += numFrames;
+}
+
+bool PeakPyramid::appendPyramid(const PeakPyramid& other)
+{
+    if (numFrames_ % kBaseFramesPerPeak != 0)
+        return false;
+    if (!other.levels_.empty())
+        for (const Peak& p : other.levels_[0])
+            pushPeak(0, p);
+    if (!other.partials_.empty() && other.partials_[0].count > 0)
+    {
+        if (partials_.empty())
+            partials_.resize(1);
+        partials_[0] = other.partials_[0];
+    }
+    numFrames_ += other.numFrames_;
+    return true;
+}
+
+// Appends a finished peak to level and folds it into the partial bucket of the level above.
+void PeakPyramid::pushPeak(size_t level, Peak peak)
+{
+    if (levels_.size() <= level)
+        levels_.resize(level + 1);
+    levels_[level].push_back(peak);
+    if (partials_.size() <= level + 1)
+        partials_.resize(level + 2);
+    Partial& up = partials_[level + 1];
+    up.peak.min = std::min(up.peak.min, peak.min);
+    up.peak.max = std::max(up.peak.max, peak.max);
+    if (++up.count == kLevelFactor)
+    {
+        const Peak complete = up.peak;
+        up = Partial{};
+        pushPeak(level + 1, complete);
+    }
+}
+
+void PeakPyramid::finish()
+{
+    for (size_t level = 0; level < partials_.size(); ++level)
+    {
+        if (level > 0 && levels_[level - 1].size() <= 1)
+        {
+            partials_.resize(level);
+            break;
+        }
+        if (partials_[level].count == 0)
+            continue;
+        const Peak p = partials_[level].peak;
+        partials_[level] = Partial{};
+        pushPeak(level, p);
+    }
+    while (!levels_.empty() && levels_.back().empty()) // left over by reset()
+        levels_.pop_back();
+}
+
+juce::int64 PeakPyramid::getFramesPerPeak(int level) const
+{
+    juce::int64 frames = kBaseFramesPerPeak;
+    for (int i = 0; i < level; ++i)
+        frames *= kLevelFactor;
+    return frames;
+}
+
+void PeakPyramid::draw(juce::Graphics& g, juce::Rectangle<float> area, juce::int64 startFrame, juce::int64 endFrame) const
+{
+    const int width = static_cast<int>(area.getWidth());
+    if (width <= 0 || endFrame <= startFrame || levels_.empty())
+        return;
+    const double framesPerPixel = static_cast<double>(endFrame - startFrame) / width;
+
+    // Coarsest level with at least one peak per pixel; falls back to the finest level stored.
+    int level = -1;
+    for (int l = getNumLevels() - 1; l >= 0; --l)
+    {
+        if (levels_[static_cast<size_t>(l)].empty())
+            continue;
+        level = l;
+        if (static_cast<double>(getFramesPerPeak(l)) <= framesPerPixel)
+            break;
+    }
+    if (level < 0)
+        return;
+
+    const auto& peaks = levels_[static_cast<size_t>(level)];
+    const double framesPerPeak = static_cast<double>(getFramesPerPeak(level));
+    const float midY = area.getCentreY();
+    const float halfHeight = area.getHeight() * 0.5f;
+    for (int x = 0; x < width; ++x)
+    {
+        const double f0 = startFrame + x * framesPerPixel;
+        const double f1 = f0 + framesPerPixel;
+        const auto p0 = static_cast<size_t>(f0 / framesPerPeak);
+        if (p0 >= peaks.size())
+            break;
+        const auto p1 = std::min(peaks.size(), std::max(p0 + 1, static_cast<size_t>(std::ceil(f1 / framesPerPeak))));
+        float lo = peaks[p0].min, hi = peaks[p0].max;
+        for (size_t i = p0 + 1; i < p1; ++i)
+        {
+            lo = std::min(lo, peaks[i].min);
+            hi = std::max(hi, peaks[i].max);
+        }
+        lo = juce::jlimit(-1.0f, 1.0f, lo);
+        hi = juce::jlimit(-1.0f, 1.0f, hi);
+        g.fillRect(area.getX() + static_cast<float>(x), midY - hi * halfHeight,
+                   1.0f, std::max(1.0f, (hi - lo) * halfHeight));
+    }
+}
+
+void PeakPyramid::writeTo(juce::OutputStream& out, int maxPeaksPerLevel) const
+{
+    out.write(kPeaksMagic, sizeof(kPeaksMagic));
+    out.writeInt(kPeaksFormatVersion);
+    out.writeInt64(numFrames_);
+    out.writeInt(getNumLevels());
+    for (const auto& level : levels_)
+    {
+        const bool stored = static_cast<int>(level.size()) <= maxPeaksPerLevel;
+        out.writeInt(stored ? static_cast<int>(level.size()) : 0);
+        if (!stored)
+            continue;
+        for (const auto& p : level)
+        {
+            out.writeShort(quantise(p.min));
+            out.writeShort(quantise(p.max));
+        }
+    }
+}
+
+bool PeakPyramid::readFrom(juce::InputStream& in)
+{
+    clear();
+    char magic[sizeof(kPeaksMagic)] = {};
+    if (in.read(magic, sizeof(magic)) != static_cast<int>(sizeof(magic))
+        || std::memcmp(magic, kPeaksMagic, sizeof(magic)) != 0
+        || in.readInt() != kPeaksFormatVersion)
+        return false;
+    numFrames_ = in.readInt64();
+    const int numLevels = in.readInt();
+    if (numFrames_ < 0 || numLevels < 0 || numLevels > 32)
+        return false;
+    levels_.resize(static_cast<size_t>(numLevels));
+    for (auto& level : levels_)
+    {
+        const int count = in.readInt();
+        if (count < 0 || in.getNumBytesRemaining() < static_cast<juce::int64>(count) * 4)
+        {
+            clear();
+            return false;
+        }
+        level.resize(static_cast<size_t>(count));
+        for (auto& p : level)
+        {
+            p.min = in.readShort() / 32767.0f;
+            p.max = in.readShort() / 32767.0f;
+        }
+    }
+    return true;
+}
+
+void PeakPyramid::dropLevelsLargerThan(int maxPeaksPerLevel)
+{
+    for (auto& level : levels_)
+        if (static_cast<int>(level.size()) > maxPeaksPerLevel)
+            std::vector<Peak>().swap(level);
+}
+
+// --- WaveformPeakStore ---
+WaveformPeakStore::WaveformPeakStore() = default;
+
+WaveformPeakStore::~WaveformPeakStore()
+{
+    pool_.removeAllJobs(true, 10000);
+}
+
+juce::File WaveformPeakStore::getPeaksFileFor(const juce::File& audioFile, const juce::String& contentKey)
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("AceForgeSuno")
+        .getChildFile("Peaks")
+        .getChildFile((contentKey.isNotEmpty() ? contentKey : audioFile.getFileName()) + ".peaks");
+}
+
+std::shared_ptr<const PeakPyramid> WaveformPeakStore::getPeaks(const juce::File& audioFile, const juce::String& contentKey)
+{
+    const juce::String key = contentKey.isNotEmpty() ? contentKey : audioFile.getFullPathName();
+    juce::ScopedLock l(lock_);
+    auto it = cache_.find(key);
+    if (it != cache_.end())
+    {
+        lru_.remove(key);
+        lru_.push_front(key);
+        return it->second;
+    }
+    if (inFlight_.insert(key).second)
+        pool_.addJob([this, audioFile, contentKey] { loadOrGenerate(audioFile, contentKey); });
+    return nullptr;
+}
+
+void WaveformPeakStore::loadOrGenerate(const juce::File& audioFile, const juce::String& contentKey)
+{
+    const juce::File peaksFile = getPeaksFileFor(audioFile, contentKey);
+    std::shared_ptr<PeakPyramid> peaks;
+    // Content-keyed peaks are valid for as long as the key exists; name-keyed ones only if newer than the audio
+    if (peaksFile.existsAsFile()
+        && (contentKey.isNotEmpty() || peaksFile.getLastModificationTime() >= audioFile.getLastModificationTime()))
+    {
+        juce::FileInputStream in(peaksFile);
+        auto loaded = std::make_shared<PeakPyramid>();
+        if (in.openedOk() && loaded->readFrom(in))
+            peaks = loaded;
+    }
+    if (peaks == nullptr)
+    {
+        peaks = generate(audioFile);
+        if (peaks != nullptr)
+        {
+            peaks->dropLevelsLargerThan(kMaxStoredPeaksPerLevel);
+            peaksFile.getParentDirectory().createDirectory();
+            juce::TemporaryFile temp(peaksFile);
+            if (auto out = temp.getFile().createOutputStream())
+            {
+                peaks->writeTo(*out, kMaxStoredPeaksPerLevel);
+                out->flush();
+            }
+            temp.overwriteTargetFileWithTemporary();
+        }
+    }
+
+    const juce::String key = contentKey.isNotEmpty() ? contentKey : audioFile.getFullPathName();
+    juce::ScopedLock l(lock_);
+    inFlight_.erase(key);
+    // Unreadable files get an empty pyramid so they are not retried on every repaint.
+    cache_[key] = peaks != nullptr ? std::shared_ptr<const PeakPyramid>(peaks) : std::make_shared<const PeakPyramid>();
+    lru_.remove(key);
+    lru_.push_front(key);
+    while (lru_.size() > kMaxCachedFiles)
+    {
+        cache_.erase(lru_.back());
+        lru_.pop_back();
+    }
+    version_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+std::shared_ptr<PeakPyramid> WaveformPeakStore::generate(const juce::File& audioFile)
+{
+    juce::AudioFormatManager fm;
+    fm.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(fm.createReaderFor(audioFile));
+    if (reader == nullptr || reader->numChannels == 0)
+        return nullptr;
+    constexpr int kChunkFrames = 1 << 16;
+    const int numCh = static_cast<int>(reader->numChannels);
+    juce::AudioBuffer<float> chunk(numCh, kChunkFrames);
+    auto peaks = std::make_shared<PeakPyramid>();
+    for (juce::int64 pos = 0; pos < reader->lengthInSamples; pos += kChunkFrames)
+    {
+        const int n = static_cast<int>(std::min<juce::int64>(kChunkFrames, reader->lengthInSamples - pos));
+        if (!reader->read(&chunk, 0, n, pos, true, true))
+            return nullptr;
+        peaks->append(chunk.getArrayOfReadPointers(), numCh, n);
+    }
+    peaks->finish();
+    return peaks;
+}
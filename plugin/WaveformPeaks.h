@@ -0,0 +1,107 @@
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_graphics/juce_graphics.h>
+#include <atomic>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+/**
+ * Multi-resolution min/max peak pyramid (all channels folded together).
+ * Level 0 holds one pair per kBaseFramesPerPeak frames; each level above
+ * folds kLevelFactor pairs of the level below. append() is incremental, so
+ * the pyramid can be built in one streaming pass (or while audio arrives).
+ * Drawing picks the coarsest level that still has one pair per pixel, so the
+ * cost depends on the pixel width only, never on the audio length.
+ */
+class PeakPyramid
+{
+public:
+    struct Peak
+    {
+        float min = 0.0f;
+        float max = 0.0f;
+    };
+
+    static constexpr int kBaseFramesPerPeak = 256;
+    static constexpr int kLevelFactor = 4;
+
+    void clear();
+    /** As clear(), but keeps the storage so refilling does not allocate until it outgrows it. */
+    void reset();
+    void append(const float* const* channels, int numChannels, int numFrames);
+    /** Appends another unfinished pyramid as if its audio followed this one: O(level-0 peaks) of
+        other. Needs getNumFrames() to be a multiple of kBaseFramesPerPeak; false otherwise. */
+    bool appendPyramid(const PeakPyramid& other);
+    /** Flushes partially filled buckets (call once the audio is complete). */
+    void finish();
+
+    juce::int64 getNumFrames() const { return numFrames_; }
+    int getNumLevels() const { return static_cast<int>(levels_.size()); }
+    const std::vector<Peak>& getLevel(int level) const { return levels_[static_cast<size_t>(level)]; }
+    juce::int64 getFramesPerPeak(int level) const;
+
+    /** Draws frames [startFrame, endFrame) into area, one vertical bar per pixel column. */
+    void draw(juce::Graphics& g, juce::Rectangle<float> area, juce::int64 startFrame, juce::int64 endFrame) const;
+
+    /** Serialises levels with at most maxPeaksPerLevel pairs (coarse levels suffice for thumbnails). */
+    void writeTo(juce::OutputStream& out, int maxPeaksPerLevel) const;
+    bool readFrom(juce::InputStream& in);
+    /** Frees fine levels that are not needed once the pyramid is complete. */
+    void dropLevelsLargerThan(int maxPeaksPerLevel);
+
+private:
+    struct Partial
+    {
+        Peak peak{ std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+        int count = 0;
+    };
+
+    void pushPeak(size_t level, Peak p);
+
+    std::vector<std::vector<Peak>> levels_;
+    std::vector<Partial> partials_;   // incomplete bucket per level; partials_[0].count counts frames
+    juce::int64 numFrames_ = 0;
+};
+
+/**
+ * Process-wide cache of waveform peaks for library files (use via
+ * juce::SharedResourcePointer). Peaks are generated once per file on a
+ * background thread and stored in AceForgeSuno/Peaks/<content key or file name>.peaks; the UI
+ * asks only for visible rows and gets nullptr until the peaks are ready.
+ */
+class WaveformPeakStore
+{
+public:
+    WaveformPeakStore();
+    ~WaveformPeakStore();
+
+    /** Loaded peaks, or nullptr while they are being loaded / generated in the background.
+        contentKey (BlobStore key) makes the lookup exact and shares peaks between identical
+        files; without it peaks are keyed by file name and regenerated when the file changes. */
+    std::shared_ptr<const PeakPyramid> getPeaks(const juce::File& audioFile, const juce::String& contentKey = {});
+    /** Bumped whenever new peaks become available. */
+    juce::uint32 getVersion() const { return version_.load(std::memory_order_acquire); }
+
+    static juce::File getPeaksFileFor(const juce::File& audioFile, const juce::String& contentKey = {});
+
+private:
+    void loadOrGenerate(const juce::File& audioFile, const juce::String& contentKey);
+    static std::shared_ptr<PeakPyramid> generate(const juce::File& audioFile);
+
+    static constexpr size_t kMaxCachedFiles = 256;
+    static constexpr int kMaxStoredPeaksPerLevel = 8192;
+
+    juce::CriticalSection lock_;
+    std::map<juce::String, std::shared_ptr<const PeakPyramid>> cache_;
+    std::list<juce::String> lru_;      // most recently used at front
+    std::set<juce::String> inFlight_;
+    std::atomic<juce::uint32> version_{ 0 };
+    juce::ThreadPool pool_{ 1 };
+
+    JUCE_DECLARE_NON_COPYABLE(WaveformPeakStore)
+};